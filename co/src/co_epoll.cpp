@@ -17,6 +17,7 @@
 */
 
 #include "co_epoll.h"
+#include "co_routine.h"
 #include <stdlib.h>
 #include <stdio.h>
 #include <errno.h>
@@ -26,10 +27,12 @@
 
 int	co_epoll_wait( int epfd,struct co_epoll_res *events,int maxevents,int timeout )
 {
+	co_get_stat_ct()->ullEpollWaitCnt++;
 	return epoll_wait( epfd,events->events,maxevents,timeout );
 }
 int	co_epoll_ctl( int epfd,int op,int fd,struct epoll_event * ev )
 {
+	co_get_stat_ct()->ullEpollCtlCnt++;
 	return epoll_ctl( epfd,op,fd,ev );
 }
 int	co_epoll_create( int size )
@@ -21,6 +21,7 @@
 #include <sys/syscall.h>
 #include <sys/un.h>
 #include <sys/select.h>
+#include <sys/uio.h>
 
 #include <dlfcn.h>
 #include <poll.h>
@@ -49,6 +50,7 @@
 #include "co_routine_inner.h"
 #include "co_routine_specific.h"
 #include "co_comm.h"
+#include "co_uring.h"
 
 typedef long long ll64_t;
 
@@ -60,6 +62,9 @@ struct rpchook_t
 
 	struct timeval read_timeout;
 	struct timeval write_timeout;
+
+	char persist; // 是否采用持久化epoll注册
+	stCoFdEvent_t *pEvents[2]; // 持久化注册的事件（收发可能在不同线程，每个线程epoll各一个）
 };
 //static inline pid_t GetPid()
 //{
@@ -67,6 +72,7 @@ struct rpchook_t
 //	return p ? *(pid_t*)(p + 18) : getpid();
 //}
 static rpchook_t *g_rpchook_socket_fd[ 102400 ] = { 0 };
+static bool g_persist_poll = false;
 
 typedef int (*socket_pfn_t)(int domain, int type, int protocol);
 typedef int (*connect_pfn_t)(int socket, const struct sockaddr *address, socklen_t address_len);
@@ -86,6 +92,14 @@ typedef ssize_t (*recvfrom_pfn_t)(int socket, void *buffer, size_t length,
 typedef ssize_t (*send_pfn_t)(int socket, const void *buffer, size_t length, int flags);
 typedef ssize_t (*recv_pfn_t)(int socket, void *buffer, size_t length, int flags);
 
+typedef ssize_t (*readv_pfn_t)(int fd, const struct iovec *iov, int iovcnt);
+typedef ssize_t (*writev_pfn_t)(int fd, const struct iovec *iov, int iovcnt);
+typedef ssize_t (*sendmsg_pfn_t)(int socket, const struct msghdr *message, int flags);
+typedef ssize_t (*recvmsg_pfn_t)(int socket, struct msghdr *message, int flags);
+typedef int (*sendmmsg_pfn_t)(int socket, struct mmsghdr *msgvec, unsigned int vlen, int flags);
+typedef int (*recvmmsg_pfn_t)(int socket, struct mmsghdr *msgvec, unsigned int vlen, int flags, struct timespec *timeout);
+typedef int (*accept4_pfn_t)(int socket, struct sockaddr *address, socklen_t *address_len, int flags);
+
 typedef int (*poll_pfn_t)(struct pollfd fds[], nfds_t nfds, int timeout);
 typedef int (*select_pfn_t)(int nfds, fd_set *readfds, fd_set *writefds,
 fd_set *exceptfds, struct timeval *timeout);
@@ -122,6 +136,14 @@ static recvfrom_pfn_t g_sys_recvfrom_func = (recvfrom_pfn_t)dlsym(RTLD_NEXT,"rec
 static send_pfn_t g_sys_send_func       = (send_pfn_t)dlsym(RTLD_NEXT,"send");
 static recv_pfn_t g_sys_recv_func       = (recv_pfn_t)dlsym(RTLD_NEXT,"recv");
 
+static readv_pfn_t g_sys_readv_func     = (readv_pfn_t)dlsym(RTLD_NEXT,"readv");
+static writev_pfn_t g_sys_writev_func   = (writev_pfn_t)dlsym(RTLD_NEXT,"writev");
+static sendmsg_pfn_t g_sys_sendmsg_func = (sendmsg_pfn_t)dlsym(RTLD_NEXT,"sendmsg");
+static recvmsg_pfn_t g_sys_recvmsg_func = (recvmsg_pfn_t)dlsym(RTLD_NEXT,"recvmsg");
+static sendmmsg_pfn_t g_sys_sendmmsg_func = (sendmmsg_pfn_t)dlsym(RTLD_NEXT,"sendmmsg");
+static recvmmsg_pfn_t g_sys_recvmmsg_func = (recvmmsg_pfn_t)dlsym(RTLD_NEXT,"recvmmsg");
+static accept4_pfn_t g_sys_accept4_func = (accept4_pfn_t)dlsym(RTLD_NEXT,"accept4");
+
 static poll_pfn_t g_sys_poll_func 	    = (poll_pfn_t)dlsym(RTLD_NEXT,"poll");
 static select_pfn_t g_sys_select_func   = (select_pfn_t)dlsym(RTLD_NEXT,"select");
 
@@ -208,6 +230,7 @@ static inline rpchook_t * alloc_by_fd( int fd )
 		rpchook_t *lp = (rpchook_t*)calloc( 1,sizeof(rpchook_t) );
 		lp->read_timeout.tv_sec = 1;
 		lp->write_timeout.tv_sec = 1;
+		lp->persist = g_persist_poll;
 		g_rpchook_socket_fd[ fd ] = lp;
 		return lp;
 	}
@@ -221,12 +244,222 @@ static inline void free_by_fd( int fd )
 		if( lp )
 		{
 			g_rpchook_socket_fd[ fd ] = NULL;
+			co_fd_event_release( lp->pEvents[0] );
+			co_fd_event_release( lp->pEvents[1] );
 			free(lp);	
 		}
 	}
 	return;
 
 }
+
+// 取当前线程epoll中fd的持久化注册事件，首次等待时注册
+static stCoFdEvent_t *get_fd_event( rpchook_t *lp,int fd )
+{
+	stCoEpoll_t *ctx = co_get_epoll_ct();
+	for(int i=0;i<2;i++)
+	{
+		stCoFdEvent_t *ev = lp->pEvents[i];
+		if( ev && co_fd_event_ctx( ev ) == ctx )
+		{
+			return ev;
+		}
+	}
+
+	if( lp->pEvents[0] && lp->pEvents[1] )
+	{
+		return NULL;
+	}
+
+	stCoFdEvent_t *ev = co_fd_event_alloc( ctx,fd );
+	if( !ev )
+	{
+		return NULL;
+	}
+	for(int i=0;i<2;i++)
+	{
+		if( __sync_bool_compare_and_swap( &lp->pEvents[i],(stCoFdEvent_t*)NULL,ev ) )
+		{
+			return ev;
+		}
+	}
+	co_fd_event_release( ev );
+	return NULL;
+}
+
+// 等待fd可读写，返回值同poll（单个fd）
+static int co_wait_fd( rpchook_t *lp,int fd,short events,int timeout )
+{
+	stCoFdEvent_t *ev = lp->persist ? get_fd_event( lp,fd ) : NULL;
+	if( ev )
+	{
+		return co_fd_event_wait( ev,events,NULL,timeout );
+	}
+
+	struct pollfd pf = { 0 };
+	pf.fd = fd;
+	pf.events = ( events | POLLERR | POLLHUP );
+	return poll( &pf,1,timeout );
+}
+
+// io_uring后端，缓冲区在共享栈上时不能交给内核异步访问（协程挂起后栈内容会被换出），退回epoll方式
+static stCoUring_t *get_uring( const void *buf,size_t len )
+{
+	if( !co_is_uring_enabled() || co_is_share_stack_buffer( buf,len ) )
+	{
+		return NULL;
+	}
+	return co_get_uring_ct();
+}
+
+#ifdef CO_HAS_URING
+static ssize_t uring_io( stCoUring_t *ring,int opcode,int fd,const void *buf,size_t len,int flags,int timeout )
+{
+	struct io_uring_sqe *sqe = co_uring_get_sqe( ring );
+	if( !sqe )
+	{
+		errno = EAGAIN;
+		return -1;
+	}
+
+	sqe->opcode = opcode;
+	sqe->fd = fd;
+	sqe->addr = (uint64_t)(uintptr_t)buf;
+	sqe->len = len;
+	if( opcode == IORING_OP_READ || opcode == IORING_OP_WRITE )
+	{
+		sqe->off = (uint64_t)-1; // 使用文件当前位置（socket/pipe忽略）
+	}
+	else
+	{
+		sqe->msg_flags = flags;
+	}
+
+	int res = co_uring_wait( ring,sqe,timeout );
+	if( res < 0 )
+	{
+		errno = -res;
+		return -1;
+	}
+	return res;
+}
+
+static ssize_t uring_read( stCoUring_t *ring,int fd,void *buf,size_t len,int flags,bool recv,int timeout )
+{
+	return uring_io( ring,recv ? IORING_OP_RECV : IORING_OP_READ,fd,buf,len,flags,timeout );
+}
+
+// 与原write/send的hook一致：写完全部数据或出错才返回
+static ssize_t uring_write( stCoUring_t *ring,int fd,const void *buf,size_t len,int flags,bool send,int timeout )
+{
+	size_t wrotelen = 0;
+	ssize_t ret = 0;
+	while( wrotelen < len )
+	{
+		ret = uring_io( ring,send ? IORING_OP_SEND : IORING_OP_WRITE,fd,(const char*)buf + wrotelen,len - wrotelen,flags,timeout );
+		if( ret <= 0 )
+		{
+			break;
+		}
+		wrotelen += ret;
+	}
+	if( ret <= 0 && wrotelen == 0 )
+	{
+		return ret;
+	}
+	return wrotelen;
+}
+
+static int uring_accept( stCoUring_t *ring,int fd,struct sockaddr *addr,socklen_t *len )
+{
+	struct io_uring_sqe *sqe = co_uring_get_sqe( ring );
+	if( !sqe )
+	{
+		errno = EAGAIN;
+		return -1;
+	}
+
+	// 地址参数可能在共享栈上，用堆上的临时空间接收
+	struct sockaddr_storage *ss = NULL;
+	socklen_t *sslen = NULL;
+	if( addr && len )
+	{
+		ss = (struct sockaddr_storage*)malloc( sizeof(struct sockaddr_storage) + sizeof(socklen_t) );
+		sslen = (socklen_t*)( ss + 1 );
+		*sslen = sizeof(struct sockaddr_storage);
+	}
+
+	sqe->opcode = IORING_OP_ACCEPT;
+	sqe->fd = fd;
+	sqe->addr = (uint64_t)(uintptr_t)ss;
+	sqe->addr2 = (uint64_t)(uintptr_t)sslen;
+
+	int res = co_uring_wait( ring,sqe,-1 );
+	if( ss )
+	{
+		if( res >= 0 )
+		{
+			memcpy( addr,ss,*len < *sslen ? *len : *sslen );
+			*len = *sslen;
+		}
+		free( ss );
+	}
+
+	if( res < 0 )
+	{
+		errno = -res;
+		return -1;
+	}
+	return res;
+}
+
+static void uring_cancel_fd( int fd )
+{
+#ifdef IORING_ASYNC_CANCEL_FD
+	stCoUring_t *ring = get_uring( NULL,0 );
+	if( !ring ) return;
+
+	struct io_uring_sqe *sqe = co_uring_get_sqe( ring );
+	if( !sqe ) return;
+
+	// 关闭前取消本线程中该fd上挂起的请求，否则请求持有文件引用会一直挂起
+	sqe->opcode = IORING_OP_ASYNC_CANCEL;
+	sqe->fd = fd;
+	sqe->cancel_flags = IORING_ASYNC_CANCEL_FD | IORING_ASYNC_CANCEL_ALL;
+	co_uring_submit( ring );
+#endif
+}
+#else
+static ssize_t uring_read( stCoUring_t *ring,int fd,void *buf,size_t len,int flags,bool recv,int timeout )
+{
+	errno = ENOSYS;
+	return -1;
+}
+static ssize_t uring_write( stCoUring_t *ring,int fd,const void *buf,size_t len,int flags,bool send,int timeout )
+{
+	errno = ENOSYS;
+	return -1;
+}
+static int uring_accept( stCoUring_t *ring,int fd,struct sockaddr *addr,socklen_t *len )
+{
+	errno = ENOSYS;
+	return -1;
+}
+static void uring_cancel_fd( int fd )
+{
+}
+#endif
+
+void co_set_persist_poll( bool enable )
+{
+	g_persist_poll = enable;
+}
+
+bool co_is_persist_poll()
+{
+	return g_persist_poll;
+}
+
 int socket(int domain, int type, int protocol)
 {
 	HOOK_SYS_FUNC( socket );
@@ -251,7 +484,8 @@ int socket(int domain, int type, int protocol)
 
 int co_accept( int fd, struct sockaddr *addr, socklen_t *len )
 {
-	int cli = accept( fd,addr,len );
+	stCoUring_t *ring = co_is_enable_sys_hook() ? get_uring( NULL,0 ) : NULL;
+	int cli = ring ? uring_accept( ring,fd,addr,len ) : accept( fd,addr,len );
 	if( cli < 0 )
 	{
 		return cli;
@@ -364,6 +598,11 @@ int close(int fd)
 		return g_sys_close_func( fd );
 	}
 
+	if( co_is_uring_enabled() )
+	{
+		uring_cancel_fd( fd );
+	}
+
 	free_by_fd( fd );
 	return g_sys_close_func(fd);
 }
@@ -386,12 +625,26 @@ ssize_t read( int fd, void *buf, size_t nbyte )
 	int timeout = ( lp->read_timeout.tv_sec * 1000 ) 
 				+ ( lp->read_timeout.tv_usec / 1000 );
 
-	struct pollfd pf = { 0 };
-	pf.fd = fd;
-	pf.events = ( POLLIN | POLLERR | POLLHUP );
+	stCoUring_t *ring = get_uring( buf,nbyte );
+	if( ring )
+	{
+		return uring_read( ring,fd,buf,nbyte,0,false,timeout );
+	}
 
-	int pollret = poll( &pf,1,timeout );
+	// 边缘触发模式下先尝试读，无数据时再等待
+	if( lp->persist )
+	{
+		co_get_stat_ct()->ullIoSysCallCnt++;
+		ssize_t ret = g_sys_read_func( fd,buf,nbyte );
+		if( ret >= 0 || errno != EAGAIN )
+		{
+			return ret;
+		}
+	}
 
+	int pollret = co_wait_fd( lp,fd,POLLIN,timeout );
+
+	co_get_stat_ct()->ullIoSysCallCnt++;
 	ssize_t readret = g_sys_read_func( fd,(char*)buf ,nbyte );
 
 	if( readret < 0 )
@@ -425,6 +678,13 @@ ssize_t write( int fd, const void *buf, size_t nbyte )
 	int timeout = ( lp->write_timeout.tv_sec * 1000 ) 
 				+ ( lp->write_timeout.tv_usec / 1000 );
 
+	stCoUring_t *ring = get_uring( buf,nbyte );
+	if( ring )
+	{
+		return uring_write( ring,fd,buf,nbyte,0,false,timeout );
+	}
+
+	co_get_stat_ct()->ullIoSysCallCnt++;
 	ssize_t writeret = g_sys_write_func( fd,(const char*)buf + wrotelen,nbyte - wrotelen );
 
 	if (writeret == 0)
@@ -438,11 +698,9 @@ ssize_t write( int fd, const void *buf, size_t nbyte )
 	}
 	while( wrotelen < nbyte )
 	{
-		struct pollfd pf = { 0 };
-		pf.fd = fd;
-		pf.events = ( POLLOUT | POLLERR | POLLHUP );
-		poll( &pf,1,timeout );
+		co_wait_fd( lp,fd,POLLOUT,timeout );
         
+		co_get_stat_ct()->ullIoSysCallCnt++;
 		writeret = g_sys_write_func( fd,(const char*)buf + wrotelen,nbyte - wrotelen );
 		
 		if( writeret <= 0 )
@@ -483,17 +741,16 @@ ssize_t sendto(int socket, const void *message, size_t length,
 		return g_sys_sendto_func( socket,message,length,flags,dest_addr,dest_len );
 	}
 
+	co_get_stat_ct()->ullIoSysCallCnt++;
 	ssize_t ret = g_sys_sendto_func( socket,message,length,flags,dest_addr,dest_len );
 	if( ret < 0 && EAGAIN == errno )
 	{
 		int timeout = ( lp->write_timeout.tv_sec * 1000 ) 
 					+ ( lp->write_timeout.tv_usec / 1000 );
 
-		struct pollfd pf = { 0 };
-		pf.fd = socket;
-		pf.events = ( POLLOUT | POLLERR | POLLHUP );
-		poll( &pf,1,timeout );
+		co_wait_fd( lp,socket,POLLOUT,timeout );
 
+		co_get_stat_ct()->ullIoSysCallCnt++;
 		ret = g_sys_sendto_func( socket,message,length,flags,dest_addr,dest_len );
 
 	}
@@ -519,12 +776,19 @@ ssize_t recvfrom(int socket, void *buffer, size_t length,
 	int timeout = ( lp->read_timeout.tv_sec * 1000 ) 
 				+ ( lp->read_timeout.tv_usec / 1000 );
 
+	if( lp->persist )
+	{
+		co_get_stat_ct()->ullIoSysCallCnt++;
+		ssize_t ret = g_sys_recvfrom_func( socket,buffer,length,flags,address,address_len );
+		if( ret >= 0 || errno != EAGAIN )
+		{
+			return ret;
+		}
+	}
 
-	struct pollfd pf = { 0 };
-	pf.fd = socket;
-	pf.events = ( POLLIN | POLLERR | POLLHUP );
-	poll( &pf,1,timeout );
+	co_wait_fd( lp,socket,POLLIN,timeout );
 
+	co_get_stat_ct()->ullIoSysCallCnt++;
 	ssize_t ret = g_sys_recvfrom_func( socket,buffer,length,flags,address,address_len );
 	return ret;
 }
@@ -547,6 +811,13 @@ ssize_t send(int socket, const void *buffer, size_t length, int flags)
 	int timeout = ( lp->write_timeout.tv_sec * 1000 ) 
 				+ ( lp->write_timeout.tv_usec / 1000 );
 
+	stCoUring_t *ring = get_uring( buffer,length );
+	if( ring )
+	{
+		return uring_write( ring,socket,buffer,length,flags,true,timeout );
+	}
+
+	co_get_stat_ct()->ullIoSysCallCnt++;
 	ssize_t writeret = g_sys_send_func( socket,buffer,length,flags );
 	if (writeret == 0)
 	{
@@ -559,12 +830,9 @@ ssize_t send(int socket, const void *buffer, size_t length, int flags)
 	}
 	while( wrotelen < length )
 	{
+		co_wait_fd( lp,socket,POLLOUT,timeout );
 
-		struct pollfd pf = { 0 };
-		pf.fd = socket;
-		pf.events = ( POLLOUT | POLLERR | POLLHUP );
-		poll( &pf,1,timeout );
-
+		co_get_stat_ct()->ullIoSysCallCnt++;
 		writeret = g_sys_send_func( socket,(const char*)buffer + wrotelen,length - wrotelen,flags );
 		
 		if( writeret <= 0 )
@@ -597,12 +865,25 @@ ssize_t recv( int socket, void *buffer, size_t length, int flags )
 	int timeout = ( lp->read_timeout.tv_sec * 1000 ) 
 				+ ( lp->read_timeout.tv_usec / 1000 );
 
-	struct pollfd pf = { 0 };
-	pf.fd = socket;
-	pf.events = ( POLLIN | POLLERR | POLLHUP );
+	stCoUring_t *ring = get_uring( buffer,length );
+	if( ring )
+	{
+		return uring_read( ring,socket,buffer,length,flags,true,timeout );
+	}
 
-	int pollret = poll( &pf,1,timeout );
+	if( lp->persist )
+	{
+		co_get_stat_ct()->ullIoSysCallCnt++;
+		ssize_t ret = g_sys_recv_func( socket,buffer,length,flags );
+		if( ret >= 0 || errno != EAGAIN )
+		{
+			return ret;
+		}
+	}
+
+	int pollret = co_wait_fd( lp,socket,POLLIN,timeout );
 
+	co_get_stat_ct()->ullIoSysCallCnt++;
 	ssize_t readret = g_sys_recv_func( socket,buffer,length,flags );
 
 	if( readret < 0 )
@@ -615,6 +896,292 @@ ssize_t recv( int socket, void *buffer, size_t length, int flags )
 	
 }
 
+ssize_t readv( int fd, const struct iovec *iov, int iovcnt )
+{
+	HOOK_SYS_FUNC( readv );
+
+	if( !co_is_enable_sys_hook() )
+	{
+		return g_sys_readv_func( fd,iov,iovcnt );
+	}
+	rpchook_t *lp = get_by_fd( fd );
+
+	if( !lp || ( O_NONBLOCK & lp->user_flag ) )
+	{
+		return g_sys_readv_func( fd,iov,iovcnt );
+	}
+	int timeout = ( lp->read_timeout.tv_sec * 1000 ) 
+				+ ( lp->read_timeout.tv_usec / 1000 );
+
+	if( lp->persist )
+	{
+		co_get_stat_ct()->ullIoSysCallCnt++;
+		ssize_t ret = g_sys_readv_func( fd,iov,iovcnt );
+		if( ret >= 0 || errno != EAGAIN )
+		{
+			return ret;
+		}
+	}
+
+	int pollret = co_wait_fd( lp,fd,POLLIN,timeout );
+
+	co_get_stat_ct()->ullIoSysCallCnt++;
+	ssize_t readret = g_sys_readv_func( fd,iov,iovcnt );
+
+	if( readret < 0 )
+	{
+		co_log_err("CO_ERR: readv fd %d ret %ld errno %d poll ret %d timeout %d\n",
+					fd,readret,errno,pollret,timeout);
+	}
+
+	return readret;
+}
+
+ssize_t writev( int fd, const struct iovec *iov, int iovcnt )
+{
+	HOOK_SYS_FUNC( writev );
+
+	if( !co_is_enable_sys_hook() )
+	{
+		return g_sys_writev_func( fd,iov,iovcnt );
+	}
+	rpchook_t *lp = get_by_fd( fd );
+
+	if( !lp || ( O_NONBLOCK & lp->user_flag ) )
+	{
+		return g_sys_writev_func( fd,iov,iovcnt );
+	}
+	int timeout = ( lp->write_timeout.tv_sec * 1000 ) 
+				+ ( lp->write_timeout.tv_usec / 1000 );
+
+	size_t total = 0;
+	for( int i = 0; i < iovcnt; i++ )
+	{
+		total += iov[i].iov_len;
+	}
+
+	co_get_stat_ct()->ullIoSysCallCnt++;
+	ssize_t writeret = g_sys_writev_func( fd,iov,iovcnt );
+	if( writeret == 0 )
+	{
+		return writeret;
+	}
+
+	size_t wrotelen = 0;
+	if( writeret > 0 )
+	{
+		wrotelen += writeret;
+	}
+
+	// 部分写入时跳过已写完的iov，当前iov剩余部分单独写（不能修改调用者的iov数组）
+	int idx = 0;
+	size_t offset = wrotelen;
+	while( wrotelen < total )
+	{
+		while( idx < iovcnt && offset >= iov[idx].iov_len )
+		{
+			offset -= iov[idx].iov_len;
+			idx++;
+		}
+
+		co_wait_fd( lp,fd,POLLOUT,timeout );
+
+		co_get_stat_ct()->ullIoSysCallCnt++;
+		if( offset )
+		{
+			writeret = g_sys_write_func( fd,(const char*)iov[idx].iov_base + offset,iov[idx].iov_len - offset );
+		}
+		else
+		{
+			writeret = g_sys_writev_func( fd,iov + idx,iovcnt - idx );
+		}
+
+		if( writeret <= 0 )
+		{
+			co_log_err("CO_ERR: writev fd %d ret %d errno %d (%s)\n",
+					fd, writeret, errno, strerror(errno));
+			break;
+		}
+		wrotelen += writeret;
+		offset += writeret;
+	}
+	if( writeret <= 0 && wrotelen == 0 )
+	{
+		return writeret;
+	}
+	return wrotelen;
+}
+
+ssize_t sendmsg( int socket, const struct msghdr *message, int flags )
+{
+	HOOK_SYS_FUNC( sendmsg );
+	if( !co_is_enable_sys_hook() )
+	{
+		return g_sys_sendmsg_func( socket,message,flags );
+	}
+
+	rpchook_t *lp = get_by_fd( socket );
+	if( !lp || ( O_NONBLOCK & lp->user_flag ) )
+	{
+		return g_sys_sendmsg_func( socket,message,flags );
+	}
+
+	co_get_stat_ct()->ullIoSysCallCnt++;
+	ssize_t ret = g_sys_sendmsg_func( socket,message,flags );
+	if( ret < 0 && EAGAIN == errno )
+	{
+		int timeout = ( lp->write_timeout.tv_sec * 1000 ) 
+					+ ( lp->write_timeout.tv_usec / 1000 );
+
+		co_wait_fd( lp,socket,POLLOUT,timeout );
+
+		co_get_stat_ct()->ullIoSysCallCnt++;
+		ret = g_sys_sendmsg_func( socket,message,flags );
+	}
+	return ret;
+}
+
+ssize_t recvmsg( int socket, struct msghdr *message, int flags )
+{
+	HOOK_SYS_FUNC( recvmsg );
+	if( !co_is_enable_sys_hook() )
+	{
+		return g_sys_recvmsg_func( socket,message,flags );
+	}
+
+	rpchook_t *lp = get_by_fd( socket );
+	if( !lp || ( O_NONBLOCK & lp->user_flag ) )
+	{
+		return g_sys_recvmsg_func( socket,message,flags );
+	}
+
+	int timeout = ( lp->read_timeout.tv_sec * 1000 ) 
+				+ ( lp->read_timeout.tv_usec / 1000 );
+
+	if( lp->persist )
+	{
+		co_get_stat_ct()->ullIoSysCallCnt++;
+		ssize_t ret = g_sys_recvmsg_func( socket,message,flags );
+		if( ret >= 0 || errno != EAGAIN )
+		{
+			return ret;
+		}
+	}
+
+	co_wait_fd( lp,socket,POLLIN,timeout );
+
+	co_get_stat_ct()->ullIoSysCallCnt++;
+	return g_sys_recvmsg_func( socket,message,flags );
+}
+
+int sendmmsg( int socket, struct mmsghdr *msgvec, unsigned int vlen, int flags )
+{
+	HOOK_SYS_FUNC( sendmmsg );
+	if( !co_is_enable_sys_hook() )
+	{
+		return g_sys_sendmmsg_func( socket,msgvec,vlen,flags );
+	}
+
+	rpchook_t *lp = get_by_fd( socket );
+	if( !lp || ( O_NONBLOCK & lp->user_flag ) )
+	{
+		return g_sys_sendmmsg_func( socket,msgvec,vlen,flags );
+	}
+
+	co_get_stat_ct()->ullIoSysCallCnt++;
+	int ret = g_sys_sendmmsg_func( socket,msgvec,vlen,flags );
+	if( ret < 0 && EAGAIN == errno )
+	{
+		int timeout = ( lp->write_timeout.tv_sec * 1000 ) 
+					+ ( lp->write_timeout.tv_usec / 1000 );
+
+		co_wait_fd( lp,socket,POLLOUT,timeout );
+
+		co_get_stat_ct()->ullIoSysCallCnt++;
+		ret = g_sys_sendmmsg_func( socket,msgvec,vlen,flags );
+	}
+	return ret;
+}
+
+// 底层fd是非阻塞的，一次只收取当前已到达的报文（至少一个），timeout参数透传给系统调用
+int recvmmsg( int socket, struct mmsghdr *msgvec, unsigned int vlen, int flags, struct timespec *tmo )
+{
+	HOOK_SYS_FUNC( recvmmsg );
+	if( !co_is_enable_sys_hook() )
+	{
+		return g_sys_recvmmsg_func( socket,msgvec,vlen,flags,tmo );
+	}
+
+	rpchook_t *lp = get_by_fd( socket );
+	if( !lp || ( O_NONBLOCK & lp->user_flag ) )
+	{
+		return g_sys_recvmmsg_func( socket,msgvec,vlen,flags,tmo );
+	}
+
+	int timeout = ( lp->read_timeout.tv_sec * 1000 ) 
+				+ ( lp->read_timeout.tv_usec / 1000 );
+
+	if( lp->persist )
+	{
+		co_get_stat_ct()->ullIoSysCallCnt++;
+		int ret = g_sys_recvmmsg_func( socket,msgvec,vlen,flags,tmo );
+		if( ret >= 0 || errno != EAGAIN )
+		{
+			return ret;
+		}
+	}
+
+	co_wait_fd( lp,socket,POLLIN,timeout );
+
+	co_get_stat_ct()->ullIoSysCallCnt++;
+	return g_sys_recvmmsg_func( socket,msgvec,vlen,flags,tmo );
+}
+
+// 接受的fd同co_accept一样注册到hook中，SOCK_NONBLOCK记为用户的非阻塞标志
+int accept4( int socket, struct sockaddr *address, socklen_t *address_len, int flags )
+{
+	HOOK_SYS_FUNC( accept4 );
+	if( !co_is_enable_sys_hook() )
+	{
+		return g_sys_accept4_func( socket,address,address_len,flags );
+	}
+
+	rpchook_t *lp = get_by_fd( socket );
+	if( !lp )
+	{
+		return g_sys_accept4_func( socket,address,address_len,flags );
+	}
+
+	co_get_stat_ct()->ullIoSysCallCnt++;
+	int cli = g_sys_accept4_func( socket,address,address_len,flags | SOCK_NONBLOCK );
+	if( cli < 0 && EAGAIN == errno && !( O_NONBLOCK & lp->user_flag ) )
+	{
+		int timeout = ( lp->read_timeout.tv_sec * 1000 ) 
+					+ ( lp->read_timeout.tv_usec / 1000 );
+
+		co_wait_fd( lp,socket,POLLIN,timeout );
+
+		co_get_stat_ct()->ullIoSysCallCnt++;
+		cli = g_sys_accept4_func( socket,address,address_len,flags | SOCK_NONBLOCK );
+	}
+	if( cli < 0 )
+	{
+		return cli;
+	}
+
+	rpchook_t *clp = alloc_by_fd( cli );
+	if( clp )
+	{
+		clp->domain = lp->domain;
+		clp->user_flag = ( flags & SOCK_NONBLOCK ) ? O_NONBLOCK : 0;
+	}
+	else if( !( flags & SOCK_NONBLOCK ) )
+	{
+		g_sys_fcntl_func( cli,F_SETFL,g_sys_fcntl_func( cli,F_GETFL,0 ) & ~O_NONBLOCK );
+	}
+	return cli;
+}
+
 extern int co_poll_inner( stCoEpoll_t *ctx,struct pollfd fds[], nfds_t nfds, int timeout, poll_pfn_t pollfunc);
 
 int poll(struct pollfd fds[], nfds_t nfds, int timeout)
@@ -626,6 +1193,33 @@ int poll(struct pollfd fds[], nfds_t nfds, int timeout)
 	{
 		return g_sys_poll_func( fds,nfds,timeout );
 	}
+
+	// 没有有效fd时就是睡眠
+	if( timeout > 0 && ( nfds == 0 || ( nfds == 1 && fds[0].fd < 0 ) ) )
+	{
+		if( nfds == 1 )
+		{
+			fds[0].revents = 0;
+		}
+		co_sleep_ms( timeout );
+		return 0;
+	}
+
+	// 持久化注册的fd不能再EPOLL_CTL_ADD，先检查当前状态，未就绪再等待边缘事件
+	if( nfds == 1 && fds[0].fd > -1 )
+	{
+		rpchook_t *lp = get_by_fd( fds[0].fd );
+		stCoFdEvent_t *ev = ( lp && lp->persist ) ? get_fd_event( lp,fds[0].fd ) : NULL;
+		if( ev )
+		{
+			int ret = g_sys_poll_func( fds,nfds,0 );
+			if( ret != 0 )
+			{
+				return ret;
+			}
+			return co_fd_event_wait( ev,fds[0].events,&fds[0].revents,timeout );
+		}
+	}
     
     pollfd *fds_merge = NULL;
     nfds_t nfds_merge = 0;
@@ -892,9 +1486,7 @@ unsigned int sleep(unsigned int seconds)
         return g_sys_sleep_func( seconds );
     }
     
-    struct pollfd pf = { 0 };
-    pf.fd = -1;
-    poll( &pf,1,seconds * 1000 );
+    co_sleep_ms( seconds * 1000 );
     
     return 0;
 }
@@ -908,9 +1500,7 @@ int usleep(useconds_t usec)
         return g_sys_usleep_func( usec );
     }
     
-    struct pollfd pf = { 0 };
-    pf.fd = -1;
-    poll( &pf,1, (usec + 999) / 1000 );
+    co_sleep_ms( (usec + 999) / 1000 );
     
     return 0;
 }
@@ -952,6 +1542,68 @@ int co_set_nonblock(int fd)
     return fcntl(fd, F_SETFL, iFlags);
 }
 
+int co_wait_readable( int fd )
+{
+	rpchook_t *lp = co_is_enable_sys_hook() ? get_by_fd( fd ) : NULL;
+	if( !lp )
+	{
+		struct pollfd pf = { 0 };
+		pf.fd = fd;
+		pf.events = ( POLLIN | POLLERR | POLLHUP );
+		return poll( &pf,1,-1 );
+	}
+
+	int timeout = ( lp->read_timeout.tv_sec * 1000 ) 
+				+ ( lp->read_timeout.tv_usec / 1000 );
+	return co_wait_fd( lp,fd,POLLIN,timeout );
+}
+
+int co_set_fd_callback( int fd,short events,pfn_co_fd_callback_t pfn,void *arg )
+{
+	// 回调在事件循环中（主协程）调用，主协程未开启hook，这里不检查hook开关
+	rpchook_t *lp = get_by_fd( fd );
+	if( !lp )
+	{
+		errno = EBADF;
+		return -1;
+	}
+
+	// 同一fd在本线程的等待也要走持久化事件，避免再次EPOLL_CTL_ADD
+	lp->persist = 1;
+	stCoFdEvent_t *ev = get_fd_event( lp,fd );
+	if( !ev )
+	{
+		return -1;
+	}
+
+	co_fd_event_set_callback( ev,events,pfn,arg );
+	return 0;
+}
+
+ssize_t co_read_nowait( int fd,void *buf,size_t nbyte )
+{
+	HOOK_SYS_FUNC( read );
+
+	co_get_stat_ct()->ullIoSysCallCnt++;
+	return g_sys_read_func( fd,buf,nbyte );
+}
+
+ssize_t co_write_nowait( int fd,const void *buf,size_t nbyte )
+{
+	HOOK_SYS_FUNC( write );
+
+	co_get_stat_ct()->ullIoSysCallCnt++;
+	return g_sys_write_func( fd,buf,nbyte );
+}
+
+ssize_t co_writev_nowait( int fd,const struct iovec *iov,int iovcnt )
+{
+	HOOK_SYS_FUNC( writev );
+
+	co_get_stat_ct()->ullIoSysCallCnt++;
+	return g_sys_writev_func( fd,iov,iovcnt );
+}
+
 /*
 int co_pipe( int pfd[2] )
 {
@@ -19,6 +19,7 @@
 #include "co_routine.h"
 #include "co_routine_inner.h"
 #include "co_epoll.h"
+#include "co_uring.h"
 
 #include <string.h>
 #include <stdlib.h>
@@ -26,6 +27,7 @@
 #include <stdarg.h>
 #include <string>
 #include <map>
+#include <vector>
 
 #include <poll.h>
 #include <sys/time.h>
@@ -42,8 +44,9 @@
 #include <limits.h>
 #include <execinfo.h>
 
-#ifdef STACK_PROTECT
-	#include <sys/mman.h>
+#include <sys/mman.h>
+#if !defined( __APPLE__ ) && !defined( __FreeBSD__ )
+#include <sys/eventfd.h>
 #endif
 
 extern "C"
@@ -63,6 +66,10 @@ struct stCoRoutineEnv_t
 	//for copy stack log lastco and nextco
 	stCoRoutine_t* pending_co;
 	stCoRoutine_t* occupy_co;
+
+	//recycled coroutine objects
+	stCoRoutine_t* pFreeCo;
+	int iFreeCoNum;
 };
 
 void co_log_err( const char *fmt,... )
@@ -126,32 +133,40 @@ static unsigned long long GetTickMS()
 #endif
 }
 
+// 线程id缓存在线程变量中，只在首次调用时取一次（不再每次调用getpid检查fork），fork后由子进程回调清除
+static __thread pid_t g_tid = 0;
+
+static void ResetTidAfterFork()
+{
+    g_tid = 0;
+}
+
+static int g_tidAtFork = pthread_atfork( NULL,NULL,ResetTidAfterFork );
+
 pid_t GetPid()
 {
-    static __thread pid_t pid = 0;
-    static __thread pid_t tid = 0;
-    if( !pid || !tid || pid != getpid() )
+    if( !g_tid )
     {
-        pid = getpid();
+        pid_t tid;
 #if defined( __APPLE__ )
         tid = ::pthread_mach_thread_np(::pthread_self());
 		//tid = syscall( SYS_gettid );
 		if( -1 == (long)tid )
 		{
-			tid = pid;
+			tid = getpid();
 		}
 #elif defined( __FreeBSD__ )
 		syscall(SYS_thr_self, &tid);
 		if( tid < 0 )
 		{
-			tid = pid;
+			tid = getpid();
 		}
 #else 
         tid = syscall( __NR_gettid );
 #endif
-
+        g_tid = tid;
     }
-    return tid;
+    return g_tid;
 
 }
 /*
@@ -281,62 +296,245 @@ void inline Join( TLink*apLink,TLink *apOther )
 }
 
 /////////////////for copy stack //////////////////////////
+// 栈内存用mmap(MAP_NORESERVE)分配，只有实际用到的页才占用物理内存
 stStackMem_t* co_alloc_stackmem(unsigned int stack_size)
 {
-#ifdef STACK_PROTECT
-	static uint64_t pagesize = sysconf(_SC_PAGE_SIZE);
-	static uint64_t mask = pagesize - 1;
-#endif
+	static size_t pagesize = sysconf(_SC_PAGE_SIZE);
 
 	stStackMem_t* stack_mem = (stStackMem_t*)malloc(sizeof(stStackMem_t));
 	stack_mem->occupy_co= NULL;
 	stack_mem->stack_size = stack_size;
+	stack_mem->owner = NULL;
+	stack_mem->co_num = 0;
+
+	size_t size = ( stack_size + pagesize - 1 ) & ~( pagesize - 1 );
 #ifdef STACK_PROTECT
 	// 加入保护页，堆栈溢出时能第一时间报错
-	// 保护页处于内存块低地址空间，分配的低地址空间的第一个完整页作为保护页
-	// 会有一定内存空间被浪费
-	stack_mem->origin = (char*)malloc(stack_size + pagesize * 2);
-	void *protect_start = (void *)((uint64_t)(stack_mem->origin + pagesize) & ~mask);
-	stack_mem->stack_buffer = (char*)protect_start + pagesize;
-	if (mprotect(protect_start, pagesize, PROT_NONE) == -1) {
-		perror("mprotect");
-        exit(0);
-    }
-
+	// 保护页处于内存块低地址空间
+	size_t guard = pagesize;
 #else
-	stack_mem->stack_buffer = (char*)malloc(stack_size);
+	size_t guard = 0;
 #endif
+	stack_mem->map_size = size + guard;
+	stack_mem->origin = (char*)mmap(NULL, stack_mem->map_size, PROT_READ | PROT_WRITE,
+									MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+	// 分配失败时（如映射数达到vm.max_map_count）返回NULL，由调用者处理
+	if (stack_mem->origin == MAP_FAILED) {
+		co_log_err("CO_ERR: co_alloc_stackmem mmap %zu bytes failed errno %d\n", stack_mem->map_size, errno);
+		free(stack_mem);
+		return NULL;
+	}
+	if (guard && mprotect(stack_mem->origin, guard, PROT_NONE) == -1) {
+		co_log_err("CO_ERR: co_alloc_stackmem mprotect guard page failed errno %d\n", errno);
+		munmap(stack_mem->origin, stack_mem->map_size);
+		free(stack_mem);
+		return NULL;
+	}
+
+	stack_mem->stack_buffer = stack_mem->origin + guard;
 	stack_mem->stack_bp = stack_mem->stack_buffer + stack_size;
 	return stack_mem;
 }
 
+static void co_free_stackmem(stStackMem_t* stack_mem)
+{
+	munmap(stack_mem->origin, stack_mem->map_size);
+	free(stack_mem);
+}
+
+// iCount为共享栈数量上限，共享栈按需创建：已分配的共享栈上都有存活协程时才创建新的
 stShareStack_t* co_alloc_sharestack(int count, int stack_size)
 {
 	stShareStack_t* share_stack = (stShareStack_t*)malloc(sizeof(stShareStack_t));
 	share_stack->alloc_idx = 0;
 	share_stack->stack_size = stack_size;
+	share_stack->co_num = 0;
+	share_stack->hot_count = 0;
 
 	//alloc stack array
-	share_stack->count = count;
-	stStackMem_t** stack_array = (stStackMem_t**)calloc(count, sizeof(stStackMem_t*));
-	for (int i = 0; i < count; i++)
-	{
-		stack_array[i] = co_alloc_stackmem(stack_size);
-	}
-	share_stack->stack_array = stack_array;
+	share_stack->count = 0;
+	share_stack->max_count = count > 0 ? count : 1;
+	share_stack->stack_array = (stStackMem_t**)calloc(share_stack->max_count, sizeof(stStackMem_t*));
 	return share_stack;
 }
 
+// 选择协程数最少（争用最少）的共享栈，跳过有热点协程的栈；没有空闲栈且未达上限时创建新栈，
+// 所有共享栈都被热点协程占用时仍选择协程数最少的栈；一个栈都没有且创建失败时返回NULL
 static stStackMem_t* co_get_stackmem(stShareStack_t* share_stack)
 {
 	if (!share_stack)
 	{
 		return NULL;
 	}
-	int idx = share_stack->alloc_idx % share_stack->count;
-	share_stack->alloc_idx++;
 
-	return share_stack->stack_array[idx];
+	stStackMem_t* stack_mem = NULL;
+	int count = share_stack->count;
+	if (count > share_stack->hot_count)
+	{
+		// 从轮转位置开始查找，协程数相同时依次分配到不同的栈
+		int start = share_stack->alloc_idx++ % count;
+		for (int i = 0; i < count; i++)
+		{
+			stStackMem_t* mem = share_stack->stack_array[(start + i) % count];
+			if (mem->hot_num == 0 && (!stack_mem || mem->co_num < stack_mem->co_num))
+			{
+				stack_mem = mem;
+				if (mem->co_num == 0)
+				{
+					break;
+				}
+			}
+		}
+	}
+
+	if ((!stack_mem || stack_mem->co_num > 0) && count < share_stack->max_count)
+	{
+		// 创建失败时继续使用已有的栈
+		stStackMem_t* new_mem = co_alloc_stackmem(share_stack->stack_size);
+		if (new_mem)
+		{
+			stack_mem = new_mem;
+			stack_mem->owner = share_stack;
+			share_stack->stack_array[share_stack->count++] = stack_mem;
+		}
+	}
+	if (!stack_mem && count > 0)
+	{
+		// 共享栈都被热点协程占用且已达上限时仍分配到协程数最少的栈（不为此创建独立栈，独立栈由上层按上限分配）
+		stack_mem = share_stack->stack_array[0];
+		for (int i = 1; i < count; i++)
+		{
+			if (share_stack->stack_array[i]->co_num < stack_mem->co_num)
+			{
+				stack_mem = share_stack->stack_array[i];
+			}
+		}
+	}
+
+	if (stack_mem)
+	{
+		stack_mem->co_num++;
+		share_stack->co_num++;
+	}
+	return stack_mem;
+}
+
+// 协程不再使用共享栈时调用
+static void co_put_stackmem(stCoRoutine_t* co)
+{
+	stStackMem_t* stack_mem = co->stack_mem;
+	if (stack_mem->occupy_co == co) {
+		stack_mem->occupy_co = NULL;
+	}
+	stack_mem->co_num--;
+	stack_mem->owner->co_num--;
+	if (co->cHot && --stack_mem->hot_num == 0) {
+		stack_mem->owner->hot_count--;
+	}
+}
+
+int co_get_sharestack_count(stShareStack_t* share_stack)
+{
+	return share_stack->count;
+}
+
+size_t co_get_sharestack_resident_size(stShareStack_t* share_stack)
+{
+	static size_t pagesize = sysconf(_SC_PAGE_SIZE);
+
+	size_t total = 0;
+	std::vector<unsigned char> vec;
+	for (int i = 0; i < share_stack->count; i++)
+	{
+		stStackMem_t* stack_mem = share_stack->stack_array[i];
+		size_t pages = stack_mem->map_size / pagesize;
+		vec.resize(pages);
+		if (mincore(stack_mem->origin, stack_mem->map_size, (
+#if defined( __APPLE__ ) || defined( __FreeBSD__ )
+						char*
+#else
+						unsigned char*
+#endif
+						)&vec[0]) == -1)
+		{
+			continue;
+		}
+		for (size_t j = 0; j < pages; j++)
+		{
+			if (vec[j] & 1)
+			{
+				total += pagesize;
+			}
+		}
+	}
+	return total;
+}
+
+// 共享栈保存缓冲区的线程内分级内存池：按2的幂分级（最小256字节），释放的缓冲区放回对应级别的空闲链表，
+// 协程切换时新长度不超过原缓冲区容量则直接复用，避免每次切换都free+malloc
+#define SAVE_BUFFER_MIN_SHIFT 8
+#define SAVE_BUFFER_CLASS_NUM 16 // 256B ~ 8MB
+#define SAVE_BUFFER_POOL_MAX_BYTES (8 * 1024 * 1024) // 每线程缓存的空闲缓冲区总大小上限
+
+struct stSaveBufferPool_t
+{
+	void *pFree[ SAVE_BUFFER_CLASS_NUM ];
+	size_t iFreeBytes;
+};
+static __thread stSaveBufferPool_t g_saveBufferPool;
+
+static inline int SaveBufferClass( unsigned int len )
+{
+	if( len <= ( 1u << SAVE_BUFFER_MIN_SHIFT ) ) return 0;
+	return 32 - __builtin_clz( len - 1 ) - SAVE_BUFFER_MIN_SHIFT;
+}
+
+static char *AllocSaveBuffer( unsigned int len,unsigned int *capacity )
+{
+	int cls = SaveBufferClass( len );
+	if( cls >= SAVE_BUFFER_CLASS_NUM )
+	{
+		*capacity = len;
+		co_get_stat_ct()->ullSaveBufferAllocCnt++;
+		return (char*)malloc( len );
+	}
+
+	*capacity = 1u << ( cls + SAVE_BUFFER_MIN_SHIFT );
+	void *p = g_saveBufferPool.pFree[ cls ];
+	if( p )
+	{
+		g_saveBufferPool.pFree[ cls ] = *(void**)p;
+		g_saveBufferPool.iFreeBytes -= *capacity;
+		return (char*)p;
+	}
+
+	co_get_stat_ct()->ullSaveBufferAllocCnt++;
+	return (char*)malloc( *capacity );
+}
+
+static void FreeSaveBuffer( char *buf,unsigned int capacity )
+{
+	int cls = SaveBufferClass( capacity );
+	if( cls >= SAVE_BUFFER_CLASS_NUM || ( 1u << ( cls + SAVE_BUFFER_MIN_SHIFT ) ) != capacity
+	   || g_saveBufferPool.iFreeBytes + capacity > SAVE_BUFFER_POOL_MAX_BYTES )
+	{
+		free( buf );
+		return;
+	}
+
+	*(void**)buf = g_saveBufferPool.pFree[ cls ];
+	g_saveBufferPool.pFree[ cls ] = buf;
+	g_saveBufferPool.iFreeBytes += capacity;
+}
+
+static void ReleaseSaveBuffer( stCoRoutine_t *co )
+{
+	if( co->save_buffer )
+	{
+		FreeSaveBuffer( co->save_buffer,co->save_capacity );
+		co->save_buffer = NULL;
+		co->save_capacity = 0;
+	}
 }
 
 
@@ -359,258 +557,284 @@ struct stCoEpoll_t
 	co_epoll_res *result; 
 
 	unsigned long long lastLoopStartTime;
-};
-
-typedef void (*OnPreparePfn_t)( stTimeoutItem_t *,struct epoll_event &ev, stTimeoutItemLink_t *active );
-typedef void (*OnProcessPfn_t)( stTimeoutItem_t *);
 
-struct stTimeoutItem_t
-{
-	stTimeoutItem_t *pPrev;
-	stTimeoutItem_t *pNext;
-	stTimeoutItemLink_t *pLink;
-
-	unsigned long long ullExpireTime;
+	struct stCoFdEvent_t *pOrphanFdEvents; // 已注销待回收的持久化fd事件（可能由其他线程压入）
+	int iNotifyFd; // 其他线程压入待回收fd事件时用于唤醒事件循环的eventfd
+	int iNotifyPending; // 已写入eventfd且事件循环尚未处理（合并多次唤醒）
+	struct stTimeoutItem_t *pNotifyItem; // eventfd在epoll中的事件项
 
-	OnPreparePfn_t pfnPrepare;
-	OnProcessPfn_t pfnProcess;
-
-	void *pArg; // routine 
-	bool bTimeout;
+	struct stCoUring_t *pUring; // io_uring后端（开启且内核支持时才创建）
+	struct stTimeoutItem_t *pUringItem; // ring fd在epoll中的事件项
+	struct stCoUringOp_t *pFreeUringOps;
+	char cUringFailed;
 };
 
-struct stTimeoutItemLink_t
-{
-	stTimeoutItem_t *head;
-	stTimeoutItem_t *tail;
-};
+// 多级时间轮：第0级256个槽，精度1毫秒；第1~4级各64个槽，精度依次为2^8、2^14、2^20、2^26毫秒，共覆盖2^32毫秒（约49天）
+// 插入和删除都是O(1)（删除仍然用RemoveFromLink），上级槽在时间走到时逐级下放到低级，各级用位图记录非空槽用于快速查找下一超时
+#define TW_LEVEL_NUM 5
+#define TW_ROOT_BITS 8
+#define TW_LEVEL_BITS 6
+#define TW_ROOT_SIZE (1 << TW_ROOT_BITS)
+#define TW_LEVEL_SIZE (1 << TW_LEVEL_BITS)
+#define TW_MAX_SPAN (1ULL << (TW_ROOT_BITS + TW_LEVEL_BITS * (TW_LEVEL_NUM - 1)))
 
 struct stTimeout_t
 {
-    stTimeoutItemLink_t *pItems;
-    int iItemSize;
-    uint64_t *pFlags;
-    int iFlagSize;
-    unsigned long long ullStart;
-    long long llStartIdx;
+    stTimeoutItemLink_t aRoot[ TW_ROOT_SIZE ];
+    stTimeoutItemLink_t aLevel[ TW_LEVEL_NUM - 1 ][ TW_LEVEL_SIZE ];
+    uint64_t aRootFlags[ TW_ROOT_SIZE >> 6 ];
+    uint64_t aLevelFlags[ TW_LEVEL_NUM - 1 ];
+    // 上级槽中最早的超时时间，删除时不更新，只作为下界使用，过期时再遍历槽重新计算
+    unsigned long long aLevelMin[ TW_LEVEL_NUM - 1 ][ TW_LEVEL_SIZE ];
+    unsigned long long ullCurr; // 下一个待处理的毫秒
 };
 
-stTimeout_t *AllocTimeout( int iSize )
+static inline int TimeoutLevelShift( int level )
 {
-    assert((iSize & (iSize-1))==0);
-    if (iSize & (iSize-1)) {
-        co_log_err("CO_ERR: AllocTimeout line %d iSize is not power of 2\n", __LINE__);
-        return NULL;
-    } else if (iSize < 1024) {
-        co_log_err("CO_ERR: AllocTimeout line %d iSize is too small\n", __LINE__);
-        return NULL;
-    }
-    
-	stTimeout_t *lp = (stTimeout_t*)calloc( 1,sizeof(stTimeout_t) );	
+    return TW_ROOT_BITS + TW_LEVEL_BITS * (level - 1);
+}
 
-	lp->iItemSize = iSize;
-	lp->pItems = (stTimeoutItemLink_t*)calloc( 1,sizeof(stTimeoutItemLink_t) * lp->iItemSize );
-    lp->iFlagSize = iSize >> 6;
-    lp->pFlags = (uint64_t*)calloc( 1, 8 * lp->iFlagSize);
-	lp->ullStart = GetTickMS();
-	lp->llStartIdx = 0;
+stTimeout_t *AllocTimeout()
+{
+	stTimeout_t *lp = (stTimeout_t*)calloc( 1,sizeof(stTimeout_t) );
+    memset( lp->aLevelMin,0xff,sizeof(lp->aLevelMin) );
+	lp->ullCurr = GetTickMS();
 
 	return lp;
 }
 
 void FreeTimeout( stTimeout_t *apTimeout )
 {
-	free( apTimeout->pItems );
 	free ( apTimeout );
 }
 
-int AddTimeout( stTimeout_t *apTimeout,stTimeoutItem_t *apItem ,unsigned long long allNow )
+// 按到期时间放入对应级别的槽，超出时间轮范围的放在最远处，到期后由co_eventloop重新加入
+static void PlaceTimeout( stTimeout_t *apTimeout,stTimeoutItem_t *apItem )
 {
-	if( apTimeout->ullStart == 0 )
-	{
-		apTimeout->ullStart = allNow;
-		apTimeout->llStartIdx = 0;
-	}
-    
-	if( allNow < apTimeout->ullStart )
-	{
-		co_log_err("CO_ERR: AddTimeout line %d allNow %llu < apTimeout->ullStart %llu\n",
-					__LINE__,allNow,apTimeout->ullStart);
+    unsigned long long expire = apItem->ullExpireTime;
+    if( expire < apTimeout->ullCurr )
+    {
+        expire = apTimeout->ullCurr;
+    }
 
-		return __LINE__;
-	}
-    
+    unsigned long long diff = expire - apTimeout->ullCurr;
+    if( diff < TW_ROOT_SIZE )
+    {
+        int idx = expire & (TW_ROOT_SIZE - 1);
+        AddTail( apTimeout->aRoot + idx,apItem );
+        apTimeout->aRootFlags[idx >> 6] |= uint64_t(1) << (idx & 63);
+        return;
+    }
+
+    if( diff >= TW_MAX_SPAN )
+    {
+        expire = apTimeout->ullCurr + TW_MAX_SPAN - 1;
+        diff = TW_MAX_SPAN - 1;
+    }
+
+    int level = 1;
+    while( diff >= (1ULL << (TimeoutLevelShift( level ) + TW_LEVEL_BITS)) )
+    {
+        level++;
+    }
+
+    int idx = (expire >> TimeoutLevelShift( level )) & (TW_LEVEL_SIZE - 1);
+    AddTail( &apTimeout->aLevel[level - 1][idx],apItem );
+    apTimeout->aLevelFlags[level - 1] |= uint64_t(1) << idx;
+    if( expire < apTimeout->aLevelMin[level - 1][idx] )
+    {
+        apTimeout->aLevelMin[level - 1][idx] = expire;
+    }
+}
+
+int AddTimeout( stTimeout_t *apTimeout,stTimeoutItem_t *apItem ,unsigned long long allNow )
+{
 	if( apItem->ullExpireTime < allNow )
 	{
-		co_log_err("CO_ERR: AddTimeout line %d apItem->ullExpireTime %llu allNow %llu apTimeout->ullStart %llu\n",
-					__LINE__,apItem->ullExpireTime,allNow,apTimeout->ullStart);
+		co_log_err("CO_ERR: AddTimeout line %d apItem->ullExpireTime %llu allNow %llu apTimeout->ullCurr %llu\n",
+					__LINE__,apItem->ullExpireTime,allNow,apTimeout->ullCurr);
 
 		return __LINE__;
 	}
-    
-	unsigned long long diff = apItem->ullExpireTime - apTimeout->ullStart;
-
-	if( diff >= (unsigned long long)apTimeout->iItemSize )
-	{
-		diff = apTimeout->iItemSize - 1;
-		//co_log_err("CO_ERR: AddTimeout line %d diff %d\n",
-		//			__LINE__,diff);
 
-		//return __LINE__;
-	}
-    
-    int idx = ( apTimeout->llStartIdx + diff ) & (apTimeout->iItemSize - 1);
-	AddTail( apTimeout->pItems + idx , apItem );
-    
-    // set flag
-    apTimeout->pFlags[idx >> 6] |= uint64_t(1) << (idx & 63);
+    PlaceTimeout( apTimeout,apItem );
 
 	return 0;
 }
 
-inline void TakeAllTimeout( stCoEpoll_t *ctx,unsigned long long allNow,stTimeoutItemLink_t *apResult )
+// 把上级的一个槽下放到低级
+static void CascadeTimeout( stTimeout_t *apTimeout,int level,int idx )
 {
-    stTimeout_t *apTimeout = ctx->pTimeout;
-	if( apTimeout->ullStart == 0 )
-	{
-		apTimeout->ullStart = allNow;
-		apTimeout->llStartIdx = 0;
-	}
+    stTimeoutItemLink_t *link = &apTimeout->aLevel[level - 1][idx];
+    stTimeoutItem_t *lp = link->head;
 
-	if( allNow < apTimeout->ullStart )
-	{
-        co_log_err("CO_ERR: TakeAllTimeout line %d allNow %llu < apTimeout->ullStart %llu\n",
-                   __LINE__,allNow,apTimeout->ullStart);
-        
-		return ;
-	}
-    
-	int cnt = allNow - apTimeout->ullStart + 1;
-	if( cnt > apTimeout->iItemSize )
-	{
-		cnt = apTimeout->iItemSize;
-	}
-    
-	if( cnt < 0 )
-	{
-		return;
-	}
-    
-	for( int i = 0; i<cnt; i++)
-	{
-		int idx = ( apTimeout->llStartIdx + i) & (apTimeout->iItemSize - 1);
-        
-        if ((apTimeout->pItems + idx)->head) {
-            // 清flag
-            apTimeout->pFlags[idx >> 6] &= ~(uint64_t(1) << (idx & 63));
-            
-            Join<stTimeoutItem_t,stTimeoutItemLink_t>( apResult,apTimeout->pItems + idx  );
-        }
-	}
-    
-	apTimeout->ullStart = allNow;
-	apTimeout->llStartIdx = (apTimeout->llStartIdx + cnt - 1) & (apTimeout->iItemSize - 1);
+    link->head = link->tail = NULL;
+    apTimeout->aLevelFlags[level - 1] &= ~(uint64_t(1) << idx);
+    apTimeout->aLevelMin[level - 1][idx] = ULLONG_MAX;
+
+    while( lp )
+    {
+        stTimeoutItem_t *next = lp->pNext;
+        lp->pPrev = lp->pNext = NULL;
+        lp->pLink = NULL;
+        PlaceTimeout( apTimeout,lp );
+        lp = next;
+    }
 }
 
-inline int GetNextTimeoutInASecond( stTimeout_t *apTimeout, unsigned long long allNow)
+// 在第0级位图的[from, to]区间中找第一个置位的槽，没有返回-1
+static inline int FindRootSlot( const uint64_t *flags,int from,int to )
 {
-    // 以8毫秒为粒度来判断（刚好是一字节）
-    if( apTimeout->ullStart == 0 )
+    for( int i = from >> 6; i <= (to >> 6); i++ )
     {
-        apTimeout->ullStart = allNow;
-        apTimeout->llStartIdx = 0;
+        uint64_t flag = flags[i];
+        if( i == (from >> 6) )
+        {
+            flag &= ~uint64_t(0) << (from & 63);
+        }
+        if( i == (to >> 6) && (to & 63) != 63 )
+        {
+            flag &= (uint64_t(1) << ((to & 63) + 1)) - 1;
+        }
+        if( flag )
+        {
+            return (i << 6) + __builtin_ctzll( flag );
+        }
     }
-    
-    if( allNow < apTimeout->ullStart )
+    return -1;
+}
+
+inline void TakeAllTimeout( stCoEpoll_t *ctx,unsigned long long allNow,stTimeoutItemLink_t *apResult )
+{
+    stTimeout_t *apTimeout = ctx->pTimeout;
+
+    while( apTimeout->ullCurr <= allNow )
     {
-        co_log_err("CO_ERR: GetNextTimeout line %d allNow %llu < apTimeout->ullStart %llu\n",
-                   __LINE__,allNow,apTimeout->ullStart);
-        
-        return 1024;
-    }
-    
-    uint64_t startIdx = apTimeout->llStartIdx >> 6;
-    int startFlagIdx = apTimeout->llStartIdx & 63;
-    int shiftRightCnt = startFlagIdx & 0xFFFFFFF8; // 8对齐
-    uint64_t startMask = int64_t(0x8000000000000000) >> (63 - startFlagIdx);
-    uint64_t startFlag = (apTimeout->pFlags[startIdx] & startMask) >> shiftRightCnt;
-    if (startFlag) {
-        // 再按字节判断
-        if (startFlag & int64_t(0x00000000000000FF)) {
-            return 8;
-        } else if (startFlag & int64_t(0x000000000000FF00)) {
-            return 16;
-        } else if (startFlag & int64_t(0x0000000000FF0000)) {
-            return 24;
-        } else if (startFlag & int64_t(0x00000000FF000000)) {
-            return 32;
-        } else if (startFlag & int64_t(0x000000FF00000000)) {
-            return 40;
-        } else if (startFlag & int64_t(0x0000FF0000000000)) {
-            return 48;
-        } else if (startFlag & int64_t(0x00FF000000000000)) {
-            return 56;
-        } else {
-            return 64;
+        int idx0 = apTimeout->ullCurr & (TW_ROOT_SIZE - 1);
+        if( idx0 == 0 )
+        {
+            for( int level = 1; level < TW_LEVEL_NUM; level++ )
+            {
+                int idx = (apTimeout->ullCurr >> TimeoutLevelShift( level )) & (TW_LEVEL_SIZE - 1);
+                if( apTimeout->aLevelFlags[level - 1] & (uint64_t(1) << idx) )
+                {
+                    CascadeTimeout( apTimeout,level,idx );
+                }
+                if( idx )
+                {
+                    break;
+                }
+            }
+        }
+
+        // 跳过本轮中的空槽
+        int last = TW_ROOT_SIZE - 1;
+        if( allNow - apTimeout->ullCurr < (unsigned long long)(last - idx0) )
+        {
+            last = idx0 + (allNow - apTimeout->ullCurr);
+        }
+
+        int idx = FindRootSlot( apTimeout->aRootFlags,idx0,last );
+        if( idx < 0 )
+        {
+            apTimeout->ullCurr += last - idx0 + 1;
+            continue;
+        }
+
+        apTimeout->aRootFlags[idx >> 6] &= ~(uint64_t(1) << (idx & 63));
+        if( apTimeout->aRoot[idx].head )
+        {
+            Join<stTimeoutItem_t,stTimeoutItemLink_t>( apResult,apTimeout->aRoot + idx );
         }
+        apTimeout->ullCurr += idx - idx0 + 1;
     }
-    
-    int ret = 64 - shiftRightCnt;
-    // 注意：这里假定数组表示的时间远大于1秒，endIdx不会追上startIdx
-    long long llendIdx = (apTimeout->llStartIdx + 1000) & (apTimeout->iItemSize - 1);
-    int64_t endIdx = llendIdx >> 6;
-    int moldMask = apTimeout->iFlagSize - 1; // 因为apTimeout->iFlagSize是2的n次方
-    for (int i = (startIdx + 1) & moldMask; i != endIdx; i = (i + 1) & moldMask) {
-        uint64_t flag = apTimeout->pFlags[i];
-        
-        if (flag) {
-            if (flag & int64_t(0x00000000000000FF)) {
-                ret += 8;
-            } else if (flag & int64_t(0x000000000000FF00)) {
-                ret += 16;
-            } else if (flag & int64_t(0x0000000000FF0000)) {
-                ret += 24;
-            } else if (flag & int64_t(0x00000000FF000000)) {
-                ret += 32;
-            } else if (flag & int64_t(0x000000FF00000000)) {
-                ret += 40;
-            } else if (flag & int64_t(0x0000FF0000000000)) {
-                ret += 48;
-            } else if (flag & int64_t(0x00FF000000000000)) {
-                ret += 56;
-            } else {
-                ret += 64;
+}
+
+// 返回距下一个超时的毫秒数，没有超时事件返回-1
+static int GetNextTimeout( stTimeout_t *apTimeout,unsigned long long allNow )
+{
+    unsigned long long next = ULLONG_MAX;
+
+    // 第0级的槽精确到毫秒，按当前位置循环查找第一个非空槽
+    int idx0 = apTimeout->ullCurr & (TW_ROOT_SIZE - 1);
+    for( int n = 0; n < 2 && next == ULLONG_MAX; n++ )
+    {
+        int from = n ? 0 : idx0;
+        int to = n ? idx0 - 1 : TW_ROOT_SIZE - 1;
+        int idx;
+        while( from <= to && (idx = FindRootSlot( apTimeout->aRootFlags,from,to )) >= 0 )
+        {
+            if( apTimeout->aRoot[idx].head )
+            {
+                next = apTimeout->ullCurr + ((idx - idx0) & (TW_ROOT_SIZE - 1));
+                break;
             }
-            return ret;
+            // 槽内的项都已被删除
+            apTimeout->aRootFlags[idx >> 6] &= ~(uint64_t(1) << (idx & 63));
+            from = idx + 1;
         }
-        
-        ret += 64;
     }
-    
-    int endFlagIdx = llendIdx & 63;
-    uint64_t endMask = (uint64_t(0x1) << (endFlagIdx + 1)) - 1; //~(int64_t(0x8000000000000000) >> (63 - endFlagIdx));
-    uint64_t endFlag = apTimeout->pFlags[endIdx] & endMask;
-    if (endFlag) {
-        if (endFlag & int64_t(0x00000000000000FF)) {
-            ret += 8;
-        } else if (endFlag & int64_t(0x000000000000FF00)) {
-            ret += 16;
-        } else if (endFlag & int64_t(0x0000000000FF0000)) {
-            ret += 24;
-        } else if (endFlag & int64_t(0x00000000FF000000)) {
-            ret += 32;
-        } else if (endFlag & int64_t(0x000000FF00000000)) {
-            ret += 40;
-        } else if (endFlag & int64_t(0x0000FF0000000000)) {
-            ret += 48;
-        } else if (endFlag & int64_t(0x00FF000000000000)) {
-            ret += 56;
-        } else {
-            ret += 64;
+
+    // 上级每级只需看当前位置之后的第一个非空槽
+    for( int level = 1; level < TW_LEVEL_NUM; level++ )
+    {
+        uint64_t flags = apTimeout->aLevelFlags[level - 1];
+        int cur = (apTimeout->ullCurr >> TimeoutLevelShift( level )) & (TW_LEVEL_SIZE - 1);
+        while( flags )
+        {
+            // 从cur+1开始循环查找，cur本身排在最后
+            int rot = (cur + 1) & (TW_LEVEL_SIZE - 1);
+            uint64_t rotated = rot ? ((flags >> rot) | (flags << (TW_LEVEL_SIZE - rot))) : flags;
+            int idx = (rot + __builtin_ctzll( rotated )) & (TW_LEVEL_SIZE - 1);
+
+            stTimeoutItemLink_t *link = &apTimeout->aLevel[level - 1][idx];
+            unsigned long long &slotMin = apTimeout->aLevelMin[level - 1][idx];
+            if( link->head && slotMin < apTimeout->ullCurr )
+            {
+                // 下界已失效（最早的项被删除了），重新计算
+                slotMin = ULLONG_MAX;
+                for( stTimeoutItem_t *lp = link->head; lp; lp = lp->pNext )
+                {
+                    unsigned long long expire = lp->ullExpireTime;
+                    if( expire - apTimeout->ullCurr >= TW_MAX_SPAN )
+                    {
+                        expire = apTimeout->ullCurr + TW_MAX_SPAN - 1;
+                    }
+                    if( expire < slotMin )
+                    {
+                        slotMin = expire;
+                    }
+                }
+            }
+
+            if( link->head )
+            {
+                if( slotMin < next )
+                {
+                    next = slotMin;
+                }
+                break;
+            }
+
+            flags &= ~(uint64_t(1) << idx);
+            apTimeout->aLevelFlags[level - 1] = flags;
+            slotMin = ULLONG_MAX;
         }
     }
-    
-    return ret;
+
+    if( next == ULLONG_MAX )
+    {
+        return -1;
+    }
+    if( next <= allNow )
+    {
+        return 0;
+    }
+    if( next - allNow > INT_MAX )
+    {
+        return INT_MAX;
+    }
+    return next - allNow;
 }
 
 static int CoRoutineFunc( stCoRoutine_t *co,void * )
@@ -652,7 +876,17 @@ struct stCoRoutine_t *co_create_env( stCoRoutineEnv_t * env, const stCoRoutineAt
 		at.stack_size += 0x1000;
 	}
 
-	stCoRoutine_t *lp = (stCoRoutine_t*)malloc( sizeof(stCoRoutine_t) );
+	stCoRoutine_t *lp = env->pFreeCo;
+	if( lp && at.share_stack )
+	{
+		env->pFreeCo = lp->pNextFree;
+		env->iFreeCoNum--;
+	}
+	else
+	{
+		lp = (stCoRoutine_t*)malloc( sizeof(stCoRoutine_t) );
+		co_get_stat_ct()->ullCoAllocCnt++;
+	}
 	
 	memset( lp,0,(long)(sizeof(stCoRoutine_t))); 
 
@@ -667,10 +901,15 @@ struct stCoRoutine_t *co_create_env( stCoRoutineEnv_t * env, const stCoRoutineAt
 		stack_mem = co_get_stackmem( at.share_stack);
 		at.stack_size = at.share_stack->stack_size;
 	}
-	else
+	if( !stack_mem && !at.share_stack )
 	{
 		stack_mem = co_alloc_stackmem(at.stack_size);
 	}
+	if( !stack_mem )
+	{
+		free( lp );
+		return NULL;
+	}
 	lp->stack_mem = stack_mem;
 
 	lp->ctx.ss_sp = stack_mem->stack_buffer;
@@ -683,6 +922,7 @@ struct stCoRoutine_t *co_create_env( stCoRoutineEnv_t * env, const stCoRoutineAt
 	lp->cIsShareStack = at.share_stack != NULL;
 
 	lp->save_size = 0;
+	lp->save_capacity = 0;
 	lp->save_buffer = NULL;
 
 	return lp;
@@ -696,6 +936,11 @@ int co_create( stCoRoutine_t **ppco,const stCoRoutineAttr_t *attr,pfn_co_routine
 	}
 	stCoRoutine_t *co = co_create_env( co_get_curr_thread_env(), attr, pfn,arg );
 	*ppco = co;
+	if( !co )
+	{
+		errno = ENOMEM;
+		return -1;
+	}
 
 	return 0;
 }
@@ -704,25 +949,16 @@ void co_free( stCoRoutine_t *co )
 {
     if (!co->cIsShareStack) 
     {
-#ifdef STACK_PROTECT
-    	free(co->stack_mem->origin);
-#else
-        free(co->stack_mem->stack_buffer);
-#endif
-        free(co->stack_mem);
+        co_free_stackmem(co->stack_mem);
     } else {
         // fix by lxk here
-
-        if (co->stack_mem->occupy_co == co) {
-            co->stack_mem->occupy_co = NULL;
-        }
+        co_put_stackmem(co);
         
-        if (co->save_buffer)
-        {
-            free(co->save_buffer), co->save_buffer = NULL;
-        }
+        ReleaseSaveBuffer(co);
     }
 
+    free( co->aSpec );
+
     // 此处引用修复记录描述： std::function<void* (void*)> 捕获的参数可能需要析构。我在捕获的参数里包括了智能指针，没能正确释放，由此发现了此问题。
     co->pfn = NULL; //joezzhu fix the memory leak bug at 2022-03-09
     free( co );
@@ -733,6 +969,30 @@ void co_release( stCoRoutine_t *co )
     co_free( co );
 }
 
+// 只回收共享栈协程（独立栈协程的栈大小不一，直接释放），对象池满或跨线程时也直接释放
+#define CO_POOL_MAX_NUM 10240
+void co_recycle( stCoRoutine_t *co )
+{
+    stCoRoutineEnv_t *env = co_get_curr_thread_env();
+    if (!co->cIsShareStack || co->env != env || env->iFreeCoNum >= CO_POOL_MAX_NUM)
+    {
+        co_free( co );
+        return;
+    }
+
+    co_put_stackmem(co);
+
+    ReleaseSaveBuffer(co);
+
+    free( co->aSpec );
+    co->aSpec = NULL;
+    co->pfn = NULL;
+
+    co->pNextFree = env->pFreeCo;
+    env->pFreeCo = co;
+    env->iFreeCoNum++;
+}
+
 void co_swap(stCoRoutine_t* curr, stCoRoutine_t* pending_co);
 
 void co_resume( stCoRoutine_t *co )
@@ -821,16 +1081,61 @@ void check_stack_size(stCoRoutine_t* co) {
 }
 #endif
 
-//thread_local uint32_t _t_max_malloc_size(0);
-void save_stack_buffer(stCoRoutine_t* occupy_co)
-{
-	assert(occupy_co->cIsMain == 0);
+// 热点协程判定阈值：每秒被换出共享栈的次数，为0时不判定
+static int g_hotSaveNum = 100;
 
-	///copy out
-	int len = occupy_co->stack_mem->stack_bp - occupy_co->stack_sp;
-	//if (len > _t_max_malloc_size) {
-	//	_t_max_malloc_size = len;
-	//}
+void co_set_hot_threshold(int iSaveNumPerSecond)
+{
+	g_hotSaveNum = iSaveNumPerSecond;
+}
+
+bool co_is_hot(stCoRoutine_t *co)
+{
+	return co->cHot != 0;
+}
+
+unsigned long long co_get_save_bytes(stCoRoutine_t *co)
+{
+	return co->ullSaveBytes;
+}
+
+// 频繁被换出的协程标记为热点，所在共享栈不再分配新协程，其他协程结束后该协程就独占此栈（运行中的协程栈上有绝对地址，不能迁移）
+static void UpdateSaveStat(stCoRoutine_t* co, int len)
+{
+	co->ullSaveBytes += len;
+	if (co->cHot || !g_hotSaveNum)
+	{
+		return;
+	}
+
+	unsigned long long now = co->env->pEpoll->lastLoopStartTime;
+	if (now - co->ullSaveStart >= 1000)
+	{
+		co->ullSaveStart = now;
+		co->iSaveCnt = 0;
+	}
+
+	if (++co->iSaveCnt >= (unsigned int)g_hotSaveNum)
+	{
+		co->cHot = 1;
+		if (co->stack_mem->hot_num++ == 0)
+		{
+			co->stack_mem->owner->hot_count++;
+		}
+		co_get_stat_ct()->ullHotPromoteCnt++;
+	}
+}
+
+//thread_local uint32_t _t_max_malloc_size(0);
+void save_stack_buffer(stCoRoutine_t* occupy_co)
+{
+	assert(occupy_co->cIsMain == 0);
+
+	///copy out
+	int len = occupy_co->stack_mem->stack_bp - occupy_co->stack_sp;
+	//if (len > _t_max_malloc_size) {
+	//	_t_max_malloc_size = len;
+	//}
 
 #if CHECK_MAX_STACK > 0
 	if (len > CHECK_MAX_STACK) {
@@ -838,14 +1143,14 @@ void save_stack_buffer(stCoRoutine_t* occupy_co)
 	}
 #endif
 
-	if (occupy_co->save_buffer)
+	if (!occupy_co->save_buffer || (unsigned int)len > occupy_co->save_capacity)
 	{
-		//free(occupy_co->save_buffer), occupy_co->save_buffer = NULL;
-		free(occupy_co->save_buffer);
+		ReleaseSaveBuffer(occupy_co);
+		occupy_co->save_buffer = AllocSaveBuffer(len, &occupy_co->save_capacity);
 	}
-
-	occupy_co->save_buffer = (char*)malloc(len); //malloc buf;
 	occupy_co->save_size = len;
+	co_get_stat_ct()->ullStackCopyBytes += len;
+	UpdateSaveStat(occupy_co, len);
 
 	//co_log_err("CO_DEBUG: ============= save stack buffer:%llu sp:%llu size%lu cur_co:%llu\n", occupy_co->save_buffer, occupy_co->stack_sp, len, occupy_co);
 
@@ -899,10 +1204,7 @@ void co_swap(stCoRoutine_t* curr, stCoRoutine_t* pending_co)
 			// change by lxk, 对已结束的协程就不进行栈拷贝了
 			if (occupy_co->cEnd) { // 协程已结束，清理缓存栈数据
 				// 清理协程缓存栈
-				if (occupy_co->save_buffer)
-				{
-					free(occupy_co->save_buffer), occupy_co->save_buffer = NULL;
-				}
+				ReleaseSaveBuffer(occupy_co);
 			} else {
 				save_stack_buffer(occupy_co);
 			}
@@ -934,6 +1236,7 @@ void co_swap(stCoRoutine_t* curr, stCoRoutine_t* pending_co)
 
 			// 注意：执行这句memcpy后，函数中所有变量都可能被覆盖掉了，因为编译优化函数内变量在栈上的位置顺序是不定的，即stack_sp的位置不一定在所有函数变量的前面
 			memcpy(update_pending_co->stack_sp, update_pending_co->save_buffer, update_pending_co->save_size); 
+			co_get_stat_ct()->ullStackCopyBytes += co_get_curr_thread_env()->pending_co->save_size;
 
 #ifdef CHECK_MAX_STACK > 0
 			// 下面两个问题的原因可能是因为编译器的编译优化调整了函数内变量在栈上的布局顺序导致的（注意：其实是因为当前函数的栈帧没有保存导致的，只要连当前栈帧也保存就没有问题了）
@@ -1009,6 +1312,9 @@ static short EpollEvent2Poll( uint32_t events )
 	if( events & EPOLLERR ) e |= POLLERR;
 	if( events & EPOLLRDNORM ) e |= POLLRDNORM;
 	if( events & EPOLLWRNORM ) e |= POLLWRNORM;
+#ifdef POLLRDHUP
+	if( events & EPOLLRDHUP ) e |= POLLRDHUP; // 持久化注册的fd回调需要知道对端已关闭写
+#endif
 	return e;
 }
 
@@ -1020,6 +1326,11 @@ void co_init_curr_thread_env()
 
 	g_coRoutineEnv->iCallStackSize = 0;
 	struct stCoRoutine_t *self = co_create_env( g_coRoutineEnv, NULL, NULL,NULL );
+	if( !self )
+	{
+		co_log_err("CO_ERR: co_init_curr_thread_env alloc main coroutine stack failed\n");
+		abort();
+	}
 	self->cIsMain = 1;
 	
 	g_coRoutineEnv->pending_co = NULL;
@@ -1065,6 +1376,432 @@ void OnPollPreparePfn( stTimeoutItem_t * ap,struct epoll_event &e,stTimeoutItemL
 }
 
 // change by lxk here
+// 持久化fd事件：fd只在线程的epoll中以边缘触发方式注册一次，直到关闭时才注销，
+// 读写等待直接挂在事件上的等待槽中，避免每次等待都要EPOLL_CTL_ADD/DEL以及分配stPoll_t
+struct stCoFdEvent_t;
+struct stCoFdWait_t : public stTimeoutItem_t
+{
+	stCoFdEvent_t *pEvent;
+	uint32_t iWaitEvents;
+	uint32_t iRevents;
+};
+
+struct stCoFdEvent_t : public stTimeoutItem_t
+{
+	int fd;
+	stCoEpoll_t *ctx;
+	volatile char cClosed;
+
+	stCoFdWait_t stRead;
+	stCoFdWait_t stWrite;
+
+	// 回调模式：对应方向没有协程等待时，事件发生后由事件循环直接调用回调（stCallback.iRevents累积本轮事件）
+	stCoFdWait_t stCallback;
+	pfn_co_fd_callback_t pfnCallback[2]; // 0为读，1为写
+	void *pCallbackArg[2];
+
+	stCoFdEvent_t *pOrphanNext;
+};
+
+static void OnFdEventPrepare( stTimeoutItem_t * ap,struct epoll_event &e,stTimeoutItemLink_t *active )
+{
+	stCoFdEvent_t *lp = (stCoFdEvent_t *)ap;
+	uint32_t events = e.events;
+	if( events & ( EPOLLERR | EPOLLHUP ) ) events |= EPOLLIN | EPOLLOUT;
+	if( events & EPOLLRDHUP ) events |= EPOLLIN;
+
+	stCoFdWait_t *waits[2] = { &lp->stRead,&lp->stWrite };
+	for(int i=0;i<2;i++)
+	{
+		stCoFdWait_t *w = waits[i];
+		if( w->pArg && ( events & w->iWaitEvents ) && w->pLink != active )
+		{
+			w->iRevents = events;
+			RemoveFromLink<stTimeoutItem_t,stTimeoutItemLink_t>( w );
+			AddTail( active,w );
+		}
+	}
+
+	if( ( lp->pfnCallback[0] && ( events & EPOLLIN ) && !lp->stRead.pArg ) ||
+		( lp->pfnCallback[1] && ( events & EPOLLOUT ) && !lp->stWrite.pArg ) )
+	{
+		stCoFdWait_t *w = &lp->stCallback;
+		w->iRevents |= events;
+		if( w->pLink != active )
+		{
+			RemoveFromLink<stTimeoutItem_t,stTimeoutItemLink_t>( w );
+			AddTail( active,w );
+		}
+	}
+}
+
+static void OnFdCallbackProcess( stTimeoutItem_t * ap )
+{
+	stCoFdWait_t *w = (stCoFdWait_t*)ap;
+	stCoFdEvent_t *lp = w->pEvent;
+	uint32_t events = w->iRevents;
+	w->iRevents = 0;
+
+	// 回调中可能修改或取消回调，也可能关闭fd（事件内存由本线程下一轮循环回收，这里仍可访问）
+	if( ( events & EPOLLIN ) && lp->pfnCallback[0] && !lp->stRead.pArg && !lp->cClosed )
+	{
+		lp->pfnCallback[0]( lp->fd,EpollEvent2Poll( events ),lp->pCallbackArg[0] );
+	}
+	if( ( events & EPOLLOUT ) && lp->pfnCallback[1] && !lp->stWrite.pArg && !lp->cClosed )
+	{
+		lp->pfnCallback[1]( lp->fd,EpollEvent2Poll( events ),lp->pCallbackArg[1] );
+	}
+}
+
+static void PushOrphanFdEvent( stCoEpoll_t *ctx,stCoFdEvent_t *ev )
+{
+	do
+	{
+		ev->pOrphanNext = ctx->pOrphanFdEvents;
+	} while( !__sync_bool_compare_and_swap( &ctx->pOrphanFdEvents,ev->pOrphanNext,ev ) );
+}
+
+// 回收已注销的fd事件，仍有协程在等待的先唤醒，下一轮循环再释放
+static void ReclaimFdEvents( stCoEpoll_t *ctx,stTimeoutItemLink_t *active )
+{
+	if( !ctx->pOrphanFdEvents ) return;
+
+	stCoFdEvent_t *lp = __sync_lock_test_and_set( &ctx->pOrphanFdEvents,(stCoFdEvent_t*)NULL );
+	while( lp )
+	{
+		stCoFdEvent_t *next = lp->pOrphanNext;
+
+		bool busy = false;
+		stCoFdWait_t *waits[2] = { &lp->stRead,&lp->stWrite };
+		for(int i=0;i<2;i++)
+		{
+			stCoFdWait_t *w = waits[i];
+			if( w->pArg )
+			{
+				busy = true;
+				if( w->pLink != active )
+				{
+					w->iRevents = EPOLLERR;
+					RemoveFromLink<stTimeoutItem_t,stTimeoutItemLink_t>( w );
+					AddTail( active,w );
+				}
+			}
+		}
+
+		// 已注销的fd不再调用回调
+		RemoveFromLink<stTimeoutItem_t,stTimeoutItemLink_t>( &lp->stCallback );
+
+		if( busy )
+		{
+			PushOrphanFdEvent( ctx,lp );
+		}
+		else
+		{
+			free( lp );
+		}
+		lp = next;
+	}
+}
+
+stCoFdEvent_t *co_fd_event_alloc( stCoEpoll_t *ctx,int fd )
+{
+#if defined( __APPLE__ ) || defined( __FreeBSD__ )
+	return NULL;
+#else
+	stCoFdEvent_t *lp = (stCoFdEvent_t*)calloc( 1,sizeof(stCoFdEvent_t) );
+	lp->fd = fd;
+	lp->ctx = ctx;
+	lp->pfnPrepare = OnFdEventPrepare;
+
+	stCoFdWait_t *waits[2] = { &lp->stRead,&lp->stWrite };
+	for(int i=0;i<2;i++)
+	{
+		waits[i]->pEvent = lp;
+		waits[i]->pfnProcess = OnPollProcessEvent;
+	}
+	lp->stCallback.pEvent = lp;
+	lp->stCallback.pfnProcess = OnFdCallbackProcess;
+
+	struct epoll_event ev;
+	memset( &ev,0,sizeof(ev) );
+	ev.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+	ev.data.ptr = lp;
+	if( co_epoll_ctl( ctx->iEpollFd,EPOLL_CTL_ADD,fd,&ev ) < 0 )
+	{
+		free( lp );
+		return NULL;
+	}
+	return lp;
+#endif
+}
+
+// 可在任意线程调用（关闭fd时），epoll注销后交由所属线程回收内存；
+// 所属线程的事件循环在下一轮等待前回收，其他线程调用时通过eventfd唤醒可能阻塞在epoll_wait中的所属线程
+void co_fd_event_release( stCoFdEvent_t *ev )
+{
+	if( !ev ) return;
+
+	stCoEpoll_t *ctx = ev->ctx;
+	ev->cClosed = 1;
+	struct epoll_event e;
+	memset( &e,0,sizeof(e) );
+	co_epoll_ctl( ctx->iEpollFd,EPOLL_CTL_DEL,ev->fd,&e );
+
+	PushOrphanFdEvent( ctx,ev );
+
+	stCoRoutineEnv_t *env = co_get_curr_thread_env();
+	if( ( !env || env->pEpoll != ctx ) && ctx->iNotifyFd >= 0 &&
+		__sync_bool_compare_and_swap( &ctx->iNotifyPending,0,1 ) )
+	{
+		eventfd_write( ctx->iNotifyFd,1 );
+	}
+}
+
+stCoEpoll_t *co_fd_event_ctx( stCoFdEvent_t *ev )
+{
+	return ev->ctx;
+}
+
+// 只能在事件所属线程调用
+void co_fd_event_set_callback( stCoFdEvent_t *ev,short events,pfn_co_fd_callback_t pfn,void *arg )
+{
+	for(int i=0;i<2;i++)
+	{
+		if( events & ( i ? POLLOUT : POLLIN ) )
+		{
+			ev->pfnCallback[i] = pfn;
+			ev->pCallbackArg[i] = arg;
+		}
+	}
+
+	if( !ev->pfnCallback[0] && !ev->pfnCallback[1] )
+	{
+		RemoveFromLink<stTimeoutItem_t,stTimeoutItemLink_t>( &ev->stCallback );
+		ev->stCallback.iRevents = 0;
+	}
+}
+
+int co_fd_event_wait( stCoFdEvent_t *ev,short events,short *revents,int timeout )
+{
+	if( revents ) *revents = 0;
+	if( timeout == 0 ) return 0;
+	if( ev->cClosed )
+	{
+		errno = EBADF;
+		return -1;
+	}
+
+	// 同一线程中同一fd同一方向只支持一个等待者（与原EPOLL_CTL_ADD方式的限制相同）
+	stCoFdWait_t *w = ( events & POLLIN ) ? &ev->stRead : &ev->stWrite;
+	if( w->pArg )
+	{
+		errno = EEXIST;
+		return -1;
+	}
+
+	w->iWaitEvents = PollEvent2Epoll( events ) | EPOLLERR | EPOLLHUP;
+	w->iRevents = 0;
+	w->bTimeout = false;
+	w->pArg = GetCurrThreadCo();
+
+	if( timeout > 0 )
+	{
+		unsigned long long now = GetTickMS();
+		w->ullExpireTime = now + timeout;
+		int ret = AddTimeout( ev->ctx->pTimeout,w,now );
+		if( ret != 0 )
+		{
+			co_log_err("CO_ERR: AddTimeout ret %d now %lld timeout %d ullExpireTime %lld\n",
+					   ret,now,timeout,w->ullExpireTime);
+			w->pArg = NULL;
+			errno = EINVAL;
+			return -1;
+		}
+	}
+	else
+	{
+		AddTail( ev->ctx->pstNoTimeoutList,w );
+	}
+
+	co_yield_env( co_get_curr_thread_env() );
+
+	RemoveFromLink<stTimeoutItem_t,stTimeoutItemLink_t>( w );
+	w->pArg = NULL;
+
+	if( w->bTimeout ) return 0;
+
+	if( revents ) *revents = EpollEvent2Poll( w->iRevents ) & ( events | POLLERR | POLLHUP );
+	return 1;
+}
+
+// io_uring后端：hook的io以sqe提交，完成后由cqe唤醒协程；sqe在每轮事件循环开始时统一提交，
+// ring fd注册在epoll中，因此与poll/cond/timeout等基于epoll的功能可以共存
+static bool g_uring_enabled = false;
+
+struct stCoUringOp_t : public stTimeoutItem_t
+{
+	int iRes;
+	char cDone;
+	char cCanceled;
+	stCoUringOp_t *pNextFree;
+};
+
+static void OnUringCqe( uint64_t user_data,int res,void *arg )
+{
+	if( !user_data ) return; // cancel请求的结果
+
+	stCoUringOp_t *op = (stCoUringOp_t*)user_data;
+	op->iRes = res;
+	op->cDone = 1;
+	RemoveFromLink<stTimeoutItem_t,stTimeoutItemLink_t>( op );
+	AddTail( (stTimeoutItemLink_t*)arg,op );
+}
+
+static void OnUringPrepare( stTimeoutItem_t * ap,struct epoll_event &e,stTimeoutItemLink_t *active )
+{
+	stCoEpoll_t *ctx = (stCoEpoll_t*)ap->pArg;
+	co_uring_reap( ctx->pUring,OnUringCqe,active );
+}
+
+static void OnUringOpProcess( stTimeoutItem_t * ap )
+{
+	stCoUringOp_t *op = (stCoUringOp_t*)ap;
+	if( op->cDone )
+	{
+		co_resume( (stCoRoutine_t*)op->pArg );
+		return;
+	}
+
+	// 超时：取消请求，内核返回cqe后才能唤醒协程（缓冲区在此之前仍可能被内核访问）
+	if( !op->cCanceled )
+	{
+		stCoEpoll_t *ctx = co_get_epoll_ct();
+		struct io_uring_sqe *sqe = co_uring_get_sqe( ctx->pUring ); // 提交队列满时会先提交已有请求再取
+		if( sqe )
+		{
+			op->cCanceled = 1;
+			sqe->opcode = IORING_OP_ASYNC_CANCEL;
+			sqe->fd = -1;
+			sqe->addr = (uint64_t)(uintptr_t)op;
+		}
+		else
+		{
+			// 提交后仍取不到sqe（内核未及时消费）时1毫秒后重试取消，避免请求永远不被取消
+			unsigned long long now = GetTickMS();
+			op->ullExpireTime = now + 1;
+			AddTimeout( ctx->pTimeout,op,now );
+		}
+	}
+}
+
+bool co_enable_uring( bool enable )
+{
+	if( enable )
+	{
+		stCoUring_t *ring = co_uring_alloc( 8 );
+		if( !ring )
+		{
+			return false;
+		}
+		co_uring_free( ring );
+	}
+	g_uring_enabled = enable;
+	return true;
+}
+
+bool co_is_uring_enabled()
+{
+	return g_uring_enabled;
+}
+
+stCoUring_t *co_get_uring_ct()
+{
+	if( !g_uring_enabled ) return NULL;
+
+	stCoEpoll_t *ctx = co_get_epoll_ct();
+	if( ctx->pUring || ctx->cUringFailed ) return ctx->pUring;
+
+	stCoUring_t *ring = co_uring_alloc( 1024 );
+	if( !ring )
+	{
+		ctx->cUringFailed = 1;
+		return NULL;
+	}
+
+	stTimeoutItem_t *item = (stTimeoutItem_t*)calloc( 1,sizeof(stTimeoutItem_t) );
+	item->pfnPrepare = OnUringPrepare;
+	item->pArg = ctx;
+
+	struct epoll_event ev;
+	memset( &ev,0,sizeof(ev) );
+	ev.events = EPOLLIN;
+	ev.data.ptr = item;
+	if( co_epoll_ctl( ctx->iEpollFd,EPOLL_CTL_ADD,co_uring_fd( ring ),&ev ) < 0 )
+	{
+		free( item );
+		co_uring_free( ring );
+		ctx->cUringFailed = 1;
+		return NULL;
+	}
+
+	ctx->pUringItem = item;
+	ctx->pUring = ring;
+	return ring;
+}
+
+bool co_is_share_stack_buffer( const void *buf,size_t len )
+{
+	stCoRoutine_t *co = GetCurrThreadCo();
+	if( !co || !co->cIsShareStack ) return false;
+
+	const char *p = (const char*)buf;
+	return p + len > co->stack_mem->stack_buffer && p < co->stack_mem->stack_bp;
+}
+
+int co_uring_wait( stCoUring_t *ring,struct io_uring_sqe *sqe,int timeout )
+{
+	stCoEpoll_t *ctx = co_get_epoll_ct();
+
+	stCoUringOp_t *op = ctx->pFreeUringOps;
+	if( op )
+	{
+		ctx->pFreeUringOps = op->pNextFree;
+		memset( op,0,sizeof(stCoUringOp_t) );
+	}
+	else
+	{
+		op = (stCoUringOp_t*)calloc( 1,sizeof(stCoUringOp_t) );
+	}
+
+	op->pfnProcess = OnUringOpProcess;
+	op->pArg = GetCurrThreadCo();
+	sqe->user_data = (uint64_t)(uintptr_t)op;
+	co_get_stat_ct()->ullUringSqeCnt++;
+
+	if( timeout > 0 )
+	{
+		unsigned long long now = GetTickMS();
+		op->ullExpireTime = now + timeout;
+		if( AddTimeout( ctx->pTimeout,op,now ) != 0 )
+		{
+			co_log_err("CO_ERR: co_uring_wait AddTimeout failed now %lld timeout %d\n",now,timeout);
+		}
+	}
+
+	co_yield_env( co_get_curr_thread_env() );
+
+	RemoveFromLink<stTimeoutItem_t,stTimeoutItemLink_t>( op );
+	int res = op->iRes;
+	if( op->cCanceled && res == -ECANCELED )
+	{
+		res = -EAGAIN; // 与epoll方式超时的表现一致
+	}
+
+	op->pNextFree = ctx->pFreeUringOps;
+	ctx->pFreeUringOps = op;
+	return res;
+}
+
 void co_eventloop( stCoEpoll_t *ctx, pfn_co_eventloop_t pfn, void *arg )
 {
 	if( !ctx->result )
@@ -1075,10 +1812,29 @@ void co_eventloop( stCoEpoll_t *ctx, pfn_co_eventloop_t pfn, void *arg )
 
 	for(;;)
 	{
-        // 由于co_epoll_wait的系统消耗比较大，应尽量减少调用频率，可以根据下一超时时间点来设置waittime
-        // 但由于超时链数据结构限制，需要遍历数组来找到下一超时事件，最坏情况下（链空的时候）需要遍历整个数组（60*1000个）元素
-        // 方案：只查最近的1秒内的超时事件，增加超时位图数据结构来提高查找效率，而且以8毫秒为粒度（刚好是位图中的一字节数据）
-        int waittime = GetNextTimeoutInASecond(ctx->pTimeout, GetTickMS());
+        // 由于co_epoll_wait的系统消耗比较大，应尽量减少调用频率，根据时间轮中精确的下一超时时间点来设置waittime
+        // 没有超时事件时一直阻塞到有io事件为止；设置了pfn时为了让pfn能被定期调用，最多阻塞1秒
+        int waittime = GetNextTimeout( ctx->pTimeout,GetTickMS() );
+        if( pfn && ( waittime < 0 || waittime > 1000 ) )
+        {
+            waittime = 1000;
+        }
+
+        // 有待回收的fd事件时不阻塞（可能有协程在等待已关闭的fd，需尽快唤醒）
+        if( ctx->pOrphanFdEvents )
+        {
+            waittime = 0;
+        }
+
+        // 统一提交本轮产生的io_uring请求（一次系统调用），已有完成结果时不阻塞
+        if( ctx->pUring )
+        {
+            co_uring_submit( ctx->pUring );
+            if( co_uring_cq_ready( ctx->pUring ) )
+            {
+                waittime = 0;
+            }
+        }
         
 		int ret = co_epoll_wait( ctx->iEpollFd,result,stCoEpoll_t::_EPOLL_SIZE, waittime );
         
@@ -1117,6 +1873,8 @@ void co_eventloop( stCoEpoll_t *ctx, pfn_co_eventloop_t pfn, void *arg )
             Join<stTimeoutItem_t,stTimeoutItemLink_t>( active,timeout );
         }
 
+		ReclaimFdEvents( ctx,active );
+
 		lp = active->head;
 		while( lp )
 		{
@@ -1155,17 +1913,53 @@ void OnCoroutineEvent( stTimeoutItem_t * ap )
 	co_resume( co );
 }
 
+// 唤醒事件只用于让事件循环进入下一轮（下一轮中回收fd事件），清空计数后不加入活动列表
+static void OnNotifyPrepare( stTimeoutItem_t *ap,struct epoll_event &e,stTimeoutItemLink_t *active )
+{
+	stCoEpoll_t *ctx = (stCoEpoll_t*)ap->pArg;
+	__sync_lock_release( &ctx->iNotifyPending );
+
+	eventfd_t value;
+	eventfd_read( ctx->iNotifyFd,&value );
+}
+
 stCoEpoll_t *AllocEpoll()
 {
 	stCoEpoll_t *ctx = (stCoEpoll_t*)calloc( 1,sizeof(stCoEpoll_t) );
 
 	ctx->iEpollFd = co_epoll_create( stCoEpoll_t::_EPOLL_SIZE );
-	ctx->pTimeout = AllocTimeout( 0x10000 ); // 方便用位操作代替乘除法和去模操作
+	ctx->pTimeout = AllocTimeout();
 	
 	ctx->pstActiveList = (stTimeoutItemLink_t*)calloc( 1,sizeof(stTimeoutItemLink_t) );
 	ctx->pstTimeoutList = (stTimeoutItemLink_t*)calloc( 1,sizeof(stTimeoutItemLink_t) );
     ctx->pstNoTimeoutList = (stTimeoutItemLink_t*)calloc( 1,sizeof(stTimeoutItemLink_t) );
 
+	ctx->iNotifyFd = -1;
+#if !defined( __APPLE__ ) && !defined( __FreeBSD__ )
+	ctx->iNotifyFd = eventfd( 0,EFD_NONBLOCK | EFD_CLOEXEC );
+	if( ctx->iNotifyFd >= 0 )
+	{
+		stTimeoutItem_t *item = (stTimeoutItem_t*)calloc( 1,sizeof(stTimeoutItem_t) );
+		item->pfnPrepare = OnNotifyPrepare;
+		item->pArg = ctx;
+
+		struct epoll_event ev;
+		memset( &ev,0,sizeof(ev) );
+		ev.events = EPOLLIN;
+		ev.data.ptr = item;
+		if( co_epoll_ctl( ctx->iEpollFd,EPOLL_CTL_ADD,ctx->iNotifyFd,&ev ) < 0 )
+		{
+			free( item );
+			close( ctx->iNotifyFd );
+			ctx->iNotifyFd = -1;
+		}
+		else
+		{
+			ctx->pNotifyItem = item;
+		}
+	}
+#endif
+
 	return ctx;
 }
 
@@ -1177,6 +1971,19 @@ void FreeEpoll( stCoEpoll_t *ctx )
 		free( ctx->pstTimeoutList );
         free( ctx->pstNoTimeoutList );
 		FreeTimeout( ctx->pTimeout );
+		co_uring_free( ctx->pUring );
+		free( ctx->pUringItem );
+		if( ctx->iNotifyFd >= 0 )
+		{
+			close( ctx->iNotifyFd );
+		}
+		free( ctx->pNotifyItem );
+		while( ctx->pFreeUringOps )
+		{
+			stCoUringOp_t *op = ctx->pFreeUringOps;
+			ctx->pFreeUringOps = op->pNextFree;
+			free( op );
+		}
 		co_epoll_res_free( ctx->result );
 	}
 	free( ctx );
@@ -1326,6 +2133,69 @@ void SetEpoll( stCoRoutineEnv_t *env,stCoEpoll_t *ev )
 	env->pEpoll = ev;
 }
 
+static __thread stCoStat_t g_coStat;
+stCoStat_t *co_get_stat_ct()
+{
+	return &g_coStat;
+}
+
+unsigned long long co_get_tick_ms()
+{
+	return GetTickMS();
+}
+
+// 超时项内嵌在协程对象中（共享栈协程挂起时栈内容会被换出，不能放在栈上），直接加入时间轮
+int co_sleep_until( unsigned long long ullExpireTime )
+{
+	if( !co_is_enable_sys_hook() )
+	{
+		unsigned long long now = GetTickMS();
+		if( ullExpireTime > now )
+		{
+			poll( NULL,0,(int)( ullExpireTime - now ) );
+		}
+		return 0;
+	}
+
+	stCoEpoll_t *ctx = co_get_epoll_ct();
+	stCoRoutine_t *self = GetCurrThreadCo();
+	stTimeoutItem_t *item = &self->stSleepItem;
+	memset( item,0,sizeof(stTimeoutItem_t) );
+	item->pfnProcess = OnCoroutineEvent;
+	item->pArg = self;
+	item->ullExpireTime = ullExpireTime;
+
+	unsigned long long now = GetTickMS();
+	if( ullExpireTime <= now )
+	{
+		return 0;
+	}
+
+	int ret = AddTimeout( ctx->pTimeout,item,now );
+	if( ret != 0 )
+	{
+		co_log_err("CO_ERR: co_sleep_until AddTimeout ret %d now %lld expire %lld\n",
+				ret,now,ullExpireTime);
+		errno = EINVAL;
+		return -__LINE__;
+	}
+
+	co_yield_env( co_get_curr_thread_env() );
+
+	// 被其他方式唤醒时从时间轮中移除
+	RemoveFromLink<stTimeoutItem_t,stTimeoutItemLink_t>( item );
+	return 0;
+}
+
+int co_sleep_ms( int ms )
+{
+	if( ms <= 0 )
+	{
+		return 0;
+	}
+	return co_sleep_until( GetTickMS() + ms );
+}
+
 stCoEpoll_t *co_get_epoll_ct()
 {
 	if( !co_get_curr_thread_env() )
@@ -1353,6 +2223,10 @@ void *co_getspecific(pthread_key_t key)
 	{
 		return pthread_getspecific( key );
 	}
+	if( !co->aSpec || key >= CO_SPEC_SIZE )
+	{
+		return NULL;
+	}
 	return co->aSpec[ key ].value;
 }
 
@@ -1363,6 +2237,14 @@ int co_setspecific(pthread_key_t key, const void *value)
 	{
 		return pthread_setspecific( key,value );
 	}
+	if( key >= CO_SPEC_SIZE )
+	{
+		return -1;
+	}
+	if( !co->aSpec )
+	{
+		co->aSpec = (stCoSpec_t*)calloc( CO_SPEC_SIZE,sizeof(stCoSpec_t) );
+	}
 	co->aSpec[ key ].value = (void*)value;
 	return 0;
 }
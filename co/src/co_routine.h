@@ -22,6 +22,7 @@
 #include <stdint.h>
 #include <sys/poll.h>
 #include <sys/types.h>
+#include <sys/uio.h>
 #include <pthread.h>
 #include <netinet/in.h>
 
@@ -47,11 +48,13 @@ typedef void *(*pfn_co_routine_t)( void * );
 
 //2.co_routine
 
+// 栈内存分配失败时返回-1（errno为ENOMEM），*co为NULL
 int 	co_create( stCoRoutine_t **co,const stCoRoutineAttr_t *attr,void *(*routine)(void*),void *arg );
 void    co_resume( stCoRoutine_t *co );
 void    co_yield( stCoRoutine_t *co );
 void    co_yield_ct(); //ct = current thread
 void    co_release( stCoRoutine_t *co );
+void    co_recycle( stCoRoutine_t *co ); // 回收已结束的协程对象到线程内对象池，由co_create复用
 // add by lxk
 void    co_activate( stCoRoutine_t *co );
 
@@ -71,7 +74,7 @@ void *	co_getspecific( pthread_key_t key );
 
 stCoEpoll_t * 	co_get_epoll_ct(); //ct = current thread
 
-//5.hook syscall ( poll/read/write/recv/send/recvfrom/sendto )
+//5.hook syscall ( poll/read/write/recv/send/recvfrom/sendto/readv/writev/recvmsg/sendmsg/recvmmsg/sendmmsg/accept4 )
 
 void 	co_enable_hook_sys();  
 void 	co_disable_hook_sys();  
@@ -88,7 +91,14 @@ int co_cond_broadcast( stCoCond_t * );
 int co_cond_timedwait( stCoCond_t *,int timeout_ms );
 
 //7.share stack
+// iCount为共享栈数量上限，共享栈在有协程使用时才按需创建（mmap MAP_NORESERVE，带保护页）
 stShareStack_t* co_alloc_sharestack(int iCount, int iStackSize);
+int co_get_sharestack_count(stShareStack_t* share_stack); // 已创建的共享栈数
+size_t co_get_sharestack_resident_size(stShareStack_t* share_stack); // 共享栈实际占用的物理内存字节数
+// 每秒被换出共享栈达到iSaveNumPerSecond次的协程标记为热点，其所在共享栈不再分配新协程（默认100，为0时关闭）
+void co_set_hot_threshold(int iSaveNumPerSecond);
+bool co_is_hot(stCoRoutine_t *co);
+unsigned long long co_get_save_bytes(stCoRoutine_t *co); // 协程累计换出共享栈的字节数
 
 //8.init envlist for hook get/set env
 void co_set_env_list( const char *name[],size_t cnt);
@@ -100,11 +110,54 @@ int co_accept(int fd, struct sockaddr *addr, socklen_t *len );
 int co_register_fd(int fd);
 int co_set_timeout(int fd, int read_timeout_ms, int write_timeout_ms);
 int co_set_nonblock(int fd);
+// 以下接口用于线程共享的读写缓冲区：co_wait_readable按fd的读超时等待可读（不读数据），返回值同poll；
+// co_read_nowait/co_write_nowait/co_writev_nowait直接进行系统调用（hook注册的fd为非阻塞），不挂起协程也不走io_uring
+int co_wait_readable( int fd );
+ssize_t co_read_nowait( int fd,void *buf,size_t nbyte );
+ssize_t co_write_nowait( int fd,const void *buf,size_t nbyte );
+ssize_t co_writev_nowait( int fd,const struct iovec *iov,int iovcnt );
 
 bool co_is_runtime_busy(); // 当运行时当前循环周期超过100毫秒时返回true
 
+// 协程睡眠：超时项内嵌在协程对象中直接加入时间轮，不分配内存（未开启hook时退化为系统调用）
+int co_sleep_ms( int ms );
+int co_sleep_until( unsigned long long ullExpireTime ); // ullExpireTime为co_get_tick_ms()时间
+unsigned long long co_get_tick_ms();
+
 pid_t GetPid();
 
+// 持久化poll模式：开启后注册的fd以边缘触发方式在线程epoll中只注册一次，直到close时注销，
+// 读写阻塞时不再每次EPOLL_CTL_ADD/DEL，适合长连接高频收发的场景（默认关闭）
+void co_set_persist_poll(bool enable);
+bool co_is_persist_poll();
+
+// 回调模式（reactor）：在当前线程epoll中fd的持久化事件上设置可读（POLLIN）或可写（POLLOUT）回调，
+// 事件发生且该方向没有协程在等待时由事件循环直接调用（边缘触发，回调中需读写到EAGAIN），不需要为fd创建协程；
+// pfn为NULL时取消回调，fd关闭时自动注销。设置后该fd改用持久化注册。只能在所属线程调用，不支持时返回-1
+typedef void (*pfn_co_fd_callback_t)( int fd,short revents,void *arg );
+int co_set_fd_callback( int fd,short events,pfn_co_fd_callback_t pfn,void *arg );
+
+//10.per thread statistics
+struct stCoStat_t
+{
+	unsigned long long ullIoSysCallCnt;  // hook函数中实际发起的读写系统调用次数
+	unsigned long long ullEpollCtlCnt;
+	unsigned long long ullEpollWaitCnt;
+	unsigned long long ullUringSqeCnt;    // 提交的io_uring请求数（io_uring_enter计入ullIoSysCallCnt）
+	unsigned long long ullStackCopyBytes; // 共享栈切换时拷出和拷回的字节数
+	unsigned long long ullSaveBufferAllocCnt; // 共享栈保存缓冲区实际malloc的次数（复用的不计）
+	unsigned long long ullCoAllocCnt;     // 协程对象实际malloc的次数（从对象池复用的不计）
+	unsigned long long ullHotPromoteCnt;  // 被标记为热点（独占所在共享栈）的协程数
+	unsigned long long ullPrivateStackCnt; // 因热点而使用独立栈的协程数（由上层分配独立栈时计数）
+};
+stCoStat_t *co_get_stat_ct(); //ct = current thread
+
+//11.io_uring backend
+// 开启后hook的read/write/recv/send及co_accept以io_uring请求提交，完成时唤醒协程，每轮事件循环统一提交一次；
+// 内核不支持io_uring时返回false，继续使用epoll方式（需在创建各线程前调用）
+bool co_enable_uring(bool enable);
+bool co_is_uring_enabled();
+
 // 加入start_hook方法是为了在使用LD_PRELOAD=libco时getenv被提前调用导致调用到getpid出错，因此加入开关，等进程初始化完成进入代码逻辑时才打开开关
 void co_start_hook();
 
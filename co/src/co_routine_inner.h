@@ -26,27 +26,61 @@
 #define CHECK_MAX_STACK 10000
 
 struct stCoRoutineEnv_t;
+struct stTimeoutItemLink_t;
+struct stTimeoutItem_t;
+struct epoll_event;
+
+typedef void (*OnPreparePfn_t)( stTimeoutItem_t *,struct epoll_event &ev, stTimeoutItemLink_t *active );
+typedef void (*OnProcessPfn_t)( stTimeoutItem_t *);
+
+struct stTimeoutItem_t
+{
+	stTimeoutItem_t *pPrev;
+	stTimeoutItem_t *pNext;
+	stTimeoutItemLink_t *pLink;
+
+	unsigned long long ullExpireTime;
+
+	OnPreparePfn_t pfnPrepare;
+	OnProcessPfn_t pfnProcess;
+
+	void *pArg; // routine 
+	bool bTimeout;
+};
+
+struct stTimeoutItemLink_t
+{
+	stTimeoutItem_t *head;
+	stTimeoutItem_t *tail;
+};
+
 struct stCoSpec_t
 {
 	void *value;
 };
 
+struct stShareStack_t;
 struct stStackMem_t
 {
 	stCoRoutine_t* occupy_co;
 	int stack_size;
 	char* stack_bp; //stack_buffer + stack_size
 	char* stack_buffer;
-#ifdef STACK_PROTECT
-	char* origin;
-#endif
+	char* origin; // mmap的起始地址（含保护页）
+	size_t map_size;
+	stShareStack_t* owner; // 所属共享栈，独立栈为NULL
+	unsigned int co_num; // 分配到此栈上的存活协程数
+	unsigned int hot_num; // 此栈上的热点协程数，不为0时不再分配新协程到此栈
 };
 
 struct stShareStack_t
 {
 	unsigned int alloc_idx;
 	int stack_size;
-	int count;
+	int count; // 已分配的共享栈数
+	int max_count; // 共享栈数量上限
+	unsigned int co_num; // 使用共享栈的存活协程数
+	int hot_count; // 有热点协程（不再分配新协程）的共享栈数
 	stStackMem_t** stack_array;
 };
 
@@ -74,12 +108,24 @@ struct stCoRoutine_t
 	//save satck buffer while confilct on same stack_buffer;
 	char* stack_sp; 
 	unsigned int save_size;
+	unsigned int save_capacity; // save_buffer实际分配的大小
 	char* save_buffer;
 
-	stCoSpec_t aSpec[1024];
+	// 栈拷贝统计，用于识别热点协程
+	unsigned long long ullSaveStart; // 当前统计周期开始时间
+	unsigned int iSaveCnt; // 当前统计周期内被换出共享栈的次数
+	unsigned long long ullSaveBytes; // 累计换出的字节数
+	char cHot; // 是否为热点协程
 
+	stTimeoutItem_t stSleepItem; // co_sleep_ms/co_sleep_until使用的超时项（内嵌在协程对象中，不需要分配）
+
+	stCoSpec_t *aSpec; // 协程私有数据，首次co_setspecific时才分配（CO_SPEC_SIZE个）
+
+	stCoRoutine_t *pNextFree; // 线程内协程对象池的链表
 };
 
+#define CO_SPEC_SIZE 1024
+
 
 
 //1.env
@@ -99,7 +145,7 @@ void    co_yield_env(  stCoRoutineEnv_t *env );
 struct stTimeout_t;
 struct stTimeoutItem_t ;
 
-stTimeout_t *AllocTimeout( int iSize );
+stTimeout_t *AllocTimeout();
 void 	FreeTimeout( stTimeout_t *apTimeout );
 int  	AddTimeout( stTimeout_t *apTimeout,stTimeoutItem_t *apItem ,uint64_t allNow );
 
@@ -110,6 +156,22 @@ void 		FreeEpoll( stCoEpoll_t *ctx );
 stCoRoutine_t *		GetCurrThreadCo();
 void 				SetEpoll( stCoRoutineEnv_t *env,stCoEpoll_t *ev );
 
+//4.persistent fd event (edge-triggered, registered once per thread epoll)
+struct stCoFdEvent_t;
+stCoFdEvent_t *		co_fd_event_alloc( stCoEpoll_t *ctx,int fd );
+void 				co_fd_event_release( stCoFdEvent_t *ev );
+stCoEpoll_t *		co_fd_event_ctx( stCoFdEvent_t *ev );
+int 				co_fd_event_wait( stCoFdEvent_t *ev,short events,short *revents,int timeout );
+void 				co_fd_event_set_callback( stCoFdEvent_t *ev,short events,pfn_co_fd_callback_t pfn,void *arg );
+
+//5.io_uring
+struct stCoUring_t;
+struct io_uring_sqe;
+stCoUring_t *		co_get_uring_ct(); // 未开启或内核不支持时返回NULL
+// 提交填好的sqe并挂起当前协程直到完成，返回cqe结果（负数为-errno），超时返回-EAGAIN
+int 				co_uring_wait( stCoUring_t *ring,struct io_uring_sqe *sqe,int timeout );
+bool 				co_is_share_stack_buffer( const void *buf,size_t len );
+
 typedef void (*pfnCoRoutineFunc_t)();
 
 #endif
@@ -0,0 +1,266 @@
+/*
+* Tencent is pleased to support the open source community by making Libco available.
+
+* Copyright (C) 2014 THL A29 Limited, a Tencent company. All rights reserved.
+*
+* Licensed under the Apache License, Version 2.0 (the "License"); 
+* you may not use this file except in compliance with the License. 
+* You may obtain a copy of the License at
+*
+*	http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, 
+* software distributed under the License is distributed on an "AS IS" BASIS, 
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. 
+* See the License for the specific language governing permissions and 
+* limitations under the License.
+*/
+
+#include "co_uring.h"
+#include "co_routine.h"
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#ifdef CO_HAS_URING
+
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+#ifndef __NR_io_uring_setup
+#define __NR_io_uring_setup 425
+#endif
+#ifndef __NR_io_uring_enter
+#define __NR_io_uring_enter 426
+#endif
+
+struct stCoUring_t
+{
+	int iRingFd;
+
+	// sq
+	unsigned *sq_head;
+	unsigned *sq_tail;
+	unsigned *sq_mask;
+	unsigned *sq_array;
+	struct io_uring_sqe *sqes;
+	unsigned sq_entries;
+	unsigned sqe_tail; // 本地已填充但未提交的位置
+	unsigned sqe_submitted;
+
+	// cq
+	unsigned *cq_head;
+	unsigned *cq_tail;
+	unsigned *cq_mask;
+	struct io_uring_cqe *cqes;
+
+	void *sq_ptr;
+	size_t sq_map_size;
+	void *cq_ptr;
+	size_t cq_map_size;
+	size_t sqes_map_size;
+};
+
+static int sys_io_uring_setup( unsigned entries,struct io_uring_params *p )
+{
+	return (int)syscall( __NR_io_uring_setup,entries,p );
+}
+
+static int sys_io_uring_enter( int fd,unsigned to_submit,unsigned min_complete,unsigned flags )
+{
+	return (int)syscall( __NR_io_uring_enter,fd,to_submit,min_complete,flags,NULL,0 );
+}
+
+stCoUring_t *co_uring_alloc( unsigned entries )
+{
+	struct io_uring_params p;
+	memset( &p,0,sizeof(p) );
+	// 每个连接通常都有一个挂起的读请求，cq要足够大
+	p.flags = IORING_SETUP_CQSIZE;
+	p.cq_entries = entries * 16;
+
+	int fd = sys_io_uring_setup( entries,&p );
+	if( fd < 0 )
+	{
+		return NULL;
+	}
+
+	stCoUring_t *ring = (stCoUring_t*)calloc( 1,sizeof(stCoUring_t) );
+	ring->iRingFd = fd;
+
+	ring->sq_map_size = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+	ring->cq_map_size = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+	if( p.features & IORING_FEAT_SINGLE_MMAP )
+	{
+		if( ring->cq_map_size > ring->sq_map_size ) ring->sq_map_size = ring->cq_map_size;
+		ring->cq_map_size = ring->sq_map_size;
+	}
+
+	ring->sq_ptr = mmap( 0,ring->sq_map_size,PROT_READ | PROT_WRITE,MAP_SHARED | MAP_POPULATE,fd,IORING_OFF_SQ_RING );
+	if( ring->sq_ptr == MAP_FAILED )
+	{
+		close( fd );
+		free( ring );
+		return NULL;
+	}
+
+	if( p.features & IORING_FEAT_SINGLE_MMAP )
+	{
+		ring->cq_ptr = ring->sq_ptr;
+	}
+	else
+	{
+		ring->cq_ptr = mmap( 0,ring->cq_map_size,PROT_READ | PROT_WRITE,MAP_SHARED | MAP_POPULATE,fd,IORING_OFF_CQ_RING );
+		if( ring->cq_ptr == MAP_FAILED )
+		{
+			munmap( ring->sq_ptr,ring->sq_map_size );
+			close( fd );
+			free( ring );
+			return NULL;
+		}
+	}
+
+	ring->sqes_map_size = p.sq_entries * sizeof(struct io_uring_sqe);
+	ring->sqes = (struct io_uring_sqe*)mmap( 0,ring->sqes_map_size,PROT_READ | PROT_WRITE,MAP_SHARED | MAP_POPULATE,fd,IORING_OFF_SQES );
+	if( ring->sqes == MAP_FAILED )
+	{
+		if( ring->cq_ptr != ring->sq_ptr ) munmap( ring->cq_ptr,ring->cq_map_size );
+		munmap( ring->sq_ptr,ring->sq_map_size );
+		close( fd );
+		free( ring );
+		return NULL;
+	}
+
+	char *sq = (char*)ring->sq_ptr;
+	ring->sq_head = (unsigned*)( sq + p.sq_off.head );
+	ring->sq_tail = (unsigned*)( sq + p.sq_off.tail );
+	ring->sq_mask = (unsigned*)( sq + p.sq_off.ring_mask );
+	ring->sq_array = (unsigned*)( sq + p.sq_off.array );
+	ring->sq_entries = p.sq_entries;
+	ring->sqe_tail = ring->sqe_submitted = *ring->sq_tail;
+
+	char *cq = (char*)ring->cq_ptr;
+	ring->cq_head = (unsigned*)( cq + p.cq_off.head );
+	ring->cq_tail = (unsigned*)( cq + p.cq_off.tail );
+	ring->cq_mask = (unsigned*)( cq + p.cq_off.ring_mask );
+	ring->cqes = (struct io_uring_cqe*)( cq + p.cq_off.cqes );
+
+	return ring;
+}
+
+void co_uring_free( stCoUring_t *ring )
+{
+	if( !ring ) return;
+
+	munmap( ring->sqes,ring->sqes_map_size );
+	if( ring->cq_ptr != ring->sq_ptr ) munmap( ring->cq_ptr,ring->cq_map_size );
+	munmap( ring->sq_ptr,ring->sq_map_size );
+	close( ring->iRingFd );
+	free( ring );
+}
+
+int co_uring_fd( stCoUring_t *ring )
+{
+	return ring->iRingFd;
+}
+
+struct io_uring_sqe *co_uring_get_sqe( stCoUring_t *ring )
+{
+	unsigned head = __atomic_load_n( ring->sq_head,__ATOMIC_ACQUIRE );
+	if( ring->sqe_tail - head >= ring->sq_entries )
+	{
+		co_uring_submit( ring );
+		head = __atomic_load_n( ring->sq_head,__ATOMIC_ACQUIRE );
+		if( ring->sqe_tail - head >= ring->sq_entries )
+		{
+			return NULL;
+		}
+	}
+
+	unsigned idx = ring->sqe_tail & *ring->sq_mask;
+	struct io_uring_sqe *sqe = &ring->sqes[ idx ];
+	memset( sqe,0,sizeof(*sqe) );
+	ring->sq_array[ idx ] = idx;
+	ring->sqe_tail++;
+	return sqe;
+}
+
+int co_uring_submit( stCoUring_t *ring )
+{
+	unsigned n = ring->sqe_tail - ring->sqe_submitted;
+	if( n == 0 )
+	{
+		return 0;
+	}
+
+	__atomic_store_n( ring->sq_tail,ring->sqe_tail,__ATOMIC_RELEASE );
+	int ret = sys_io_uring_enter( ring->iRingFd,n,0,0 );
+	co_get_stat_ct()->ullIoSysCallCnt++;
+	if( ret > 0 )
+	{
+		ring->sqe_submitted += ret;
+	}
+	return ret;
+}
+
+bool co_uring_cq_ready( stCoUring_t *ring )
+{
+	return *ring->cq_head != __atomic_load_n( ring->cq_tail,__ATOMIC_ACQUIRE );
+}
+
+int co_uring_reap( stCoUring_t *ring,pfn_co_uring_cqe_t pfn,void *arg )
+{
+	unsigned head = *ring->cq_head;
+	unsigned tail = __atomic_load_n( ring->cq_tail,__ATOMIC_ACQUIRE );
+	int cnt = 0;
+	while( head != tail )
+	{
+		struct io_uring_cqe *cqe = &ring->cqes[ head & *ring->cq_mask ];
+		uint64_t user_data = cqe->user_data;
+		int res = cqe->res;
+		head++;
+		__atomic_store_n( ring->cq_head,head,__ATOMIC_RELEASE );
+
+		pfn( user_data,res,arg );
+		cnt++;
+
+		if( head == tail )
+		{
+			tail = __atomic_load_n( ring->cq_tail,__ATOMIC_ACQUIRE );
+		}
+	}
+	return cnt;
+}
+
+#else
+
+stCoUring_t *co_uring_alloc( unsigned entries )
+{
+	return NULL;
+}
+void co_uring_free( stCoUring_t *ring )
+{
+}
+int co_uring_fd( stCoUring_t *ring )
+{
+	return -1;
+}
+struct io_uring_sqe *co_uring_get_sqe( stCoUring_t *ring )
+{
+	return NULL;
+}
+int co_uring_submit( stCoUring_t *ring )
+{
+	return 0;
+}
+bool co_uring_cq_ready( stCoUring_t *ring )
+{
+	return false;
+}
+int co_uring_reap( stCoUring_t *ring,pfn_co_uring_cqe_t pfn,void *arg )
+{
+	return 0;
+}
+
+#endif
@@ -0,0 +1,52 @@
+/*
+* Tencent is pleased to support the open source community by making Libco available.
+
+* Copyright (C) 2014 THL A29 Limited, a Tencent company. All rights reserved.
+*
+* Licensed under the Apache License, Version 2.0 (the "License"); 
+* you may not use this file except in compliance with the License. 
+* You may obtain a copy of the License at
+*
+*	http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, 
+* software distributed under the License is distributed on an "AS IS" BASIS, 
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. 
+* See the License for the specific language governing permissions and 
+* limitations under the License.
+*/
+
+#ifndef __CO_URING_H__
+#define __CO_URING_H__
+#include <stdint.h>
+#include <sys/types.h>
+
+// io_uring的最小封装（直接使用系统调用，不依赖liburing）
+// 内核或头文件不支持时co_uring_alloc返回NULL，调用方退回epoll方式
+#if defined( __linux__ ) && defined( __has_include )
+#if __has_include( <linux/io_uring.h> )
+#define CO_HAS_URING 1
+#include <linux/io_uring.h>
+#endif
+#endif
+
+#ifndef CO_HAS_URING
+struct io_uring_sqe;
+#endif
+
+struct stCoUring_t;
+typedef void (*pfn_co_uring_cqe_t)( uint64_t user_data,int res,void *arg );
+
+stCoUring_t *	co_uring_alloc( unsigned entries );
+void 			co_uring_free( stCoUring_t *ring );
+int 			co_uring_fd( stCoUring_t *ring );
+
+// 取一个空闲sqe（已清零），sq满时先提交
+struct io_uring_sqe *co_uring_get_sqe( stCoUring_t *ring );
+// 一次系统调用提交所有未提交的sqe，返回提交数量
+int 			co_uring_submit( stCoUring_t *ring );
+bool 			co_uring_cq_ready( stCoUring_t *ring );
+// 处理所有已完成的cqe，返回处理数量
+int 			co_uring_reap( stCoUring_t *ring,pfn_co_uring_cqe_t pfn,void *arg );
+
+#endif
@@ -27,7 +27,7 @@ void Condition::wait(Mutex &lock) {
             // 尝试把_res值从0改成1（防止此时条件变量被其他线程操作）
             if (_res.compare_exchange_weak(v, 1)) {
                 // 在条件变量处挂起协程等待唤醒，挂起前需要先释放锁
-                _waitRoutines.push_back({GetPid(), co_self()});
+                _waitRoutines.push_back({RoutineEnvironment::getEnv(), co_self()});
 
                 _res.store(0);
 
@@ -64,7 +64,7 @@ void Condition::signal() {
 
                     _res.store(0);
 
-                    RoutineEnvironment::resumeCoroutine(info.pid, info.co, 0);
+                    RoutineEnvironment::resumeCoroutine(info.env, info.co, 0);
                 }
 
                 return;
@@ -95,7 +95,7 @@ void Condition::broadcast() {
                     _res.store(0);
 
                     for (auto& info : waitRoutines) {
-                        RoutineEnvironment::resumeCoroutine(info.pid, info.co, 0);
+                        RoutineEnvironment::resumeCoroutine(info.env, info.co, 0);
                     }                    
                 }
 
@@ -23,7 +23,7 @@
 namespace corpc {
     class Condition {
         struct RoutineInfo {
-            pid_t pid;
+            RoutineEnvironment *env;
             stCoRoutine_t *co;
         };
 
@@ -32,10 +32,16 @@
 #include "corpc_utils.h"
 
 #define USE_NO_LOCK_QUEUE
+#define USE_SEGMENT_QUEUE // IO层任务队列使用分段无界队列（不逐个分配节点）
 
 //#define MONITOR_ROUTINE
 #define CORPC_MAX_BUFFER_SIZE 0x10000
+#define CORPC_WORKER_BATCH_SIZE 32 // worker每次从消息队列批量取出的消息数
 #define CORPC_MAX_REQUEST_SIZE 0x100000
+#define CORPC_PIPELINE_BUFFER_KEEP_SIZE 0x1000 // pipeline消息缓冲区的常驻上限，超过部分在消息处理完后释放
+#define CORPC_MAX_IOV_NUM 64 // sender每次分散写的最大片段数
+#define CORPC_SENDER_MAX_DEFER_TASKS 256 // sender连续处理多少个任务后必须唤醒延迟发送的连接
+#define CORPC_MIN_REF_PAYLOAD_SIZE 0x400 // 不小于此长度的原始消息体以引用方式分散写，更小的直接拷贝到发送缓冲区更划算
 #define CORPC_MAX_RESPONSE_SIZE 0x100000
 
 #define CORPC_REQUEST_HEAD_SIZE 28
@@ -194,6 +200,8 @@ namespace corpc {
         uint16_t tag;
         uint32_t serial;
         std::shared_ptr<void> msg;  // 当isRaw为true时，msg中存的是std::string指针，当isRaw为false时，msg中存的是google::protobuf::Message指针。这是为了广播或转发消息给玩家时不需要对数据进行protobuf编解码
+        bool crcReady = false; // 广播时预先算好的消息体CRC，编码时不再逐连接计算（仅不加密的原始消息有效）
+        uint16_t crc = 0;
     };
     
     template <typename T>
@@ -18,6 +18,7 @@
 
 #include "corpc_inner_rpc.h"
 #include "corpc_utils.h"
+#include "corpc_thread_placement.h"
 #include "corpc_controller.h"
 
 #include <google/protobuf/service.h>
@@ -33,7 +34,7 @@ void InnerRpcChannel::CallMethod(const google::protobuf::MethodDescriptor *metho
     InnerRpcRequest *req = new InnerRpcRequest;
     req->server = _server;
     req->rpcTask = std::make_shared<RpcClientTask>();
-    req->rpcTask->pid = GetPid();
+    req->rpcTask->env = RoutineEnvironment::getEnv();
     req->rpcTask->co = co_self();
     req->rpcTask->request = request;
     req->rpcTask->controller = controller;
@@ -138,14 +139,16 @@ void InnerRpcServer::start(uint32_t workerThreadNum) {
     if (workerThreadNum > 0) {
         _ts.resize(workerThreadNum);
         for (int i=0; i<workerThreadNum; i++) {
-            _ts[i] = std::thread(threadEntry, this);
+            _ts[i] = std::thread(threadEntry, this, i);
         }
     } else {
         RoutineEnvironment::startCoroutine(requestQueueRoutine, this);
     }
 }
 
-void InnerRpcServer::threadEntry( InnerRpcServer * self ) {
+void InnerRpcServer::threadEntry( InnerRpcServer * self, uint16_t index ) {
+    ThreadPlacement::apply(THREAD_ROLE_INNER_RPC, index);
+    
     // 启动rpc任务处理协程
     RoutineEnvironment::startCoroutine(requestQueueRoutine, self);
     
@@ -167,7 +170,7 @@ void *InnerRpcServer::requestQueueRoutine( void * arg ) {
         if (request->rpcTask->expireTime != 0 && now >= request->rpcTask->expireTime) {
             assert(request->rpcTask->response);
             // 超时
-            RoutineEnvironment::resumeCoroutine(request->rpcTask->pid, request->rpcTask->co, request->rpcTask->expireTime, ETIMEDOUT);
+            RoutineEnvironment::resumeCoroutine(request->rpcTask->env, request->rpcTask->co, request->rpcTask->expireTime, ETIMEDOUT);
 
             delete request;
         } else {
@@ -188,7 +191,7 @@ void *InnerRpcServer::requestQueueRoutine( void * arg ) {
                 
                 if (request->rpcTask->response) {
                     // 唤醒协程处理结果
-                    RoutineEnvironment::resumeCoroutine(request->rpcTask->pid, request->rpcTask->co, request->rpcTask->expireTime);
+                    RoutineEnvironment::resumeCoroutine(request->rpcTask->env, request->rpcTask->co, request->rpcTask->expireTime);
                 } else {
                     // not_care_response类型的rpc需要在这里触发回调清理request，除非没有要清理的资源
                     if (request->rpcTask->done) {
@@ -248,7 +251,7 @@ void *InnerRpcServer::requestQueueRoutine( void * arg ) {
 //            if (request->rpcTask->expireTime != 0 && now >= request->rpcTask->expireTime) {
 //                assert(request->rpcTask->response);
 //                // 超时
-//                RoutineEnvironment::resumeCoroutine(request->rpcTask->pid, request->rpcTask->co, request->rpcTask->expireTime, ETIMEDOUT);
+//                RoutineEnvironment::resumeCoroutine(request->rpcTask->env, request->rpcTask->co, request->rpcTask->expireTime, ETIMEDOUT);
 //
 //                delete request;
 //            } else {
@@ -269,7 +272,7 @@ void *InnerRpcServer::requestQueueRoutine( void * arg ) {
 //                    
 //                    if (request->rpcTask->response) {
 //                        // 唤醒协程处理结果
-//                        RoutineEnvironment::resumeCoroutine(request->rpcTask->pid, request->rpcTask->co, request->rpcTask->expireTime);
+//                        RoutineEnvironment::resumeCoroutine(request->rpcTask->env, request->rpcTask->co, request->rpcTask->expireTime);
 //                    } else {
 //                        // not_care_response类型的rpc需要在这里触发回调清理request，除非没有要清理的资源
 //                        if (request->rpcTask->done) {
@@ -317,7 +320,7 @@ void *InnerRpcServer::requestRoutine( void * arg ) {
     
     if (request->rpcTask->response) {
         // 唤醒协程处理结果
-        RoutineEnvironment::resumeCoroutine(request->rpcTask->pid, request->rpcTask->co, request->rpcTask->expireTime);
+        RoutineEnvironment::resumeCoroutine(request->rpcTask->env, request->rpcTask->co, request->rpcTask->expireTime);
     } else {
 //ERROR_LOG("InnerRpcServer::requestRoutine call done\n");
         // not_care_response类型的rpc需要在这里触发回调清理request
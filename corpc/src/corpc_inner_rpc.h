@@ -67,7 +67,7 @@ namespace corpc {
     private:
         ~InnerRpcServer() {}  // 不允许在栈上创建server
         
-        static void threadEntry( InnerRpcServer * self );
+        static void threadEntry( InnerRpcServer * self, uint16_t index );
         
         static void *requestQueueRoutine( void * arg );   // 处理Request，若rpc定义了need_coroutine，启动单独的taskCallRoutine协程来处理rpc任务
         
@@ -23,9 +23,103 @@
 #include <arpa/inet.h>
 #include <fcntl.h>
 
+#if defined( __linux__ )
+#include <linux/filter.h>
+#endif
+
 // TODO: 使用统一的Log接口记录Log
 using namespace corpc;
 
+namespace {
+    // IO线程共享的读写缓冲区，连接协程只在读到数据到upflow结束（或downflow到写出）期间占用，空闲连接不持有缓冲区
+    // 若占用期间协程被挂起（如编解码时等待协程锁），同线程其他连接临时分配缓冲区
+    class ThreadIOBuffer {
+    public:
+        ThreadIOBuffer(): _buf(new uint8_t[CORPC_MAX_BUFFER_SIZE]), _inUse(false) {}
+        ~ThreadIOBuffer() { delete [] _buf; }
+        
+        uint8_t *acquire() {
+            if (!_inUse) {
+                _inUse = true;
+                return _buf;
+            }
+            
+            return new uint8_t[CORPC_MAX_BUFFER_SIZE];
+        }
+        
+        void release(uint8_t *buf) {
+            if (buf == _buf) {
+                _inUse = false;
+            } else {
+                delete [] buf;
+            }
+        }
+        
+    private:
+        uint8_t *_buf;
+        bool _inUse;
+    };
+    
+    __thread ThreadIOBuffer *g_readBuffer = nullptr;
+    __thread ThreadIOBuffer *g_writeBuffer = nullptr;
+    
+    ThreadIOBuffer *getReadBuffer() {
+        if (!g_readBuffer) {
+            g_readBuffer = new ThreadIOBuffer;
+        }
+        return g_readBuffer;
+    }
+    
+    ThreadIOBuffer *getWriteBuffer() {
+        if (!g_writeBuffer) {
+            g_writeBuffer = new ThreadIOBuffer;
+        }
+        return g_writeBuffer;
+    }
+    
+    // reactor模式下发送线程的合并定时器，COALESCE策略未攒够数据的连接每毫秒检查一次
+    struct CoalesceTimer {
+        std::vector<std::shared_ptr<Connection>> connections;
+        stCoRoutine_t *routine = nullptr;
+        bool hang = false;
+    };
+    
+    __thread CoalesceTimer *g_coalesceTimer = nullptr;
+    
+    // 部分写出后跳过已写出的sentNum字节，把剩余片段中位于线程共享缓冲区buf中的数据转存到left并修改iov指向，
+    // 引用的数据体由调用方保持有效，返回剩余片段的起始下标
+    int saveLeftSegments(uint8_t *buf, struct iovec *iov, int iovcnt, size_t sentNum, std::string &left) {
+        int idx = 0;
+        while (sentNum >= iov[idx].iov_len) {
+            sentNum -= iov[idx].iov_len;
+            idx++;
+        }
+        iov[idx].iov_base = (uint8_t *)iov[idx].iov_base + sentNum;
+        iov[idx].iov_len -= sentNum;
+        
+        size_t leftNum = 0;
+        for (int i = idx; i < iovcnt; i++) {
+            uint8_t *base = (uint8_t *)iov[i].iov_base;
+            if (base >= buf && base < buf + CORPC_MAX_BUFFER_SIZE) {
+                leftNum += iov[i].iov_len;
+            }
+        }
+        
+        left.assign(leftNum, 0);
+        uint8_t *lbuf = (uint8_t *)left.data();
+        for (int i = idx; i < iovcnt; i++) {
+            uint8_t *base = (uint8_t *)iov[i].iov_base;
+            if (base >= buf && base < buf + CORPC_MAX_BUFFER_SIZE) {
+                memcpy(lbuf, base, iov[i].iov_len);
+                iov[i].iov_base = lbuf;
+                lbuf += iov[i].iov_len;
+            }
+        }
+        
+        return idx;
+    }
+}
+
 Worker::~Worker() {
     
 }
@@ -34,23 +128,32 @@ void Worker::addMessage(void *msg) {
     _queue.push(msg);
 }
 
+void Worker::addMessages(std::vector<void*>& msgs) {
+    _queue.pushBatch(msgs.data(), (int)msgs.size());
+}
+
 void *Worker::msgHandleRoutine( void * arg ) {
     Worker *self = (Worker *)arg;
     WorkerMessageQueue& queue = self->_queue;
 
+    void *msgs[CORPC_WORKER_BATCH_SIZE];
     while (true) {
-        // 处理任务队列
-        void *msg = queue.pop();
-
-        self->handleMessage(msg);
+        // 批量取出任务，减少队列同步开销
+        int num = queue.popBatch(msgs, CORPC_WORKER_BATCH_SIZE);
         
-        RoutineEnvironment::pauseIfRuntimeBusy();
+        for (int i = 0; i < num; i++) {
+            self->handleMessage(msgs[i]);
+            
+            RoutineEnvironment::pauseIfRuntimeBusy();
+        }
     }
 }
 
 MultiThreadWorker::~MultiThreadWorker() {}
 
-void MultiThreadWorker::threadEntry( Worker *self ) {
+void MultiThreadWorker::threadEntry( Worker *self, uint16_t index ) {
+    ThreadPlacement::apply(THREAD_ROLE_WORKER, index);
+    
     // 启动rpc任务处理协程
     RoutineEnvironment::startCoroutine(msgHandleRoutine, self);
     
@@ -60,7 +163,7 @@ void MultiThreadWorker::threadEntry( Worker *self ) {
 void MultiThreadWorker::start() {
     // 启动线程
     for (int i = 0; i < _threadNum; i++) {
-        _ts[i] = std::thread(threadEntry, this);
+        _ts[i] = std::thread(threadEntry, this, i);
     }
 }
 
@@ -76,41 +179,68 @@ Pipeline::Pipeline(std::shared_ptr<Connection> &connection, Worker *worker): _co
 
 Pipeline::~Pipeline() {}
 
-MessagePipeline::MessagePipeline(std::shared_ptr<Connection> &connection, Worker *worker, DecodeFunction decodeFun, EncodeFunction encodeFun, uint headSize, uint maxBodySize): corpc::Pipeline(connection, worker), _decodeFun(decodeFun), _encodeFun(encodeFun), _headSize(headSize), _maxBodySize(maxBodySize), _bodySize(0), _head(headSize,0), _body(maxBodySize,0), _downflowBufSentNum(0) {
+bool Pipeline::downflowv(uint8_t *buf, int space, struct iovec *iov, int maxIov, int &iovcnt, std::vector<std::shared_ptr<void>> &refs) {
+    int size = 0;
+    iovcnt = 0;
+    if (!downflow(buf, space, size)) {
+        return false;
+    }
+    
+    if (size > 0) {
+        iov[0].iov_base = buf;
+        iov[0].iov_len = size;
+        iovcnt = 1;
+    }
+    
+    return true;
+}
+
+static uint8_t g_emptyBody[1]; // 未分配消息体缓冲区时_bodyBuf指向这里，保证解码函数拿到的body非空
+
+MessagePipeline::MessagePipeline(std::shared_ptr<Connection> &connection, Worker *worker, DecodeFunction decodeFun, EncodeFunction encodeFun, uint headSize, uint maxBodySize): corpc::Pipeline(connection, worker), _decodeFun(decodeFun), _encodeFun(encodeFun), _headSize(headSize), _maxBodySize(maxBodySize), _bodySize(0), _head(headSize,0), _bodyCapacity(0), _downflowBufSentNum(0) {
     _headBuf = (uint8_t *)_head.data();
-    _bodyBuf = (uint8_t *)_body.data();
+    _bodyBuf = g_emptyBody;
 }
 
 MessagePipeline::~MessagePipeline() {}
 
-bool MessagePipeline::downflow(uint8_t *buf, int space, int &size) {
-    std::shared_ptr<Connection> connection = _connection.lock();
-    assert(connection);
+int MessagePipeline::flushDownflowBuf(uint8_t *buf, int space) {
+    size_t dlen = _downflowBuf.length();
+    if (dlen == 0) {
+        return 0;
+    }
     
-    size = 0;
+    assert(dlen > _downflowBufSentNum);
+    uint8_t *_dbuf = (uint8_t *)_downflowBuf.data();
     
-    size_t dlen = _downflowBuf.length();
-    if (dlen > 0) {
-        assert(dlen > _downflowBufSentNum);
-        uint8_t *_dbuf = (uint8_t *)_downflowBuf.data();
+    if ((size_t)space >= dlen - _downflowBufSentNum) {
+        int size = int(dlen - _downflowBufSentNum);
+        memcpy(buf, _dbuf + _downflowBufSentNum, size);
         
-        if (space >= dlen - _downflowBufSentNum) {
-            memcpy(buf, _dbuf + _downflowBufSentNum, dlen - _downflowBufSentNum);
-            
-            size = int(dlen - _downflowBufSentNum);
-            
-            _downflowBuf.clear();
-            _downflowBufSentNum = 0;
+        // 大消息发送完后不再保留其缓冲区
+        if (_downflowBuf.capacity() > CORPC_PIPELINE_BUFFER_KEEP_SIZE) {
+            std::string().swap(_downflowBuf);
         } else {
-            memcpy(buf, _dbuf + _downflowBufSentNum, space);
-            
-            size = space;
-            _downflowBufSentNum += space;
+            _downflowBuf.clear();
         }
+        _downflowBufSentNum = 0;
         
-        if (space == size) {
-            return true;
-        }
+        return size;
+    }
+    
+    memcpy(buf, _dbuf + _downflowBufSentNum, space);
+    _downflowBufSentNum += space;
+    
+    return space;
+}
+
+bool MessagePipeline::downflow(uint8_t *buf, int space, int &size) {
+    std::shared_ptr<Connection> connection = _connection.lock();
+    assert(connection);
+    
+    size = flushDownflowBuf(buf, space);
+    if (space == size) {
+        return true;
     }
     
     while (connection->getDataSize() > 0) {
@@ -132,6 +262,107 @@ bool MessagePipeline::downflow(uint8_t *buf, int space, int &size) {
     return true;
 }
 
+// 与上一个片段相连时合并，否则新增片段
+static inline void appendIov(struct iovec *iov, int &iovcnt, uint8_t *base, int len) {
+    if (iovcnt > 0 && (uint8_t *)iov[iovcnt-1].iov_base + iov[iovcnt-1].iov_len == base) {
+        iov[iovcnt-1].iov_len += len;
+    } else {
+        iov[iovcnt].iov_base = base;
+        iov[iovcnt].iov_len = len;
+        iovcnt++;
+    }
+}
+
+bool MessagePipeline::downflowv(uint8_t *buf, int space, struct iovec *iov, int maxIov, int &iovcnt, std::vector<std::shared_ptr<void>> &refs) {
+    if (!_encodeRefFun) {
+        return Pipeline::downflowv(buf, space, iov, maxIov, iovcnt, refs);
+    }
+    
+    std::shared_ptr<Connection> connection = _connection.lock();
+    assert(connection);
+    
+    iovcnt = 0;
+    int size = flushDownflowBuf(buf, space);
+    if (size > 0) {
+        appendIov(iov, iovcnt, buf, size);
+    }
+    
+    // 每条消息最多占用头部和数据体两个片段
+    while (size < space && iovcnt + 2 <= maxIov && connection->getDataSize() > 0) {
+        std::shared_ptr<void> &data = connection->getFrontData();
+        
+        int tmp = 0;
+        struct iovec payload = {nullptr, 0};
+        if (_encodeRefFun(connection, data, buf + size, space - size, tmp, payload)) {
+            if (!tmp) { // buf已满
+                return true;
+            }
+            
+            appendIov(iov, iovcnt, buf + size, tmp);
+            size += tmp;
+            
+            if (payload.iov_len > 0) {
+                iov[iovcnt++] = payload;
+                refs.push_back(data);
+            }
+        } else {
+            if (!_encodeFun(connection, data, buf + size, space - size, tmp, _downflowBuf, _downflowBufSentNum)) {
+                // 编码失败
+                return false;
+            }
+            
+            if (!tmp) { // buf已满
+                return true;
+            }
+            
+            appendIov(iov, iovcnt, buf + size, tmp);
+            size += tmp;
+        }
+        
+        connection->popFrontData();
+    }
+    
+    return true;
+}
+
+void MessagePipeline::flushMessages() {
+    if (!_msgBatch.empty()) {
+        _worker->addMessages(_msgBatch);
+        _msgBatch.clear();
+    }
+}
+
+void MessagePipeline::reserveBody(uint size) {
+    if (size <= _bodyCapacity) {
+        return;
+    }
+    
+    // 按倍数增长以减少连续变大的消息带来的重复分配，但不超过_maxBodySize
+    uint capacity = std::max(size, std::min(_bodyCapacity * 2, _maxBodySize));
+    _body.reset(new uint8_t[capacity]);
+    _bodyBuf = _body.get();
+    _bodyCapacity = capacity;
+}
+
+void MessagePipeline::shrinkBody() {
+    if (_bodySize == 0 && _bodyCapacity > CORPC_PIPELINE_BUFFER_KEEP_SIZE) {
+        _body.reset();
+        _bodyBuf = g_emptyBody;
+        _bodyCapacity = 0;
+    }
+}
+
+uint MessagePipeline::parseBodySize(const uint8_t *head, uint bodySizeOffset, SIZE_TYPE bodySizeType) {
+    if (bodySizeType == TWO_BYTES) {
+        uint16_t x = *(uint16_t*)(head + bodySizeOffset);
+        return be16toh(x);
+    } else {
+        assert(bodySizeType == FOUR_BYTES);
+        uint32_t x = *(uint32_t*)(head + bodySizeOffset);
+        return be32toh(x);
+    }
+}
+
 TcpPipeline::TcpPipeline(std::shared_ptr<Connection> &connection, Worker *worker, DecodeFunction decodeFun, EncodeFunction encodeFun, uint headSize, uint maxBodySize, uint bodySizeOffset, SIZE_TYPE bodySizeType): corpc::MessagePipeline(connection, worker, decodeFun, encodeFun, headSize, maxBodySize), _bodySizeOffset(bodySizeOffset), _bodySizeType(bodySizeType), _headNum(0), _bodyNum(0) {
 }
 
@@ -142,6 +373,36 @@ bool TcpPipeline::upflow(uint8_t *buf, int size) {
     // 解析数据
     int offset = 0;
     while (size > offset) {
+        // 没有待重组的消息且本次数据中包含完整消息时，直接在读缓冲区上解码，不拷贝
+        if (_headNum == 0 && size - offset >= (int)_headSize) {
+            uint8_t *head = buf + offset;
+            uint bodySize = parseBodySize(head, _bodySizeOffset, _bodySizeType);
+            
+            if (bodySize > _maxBodySize) { // 数据超长
+                ERROR_LOG("TcpPipeline::upflow -- request too large in thread, %d > %d\n", bodySize, _maxBodySize);
+                
+                flushMessages();
+                return false;
+            }
+            
+            if (size - offset - _headSize >= bodySize) {
+                void *msg = _decodeFun(connection, head, head + _headSize, bodySize);
+                
+                if (connection->isDecodeError()) {
+                    flushMessages();
+                    return false;
+                }
+                
+                if (msg) {
+                    _msgBatch.push_back(msg);
+                }
+                
+                offset += _headSize + bodySize;
+                continue;
+            }
+        }
+        
+        // 不完整的消息拷贝到重组缓冲区中
         // 先解析头部
         if (_headNum < _headSize) {
             int needNum = _headSize - _headNum;
@@ -160,20 +421,16 @@ bool TcpPipeline::upflow(uint8_t *buf, int size) {
         
         if (!_bodySize) {
             // 解析消息长度值
-            if (_bodySizeType == TWO_BYTES) {
-                uint16_t x = *(uint16_t*)(_headBuf + _bodySizeOffset);
-                _bodySize = be16toh(x);
-            } else {
-                assert(_bodySizeType == FOUR_BYTES);
-                uint32_t x = *(uint32_t*)(_headBuf + _bodySizeOffset);
-                _bodySize = be32toh(x);
-            }
+            _bodySize = parseBodySize(_headBuf, _bodySizeOffset, _bodySizeType);
             
             if (_bodySize > _maxBodySize) { // 数据超长
                 ERROR_LOG("TcpPipeline::upflow -- request too large in thread, %d > %d\n", _bodySize, _maxBodySize);
                 
+                flushMessages();
                 return false;
             }
+            
+            reserveBody(_bodySize);
         }
         
         // 从缓存中解析数据
@@ -195,11 +452,12 @@ bool TcpPipeline::upflow(uint8_t *buf, int size) {
         void *msg = _decodeFun(connection, _headBuf, _bodyBuf, _bodySize);
         
         if (connection->isDecodeError()) {
+            flushMessages();
             return false;
         }
         
         if (msg) {
-            _worker->addMessage(msg);
+            _msgBatch.push_back(msg);
         }
         
         // 处理完一个请求消息，复位状态
@@ -208,6 +466,11 @@ bool TcpPipeline::upflow(uint8_t *buf, int size) {
         _bodySize = 0;
     }
     
+    // 一次读取解析出的所有消息只通知worker一次
+    flushMessages();
+    
+    shrinkBody();
+    
     return true;
 }
 
@@ -225,15 +488,8 @@ bool UdpPipeline::upflow(uint8_t *buf, int size) {
         return false;
     }
     
-    memcpy(_headBuf, buf, _headSize);
-    
-    _bodySize = size - _headSize;
-    
-    if (_bodySize) {
-        memcpy(_bodyBuf, buf + _headSize, _bodySize);
-    }
-    
-    void *msg = _decodeFun(connection, _headBuf, _bodyBuf, _bodySize);
+    // 一个数据报就是一条完整消息，直接在读缓冲区上解码
+    void *msg = _decodeFun(connection, buf, buf + _headSize, size - _headSize);
     
     if (connection->isDecodeError()) {
         return false;
@@ -251,14 +507,19 @@ PipelineFactory::~PipelineFactory() {}
 MessagePipelineFactory::~MessagePipelineFactory() {}
 
 std::shared_ptr<corpc::Pipeline> TcpPipelineFactory::buildPipeline(std::shared_ptr<corpc::Connection> &connection) {
-    return std::shared_ptr<corpc::Pipeline>( new corpc::TcpPipeline(connection, _worker, _decodeFun, _encodeFun, _headSize, _maxBodySize, _bodySizeOffset, _bodySizeType) );
+    corpc::TcpPipeline *pipeline = new corpc::TcpPipeline(connection, _worker, _decodeFun, _encodeFun, _headSize, _maxBodySize, _bodySizeOffset, _bodySizeType);
+    if (_encodeRefFun) {
+        pipeline->setEncodeRefFunction(_encodeRefFun);
+    }
+    
+    return std::shared_ptr<corpc::Pipeline>( pipeline );
 }
 
 std::shared_ptr<corpc::Pipeline> UdpPipelineFactory::buildPipeline(std::shared_ptr<corpc::Connection> &connection) {
     return std::shared_ptr<corpc::Pipeline>( new corpc::UdpPipeline(connection, _worker, _decodeFun, _encodeFun, _headSize, _maxBodySize) );
 }
 
-Connection::Connection(int fd, IO* io, bool needHB): _fd(fd), _io(io), _needHB(needHB), _routineHang(false), _routine(NULL), _sendThreadIndex(-1), _recvThreadIndex(-1), _decodeError(false), _closed(false), _isClosing(false), _canClose(false), _lastRecvHBTime(0) {
+Connection::Connection(int fd, IO* io, bool needHB): _fd(fd), _io(io), _needHB(needHB), _routineHang(false), _routine(NULL), _sendThreadIndex(-1), _recvThreadIndex(-1), _decodeError(false), _closed(false), _isClosing(false), _canClose(false), _closeStage(0), _lastRecvHBTime(0), _affinityKey(0), _resumePending(false), _pendingBytes(0), _pendingTime(0), _reactorSend(false), _corked(false), _coalesceWaiting(false) {
 }
 
 Connection::~Connection() {
@@ -270,6 +531,11 @@ void Connection::send(std::shared_ptr<void> data) {
     _io->_sender->send(self, data);
 }
 
+void Connection::sendBatch(std::vector<std::shared_ptr<void>>& datas) {
+    std::shared_ptr<Connection> self = shared_from_this();
+    _io->_sender->sendBatch(self, datas);
+}
+
 void Connection::close() {
     if (isOpen()) {
         std::shared_ptr<Connection> self = shared_from_this();
@@ -303,11 +569,41 @@ ssize_t Connection::write(const void *buf, size_t nbyte) {
     return sentNum;
 }
 
+ssize_t Connection::writev(const struct iovec *iov, int iovcnt) {
+    if (iovcnt == 1) {
+        return write(iov[0].iov_base, iov[0].iov_len);
+    }
+    
+    size_t total = 0;
+    for (int i = 0; i < iovcnt; i++) {
+        total += iov[i].iov_len;
+    }
+    
+    // hook后的writev在fd不可写时挂起协程，直到全部写完或出错
+    ssize_t ret = ::writev(_fd, iov, iovcnt);
+    if (ret < 0 || (size_t)ret < total) {
+        WARN_LOG("Connection::writev -- writev fd %d ret %d errno %d (%s)\n",
+                   _fd, (int)ret, errno, strerror(errno));
+        return -1;
+    }
+    
+    return ret;
+}
+
+ssize_t Connection::writeNowait(const void *buf, size_t nbyte) {
+    return co_write_nowait(_fd, buf, nbyte);
+}
+
+ssize_t Connection::writevNowait(const struct iovec *iov, int iovcnt) {
+    return co_writev_nowait(_fd, iov, iovcnt);
+}
+
 Server::~Server() {}
 
-std::shared_ptr<Connection> Server::buildAndAddConnection(int fd) {
+std::shared_ptr<Connection> Server::buildAndAddConnection(int fd, int recvThreadIndex) {
     LOG("fd %d connected\n", fd);
     std::shared_ptr<corpc::Connection> connection(buildConnection(fd));
+    connection->setFlushPolicy(_flushPolicy);
     std::shared_ptr<corpc::Pipeline> pipeline = _pipelineFactory->buildPipeline(connection);
     connection->setPipeline(pipeline);
     
@@ -317,7 +613,7 @@ std::shared_ptr<Connection> Server::buildAndAddConnection(int fd) {
     onConnect(connection);
     
     // 将接受的连接分别发给Receiver和Sender
-    _io->addConnection(connection);
+    _io->addConnection(connection, recvThreadIndex);
     
     // 判断是否需要心跳
     if (connection->needHB()) {
@@ -374,12 +670,12 @@ Acceptor::~Acceptor() {
 }
 
 void *TcpAcceptor::acceptRoutine( void * arg ) {
-    TcpAcceptor *self = (TcpAcceptor *)arg;
+    ListenContext *context = (ListenContext *)arg;
+    TcpAcceptor *self = context->acceptor;
     Server *server = self->_server;
-    int listen_fd = self->_listen_fd;
+    int listen_fd = context->listenFd;
     
     LOG("start listen %d %s:%d\n", listen_fd, self->_ip.c_str(), self->_port);
-    listen( listen_fd, 1024 );
     
     // 注意：由于accept方法没有进行hook，只好将它设置为NONBLOCK并且自己对它进行poll
     int iFlags = fcntl(listen_fd, F_GETFL, 0);
@@ -407,41 +703,118 @@ void *TcpAcceptor::acceptRoutine( void * arg ) {
         // 保持连接
         setKeepAlive(fd, 10);
         
+        setNoDelay(fd, server->getFlushPolicy().noDelay);
+        
         // 设置读写超时时间，默认为1秒
         co_set_timeout(fd, -1, 1000);
         
-        server->buildAndAddConnection(fd);
+        server->buildAndAddConnection(fd, context->recvThreadIndex);
     }
     
     return NULL;
 }
 
+int TcpAcceptor::createListenSocket(bool reusePort) {
+    int listen_fd = socket(AF_INET,SOCK_STREAM, IPPROTO_TCP);
+    if( listen_fd >= 0 )
+    {
+        int nReuseAddr = 1;
+        setsockopt(listen_fd, SOL_SOCKET, SO_REUSEADDR, &nReuseAddr, sizeof(nReuseAddr));
+        if (reusePort) {
+            setsockopt(listen_fd, SOL_SOCKET, SO_REUSEPORT, &nReuseAddr, sizeof(nReuseAddr));
+        }
+        
+        // 在这里listen，reusePort模式下侦听socket在组中的序号即listen的顺序，需与接收线程下标一致
+        if( bind(listen_fd, (struct sockaddr*)&_local_addr, sizeof(_local_addr)) == -1 ||
+            listen(listen_fd, _server->getAcceptPolicy().backlog) == -1 )
+        {
+            close(listen_fd);
+            listen_fd = -1;
+        }
+    }
+    
+    return listen_fd;
+}
+
+bool TcpAcceptor::attachCpuSteering(int listenFd, uint16_t threadNum) {
+#if defined( SO_ATTACH_REUSEPORT_CBPF )
+    // 取处理该包的CPU号，若有接收线程绑定在该核上则返回该线程的侦听socket序号，否则返回CPU号对线程数取模
+    std::vector<struct sock_filter> code;
+    code.push_back(BPF_STMT(BPF_LD | BPF_W | BPF_ABS, (uint32_t)(SKF_AD_OFF + SKF_AD_CPU)));
+    for (uint16_t i = 0; i < threadNum; i++) {
+        int cpu = ThreadPlacement::getCpu(THREAD_ROLE_RECEIVER, i);
+        if (cpu >= 0) {
+            code.push_back(BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, (uint32_t)cpu, 0, 1));
+            code.push_back(BPF_STMT(BPF_RET | BPF_K, i));
+        }
+    }
+    code.push_back(BPF_STMT(BPF_ALU | BPF_MOD | BPF_K, threadNum));
+    code.push_back(BPF_STMT(BPF_RET | BPF_A, 0));
+    
+    struct sock_fprog prog;
+    prog.len = code.size();
+    prog.filter = code.data();
+    if (setsockopt(listenFd, SOL_SOCKET, SO_ATTACH_REUSEPORT_CBPF, &prog, sizeof(prog)) < 0) {
+        ERROR_LOG("TcpAcceptor::attachCpuSteering() -- attach reuseport cbpf failed, errno %d (%s)\n", errno, strerror(errno));
+        return false;
+    }
+    
+    return true;
+#else
+    ERROR_LOG("TcpAcceptor::attachCpuSteering() -- SO_ATTACH_REUSEPORT_CBPF is not supported\n");
+    return false;
+#endif
+}
+
 bool TcpAcceptor::start() {
     if (_port == 0) {
         ERROR_LOG("TcpAcceptor::start() -- port can't be 0\n");
         return false;
     }
     
-    _listen_fd = socket(AF_INET,SOCK_STREAM, IPPROTO_TCP);
-    if( _listen_fd >= 0 )
-    {
-        int nReuseAddr = 1;
-        setsockopt(_listen_fd, SOL_SOCKET, SO_REUSEADDR, &nReuseAddr, sizeof(nReuseAddr));
+    const AcceptPolicy &policy = _server->getAcceptPolicy();
+    if (!policy.reusePort) {
+        _listen_fd = createListenSocket(false);
+        if(_listen_fd==-1){
+            ERROR_LOG("TcpAcceptor::start() -- Can't create socket on %s:%d\n", _ip.c_str(), _port);
+            return false;
+        }
         
-        if( bind(_listen_fd, (struct sockaddr*)&_local_addr, sizeof(_local_addr)) == -1 )
-        {
-            close(_listen_fd);
-            _listen_fd = -1;
+        _listens.push_back({this, _listen_fd, -1});
+        
+        // 启动accept协程
+        RoutineEnvironment::startCoroutine(acceptRoutine, &_listens[0]);
+        
+        return true;
+    }
+    
+    // 每个接收线程一个侦听socket
+    Receiver *receiver = _server->getIO()->getReceiver();
+    uint16_t threadNum = receiver->getThreadNum();
+    for (uint16_t i = 0; i < threadNum; i++) {
+        int listen_fd = createListenSocket(true);
+        if (listen_fd == -1) {
+            ERROR_LOG("TcpAcceptor::start() -- Can't create reuseport socket %d on %s:%d\n", i, _ip.c_str(), _port);
+            for (auto& listen : _listens) {
+                close(listen.listenFd);
+            }
+            _listens.clear();
+            return false;
         }
+        
+        _listens.push_back({this, listen_fd, i});
     }
+    _listen_fd = _listens[0].listenFd;
     
-    if(_listen_fd==-1){
-        ERROR_LOG("TcpAcceptor::start() -- Can't create socket on %s:%d\n", _ip.c_str(), _port);
-        return false;
+    // 侦听socket组共用一个程序，附加到任意一个上即可
+    if (policy.cpuSteering && threadNum > 1) {
+        attachCpuSteering(_listen_fd, threadNum);
     }
     
-    // 启动accept协程
-    RoutineEnvironment::startCoroutine(acceptRoutine, this);
+    // 在各接收线程中启动accept协程
+    for (uint16_t i = 0; i < threadNum; i++) {
+        receiver->startRoutine(i, acceptRoutine, &_listens[i]);
+    }
     
     return true;
 }
@@ -658,31 +1031,65 @@ bool UdpAcceptor::start() {
     return true;
 }
 
+void ThreadLoadCounter::sample(uint64_t nowms) {
+    uint64_t bytes = _bytes.load(std::memory_order_relaxed);
+    
+    if (_sampleTime != 0 && nowms > _sampleTime) {
+        _bytesPerSecond.store((bytes - _sampleBytes) * 1000 / (nowms - _sampleTime), std::memory_order_relaxed);
+    }
+    _sampleTime = nowms;
+    _sampleBytes = bytes;
+}
+
+void ThreadLoadCounter::getLoad(ThreadLoad &load) {
+    load.connectionNum = _connectionNum.load(std::memory_order_relaxed);
+    load.bytes = _bytes.load(std::memory_order_relaxed);
+    load.bytesPerSecond = _bytesPerSecond.load(std::memory_order_relaxed);
+}
+
+void *ThreadLoadCounter::sampleRoutine( void *arg ) {
+    ThreadLoadCounter *counter = (ThreadLoadCounter *)arg;
+    
+    counter->sample(mtime());
+    while (true) {
+        co_sleep_ms(SAMPLE_INTERVAL);
+        counter->sample(mtime());
+    }
+    
+    return NULL;
+}
+
 Receiver::~Receiver() {}
 
+void Receiver::getThreadLoads(std::vector<ThreadLoad>& loads) {
+    loads.resize(_loads.size());
+    for (size_t i = 0; i < _loads.size(); i++) {
+        _loads[i].getLoad(loads[i]);
+    }
+}
+
 void *Receiver::connectionDispatchRoutine( void * arg ) {
     QueueContext *context = (QueueContext*)arg;
     
     ReceiverTaskQueue& queue = context->_queue;
     
-    // 初始化pipe readfd
-    int readFd = queue.getReadFd();
-    co_register_fd(readFd);
-    co_set_timeout(readFd, -1, 1000);
+    // 注册队列通知fd
+    int notifyFd = queue.getNotifyFd();
+    co_register_fd(notifyFd);
+    co_set_timeout(notifyFd, -1, 1000);
     
     int ret;
-    std::vector<char> buf(1024);
     while (true) {
         // 等待处理信号
-        ret = (int)read(readFd, &buf[0], 1024);
+        ret = queue.wait();
         assert(ret != 0);
         if (ret < 0) {
             if (errno == EAGAIN) {
                 continue;
             } else {
-                // 管道出错
-                ERROR_LOG("Receiver::connectDispatchRoutine read from pipe fd %d ret %d errno %d (%s)\n",
-                       readFd, ret, errno, strerror(errno));
+                // 通知fd出错
+                ERROR_LOG("Receiver::connectDispatchRoutine wait on notify fd %d ret %d errno %d (%s)\n",
+                       notifyFd, ret, errno, strerror(errno));
                 
                 // TODO: 如何处理？退出协程？
                 // sleep 10 milisecond
@@ -693,97 +1100,266 @@ void *Receiver::connectionDispatchRoutine( void * arg ) {
         // 处理任务队列
         ReceiverTask* recvTask = queue.pop();
         while (recvTask) {
-            recvTask->connection->onReceiverInit();
-            RoutineEnvironment::startCoroutine(connectionRoutine, recvTask);
+            switch (recvTask->type) {
+                case ReceiverTask::SENDER_CLOSED:
+                    finishClose(recvTask->connection);
+                    delete recvTask;
+                    break;
+                case ReceiverTask::START_ROUTINE:
+                    RoutineEnvironment::startCoroutine(recvTask->routine, recvTask->arg);
+                    delete recvTask;
+                    break;
+                default:
+                    startReceive(recvTask);
+                    break;
+            }
             
             recvTask = queue.pop();
         }
     }
 }
 
+void Receiver::startReceive(ReceiverTask *recvTask) {
+    recvTask->connection->onReceiverInit();
+    
+    int fd = recvTask->connection->getfd();
+    if (recvTask->connection->_io->_reactor && co_set_fd_callback(fd, POLLIN, onReadable, recvTask) == 0) {
+        // 数据报socket每次只读一个包，不能以短读判断已读空
+        int type = SOCK_STREAM;
+        socklen_t len = sizeof(type);
+        getsockopt(fd, SOL_SOCKET, SO_TYPE, &type, &len);
+        recvTask->stream = type == SOCK_STREAM;
+        
+        // 注册前可能已有数据到达（边缘已触发），先读一次
+        onReadable(fd, POLLIN, recvTask);
+    } else {
+        RoutineEnvironment::startCoroutine(connectionRoutine, recvTask);
+    }
+}
+
+void Receiver::addLocalConnection(std::shared_ptr<Connection>& connection) {
+    _loads[connection->getRecvThreadIndex()].addConnection();
+    
+    ReceiverTask *recvTask = new ReceiverTask;
+    recvTask->connection = connection;
+    
+    startReceive(recvTask);
+}
+
 void *Receiver::connectionRoutine( void * arg ) {
     // TODO: 限流，用滑动窗口算法进行限流，connection中增加限流标记（只对客户端的连接限流），触发限流阈值断线
     ReceiverTask *recvTask = (ReceiverTask *)arg;
     std::shared_ptr<Connection> connection = recvTask->connection;
     delete recvTask;
     
-    IO *io = connection->_io;
-    
     int fd = connection->getfd();
     DEBUG_LOG("start Receiver::connectionRoutine for fd:%d in thread:%d\n", fd, GetPid());
     
-    std::string buffs(CORPC_MAX_BUFFER_SIZE,0);
-    uint8_t *buf = (uint8_t *)buffs.data();
+    ThreadIOBuffer *ioBuffer = getReadBuffer();
+    // 开启io_uring时经hook的read提交读请求，由内核异步读到连接自己的缓冲区（请求在途期间协程挂起，不能使用线程共享缓冲区）；
+    // 空闲连接的读请求不会写缓冲区，缓冲区的页只在收到数据后才实际占用内存
+    uint8_t *uringBuf = co_is_uring_enabled() ? new uint8_t[CORPC_MAX_BUFFER_SIZE] : nullptr;
+    // 读到EAGAIN后才等待可读：持久化注册（边缘触发）时只有新的边缘才会唤醒等待，不能以短读判断内核中已无数据——
+    // 数据和FIN可能在同一次边缘中到达，数据报socket每次只读一个包，且upflow中挂起期间到达的边缘没有等待者会被丢弃
+    bool needWait = false;
     int retryTimes = 0;
     while (true) {
-        // 先将数据读到缓存中（尽可能多的读）
-        int ret = (int)read(fd, buf, CORPC_MAX_BUFFER_SIZE);
-        
-        if (ret <= 0) {
-            // ret 0 mean disconnected
+        uint8_t *buf;
+        int ret;
+        if (uringBuf) {
+            buf = uringBuf;
+            ret = (int)read(fd, buf, CORPC_MAX_BUFFER_SIZE);
             if (ret < 0 && errno == EAGAIN) {
-                // 这里设置最大重试次数
+                // 读超时（已等待了一个读超时周期），与等待可读超时同样处理
                 if (retryTimes < 5) {
-                    msleep(100);
                     retryTimes++;
                     continue;
                 }
+                
+                DEBUG_LOG("Receiver::connectionRoutine -- read timeout fd %d\n", fd);
+                break;
+            }
+        } else {
+            // 等待可读期间不占用线程共享缓冲区
+            if (needWait) {
+                int pollret = co_wait_readable(fd);
+                if (pollret == 0) {
+                    // 等待超时（已等待了一个读超时周期），重新等待，这里设置最大重试次数
+                    if (retryTimes < 5) {
+                        retryTimes++;
+                        continue;
+                    }
+                    
+                    DEBUG_LOG("Receiver::connectionRoutine -- wait readable timeout fd %d\n", fd);
+                    break;
+                }
+                
+                needWait = false;
+            }
+            
+            // 将数据读到线程共享缓冲区中（尽可能多的读），读到后立即交给pipeline处理
+            buf = ioBuffer->acquire();
+            ret = (int)co_read_nowait(fd, buf, CORPC_MAX_BUFFER_SIZE);
+        }
+        
+        if (ret <= 0) {
+            if (buf != uringBuf) {
+                ioBuffer->release(buf);
+            }
+            
+            if (ret < 0 && (errno == EAGAIN || errno == EINTR)) {
+                needWait = true;
+                continue;
             }
             
-            // 出错处理（断线）
+            // 出错处理（断线），ret 0 mean disconnected
             DEBUG_LOG("Receiver::connectionRoutine -- read reqhead fd %d ret %d errno %d (%s)\n",
                    fd, ret, errno, strerror(errno));
             
             break;
         }
         
-        if (!connection->getPipeline()->upflow(buf, ret)) {
+        connection->_io->_receiver->_loads[connection->_recvThreadIndex].addBytes(ret);
+        
+        bool ok = connection->getPipeline()->upflow(buf, ret);
+        if (buf != uringBuf) {
+            ioBuffer->release(buf);
+        }
+        
+        if (!ok) {
             break;
         }
     }
-DEBUG_LOG("Receiver::connectionRoutine -- 1\n");
-    io->_sender->removeConnection(connection); // 通知sender关闭connection
-    shutdown(fd, SHUT_WR);  // 让sender中的fd相关协程退出
-    
-DEBUG_LOG("Receiver::connectionRoutine -- 2\n");
-    // 等待写关闭
-    while (!connection->_canClose) {
-        // sleep 100 milisecond
-        msleep(100);
-    }
-    
-DEBUG_LOG("Receiver::connectionRoutine -- 3\n");
-    close(fd);
     
-    connection->_closed = true;
-    
-DEBUG_LOG("Receiver::connectionRoutine -- 4\n");
-    connection->onClose();
+    delete [] uringBuf;
+    closeConnection(connection);
     DEBUG_LOG("Receiver::connectionRoutine -- routine end for fd %d\n", fd);
     return NULL;
 }
 
-void MultiThreadReceiver::threadEntry(ThreadData *tdata) {
+void Receiver::onReadable( int fd, short revents, void *arg ) {
+    ReceiverTask *recvTask = (ReceiverTask *)arg;
+    std::shared_ptr<Connection>& connection = recvTask->connection;
+    
+    // 边缘触发，需要读到内核中没有数据为止
+    ThreadIOBuffer *ioBuffer = getReadBuffer();
+    while (true) {
+        uint8_t *buf = ioBuffer->acquire();
+        int ret = (int)co_read_nowait(fd, buf, CORPC_MAX_BUFFER_SIZE);
+        
+        if (ret <= 0) {
+            ioBuffer->release(buf);
+            
+            if (ret < 0 && errno == EAGAIN) {
+                return;
+            }
+            
+            if (ret < 0 && errno == EINTR) {
+                continue;
+            }
+            
+            DEBUG_LOG("Receiver::onReadable -- read fd %d ret %d errno %d (%s)\n",
+                   fd, ret, errno, strerror(errno));
+            break;
+        }
+        
+        connection->_io->_receiver->_loads[connection->_recvThreadIndex].addBytes(ret);
+        
+        bool ok = connection->getPipeline()->upflow(buf, ret);
+        ioBuffer->release(buf);
+        
+        if (!ok) {
+            break;
+        }
+        
+        // 短读说明内核中已无数据，但对端已关闭时数据和FIN可能在同一次边缘触发中到达，需继续读到0后关闭
+        if (recvTask->stream && ret < CORPC_MAX_BUFFER_SIZE && !(revents & (POLLRDHUP | POLLHUP | POLLERR))) {
+            return;
+        }
+    }
+    
+    // 断线：取消回调，关闭fd需要在开启hook的协程中进行（事件循环中未开启hook，close不会清理fd的hook信息）
+    co_set_fd_callback(fd, POLLIN, NULL, NULL);
+    RoutineEnvironment::startCoroutine(closeRoutine, recvTask);
+}
+
+void *Receiver::closeRoutine( void * arg ) {
+    ReceiverTask *recvTask = (ReceiverTask *)arg;
+    std::shared_ptr<Connection> connection = recvTask->connection;
+    delete recvTask;
+    
+    closeConnection(connection);
+    return NULL;
+}
+
+void Receiver::closeConnection(std::shared_ptr<Connection>& connection) {
+    DEBUG_LOG("Receiver::closeConnection -- fd %d\n", connection->getfd());
+    connection->_io->_receiver->_loads[connection->_recvThreadIndex].removeConnection();
+    connection->_io->_sender->removeConnection(connection); // 通知sender关闭connection
+    shutdown(connection->getfd(), SHUT_WR);  // 让sender中的fd相关协程退出
+    
+    // sender结束后会通过任务队列通知本线程，不需要在这里等待
+    finishClose(connection);
+}
+
+void Receiver::finishClose(std::shared_ptr<Connection>& connection) {
+    // 接收和发送两端的结束都在接收线程中处理，后结束的一方关闭fd
+    if (++connection->_closeStage < 2) {
+        return;
+    }
+    
+    DEBUG_LOG("Receiver::finishClose -- close fd %d\n", connection->getfd());
+    close(connection->getfd());
+    
+    connection->_closed = true;
+    
+    connection->onClose();
+}
+
+void MultiThreadReceiver::threadEntry(ThreadData *tdata) {
+    ThreadPlacement::apply(THREAD_ROLE_RECEIVER, tdata->_index);
+    
     // 启动处理待处理连接协程
     RoutineEnvironment::startCoroutine(connectionDispatchRoutine, &tdata->_queueContext);
     
+    // 启动本线程负载采样协程
+    RoutineEnvironment::startCoroutine(ThreadLoadCounter::sampleRoutine, &static_cast<MultiThreadReceiver *>(tdata->_queueContext._receiver)->_loads[tdata->_index]);
+    
     RoutineEnvironment::runEventLoop();
 }
 
 bool MultiThreadReceiver::start() {
     // 启动线程
-    for (auto& td : _threadDatas) {
+    for (size_t i = 0; i < _threadDatas.size(); i++) {
+        ThreadData& td = _threadDatas[i];
         td._queueContext._receiver = this;
+        td._index = i;
         td._t = std::thread(threadEntry, &td);
     }
     
     return true;
 }
 
-void MultiThreadReceiver::addConnection(std::shared_ptr<Connection>& connection) {
-    uint16_t index = (_lastThreadIndex++) % _threadNum;
+void MultiThreadReceiver::notifySenderClosed(std::shared_ptr<Connection>& connection) {
+    ReceiverTask *recvTask = new ReceiverTask;
+    recvTask->type = ReceiverTask::SENDER_CLOSED;
+    recvTask->connection = connection;
     
-    connection->setRecvThreadIndex(index);
+    _threadDatas[connection->getRecvThreadIndex()]._queueContext._queue.push(recvTask);
+}
+
+void MultiThreadReceiver::startRoutine(uint16_t threadIndex, pfn_co_routine_t routine, void *arg) {
+    ReceiverTask *recvTask = new ReceiverTask;
+    recvTask->type = ReceiverTask::START_ROUTINE;
+    recvTask->routine = routine;
+    recvTask->arg = arg;
+    
+    _threadDatas[threadIndex]._queueContext._queue.push(recvTask);
+}
+
+void MultiThreadReceiver::addConnection(std::shared_ptr<Connection>& connection) {
+    uint16_t index = connection->getRecvThreadIndex();
+    _loads[index].addConnection();
     
     ReceiverTask *recvTask = new ReceiverTask;
     recvTask->connection = connection;
@@ -793,12 +1369,13 @@ void MultiThreadReceiver::addConnection(std::shared_ptr<Connection>& connection)
 
 bool CoroutineReceiver::start() {
     RoutineEnvironment::startCoroutine(connectionDispatchRoutine, &_queueContext);
+    RoutineEnvironment::startCoroutine(ThreadLoadCounter::sampleRoutine, &_loads[0]);
     
     return true;
 }
 
 void CoroutineReceiver::addConnection(std::shared_ptr<Connection>& connection) {
-    connection->setRecvThreadIndex(0);
+    _loads[0].addConnection();
     
     ReceiverTask *recvTask = new ReceiverTask;
     recvTask->connection = connection;
@@ -806,33 +1383,58 @@ void CoroutineReceiver::addConnection(std::shared_ptr<Connection>& connection) {
     _queueContext._queue.push(recvTask);
 }
 
+void CoroutineReceiver::startRoutine(uint16_t threadIndex, pfn_co_routine_t routine, void *arg) {
+    ReceiverTask *recvTask = new ReceiverTask;
+    recvTask->type = ReceiverTask::START_ROUTINE;
+    recvTask->routine = routine;
+    recvTask->arg = arg;
+    
+    _queueContext._queue.push(recvTask);
+}
+
+void CoroutineReceiver::notifySenderClosed(std::shared_ptr<Connection>& connection) {
+    ReceiverTask *recvTask = new ReceiverTask;
+    recvTask->type = ReceiverTask::SENDER_CLOSED;
+    recvTask->connection = connection;
+    
+    _queueContext._queue.push(recvTask);
+}
+
 Sender::~Sender() {
     
 }
 
+void Sender::getThreadLoads(std::vector<ThreadLoad>& loads) {
+    loads.resize(_loads.size());
+    for (size_t i = 0; i < _loads.size(); i++) {
+        _loads[i].getLoad(loads[i]);
+    }
+}
+
 void *Sender::taskQueueRoutine( void * arg ) {
     QueueContext *context = (QueueContext*)arg;
     
     SenderTaskQueue& queue = context->_queue;
     
-    // 初始化pipe readfd
-    int readFd = queue.getReadFd();
-    co_register_fd(readFd);
-    co_set_timeout(readFd, -1, 1000);
+    // 注册队列通知fd
+    int notifyFd = queue.getNotifyFd();
+    co_register_fd(notifyFd);
+    co_set_timeout(notifyFd, -1, 1000);
+    
+    std::vector<std::shared_ptr<Connection>> deferred; // 非IMMEDIATE策略的连接在任务队列处理完后统一唤醒
     
     int ret;
-    std::vector<char> buf(1024);
     while (true) {
         // 等待处理信号
-        ret = (int)read(readFd, &buf[0], 1024);
+        ret = queue.wait();
         assert(ret != 0);
         if (ret < 0) {
             if (errno == EAGAIN) {
                 continue;
             } else {
-                // 管道出错
-                ERROR_LOG("Sender::taskQueueRoutine read from pipe fd %d ret %d errno %d (%s)\n",
-                       readFd, ret, errno, strerror(errno));
+                // 通知fd出错
+                ERROR_LOG("Sender::taskQueueRoutine wait on notify fd %d ret %d errno %d (%s)\n",
+                       notifyFd, ret, errno, strerror(errno));
                 
                 // TODO: 如何处理？退出协程？
                 // sleep 10 milisecond
@@ -841,50 +1443,115 @@ void *Sender::taskQueueRoutine( void * arg ) {
         }
     
         // 处理任务队列
+        int taskNum = 0;
         SenderTask *task = queue.pop();
         while (task) {
             switch (task->type) {
                 case SenderTask::INIT:
                     task->connection->onSenderInit();
-                    RoutineEnvironment::startCoroutine(connectionRoutine, task);
+                    
+                    // reactor模式下回调参数直接用连接指针：发送结束并通知receiver前receiver一直持有连接，结束时先取消回调
+                    if (task->connection->_io->_reactor && co_set_fd_callback(task->connection->_fd, POLLOUT, onWritable, task->connection.get()) == 0) {
+                        task->connection->_reactorSend = true;
+                        delete task;
+                    } else {
+                        RoutineEnvironment::startCoroutine(connectionRoutine, task);
+                    }
                     break;
                     
                 case SenderTask::CLOSE:
                     if (!task->connection->_isClosing) {
                         task->connection->_isClosing = true;
                         
-                        if (task->connection->_routineHang) {
-                            co_resume(task->connection->_routine);
-                        }
+                        resumeConnection(task->connection.get());
                     }
                     
                     delete task;
                     break;
                     
                 case SenderTask::DATA:
-                    // 若连接未关闭，放入connection的等待发送队列，若connection协程挂起则唤醒执行
-                    if (!task->connection->_isClosing) {
-                        task->connection->_datas.push_back(task->data);
-                        
-                        // 唤醒挂起的connection协程
-                        if (task->connection->_routineHang) {
-                            co_resume(task->connection->_routine);
-                        }
-                    } else {
-                        task->connection->cleanDataOnClosing(task->data);
+                    // 若连接未关闭，放入connection的等待发送队列，并唤醒挂起的connection协程
+                    pushData(task->connection, task->data);
+                    wakeConnection(task->connection, deferred);
+                    
+                    delete task;
+                    break;
+                    
+                case SenderTask::DATAS:
+                    // 批量数据只唤醒一次connection协程
+                    for (auto& data : task->datas) {
+                        pushData(task->connection, data);
+                    }
+                    wakeConnection(task->connection, deferred);
+                    
+                    delete task;
+                    break;
+                    
+                case SenderTask::MULTICAST:
+                    // 一个任务携带本线程中多个连接的数据
+                    for (size_t i = 0; i < task->connections.size(); i++) {
+                        pushData(task->connections[i], task->datas[i]);
+                        wakeConnection(task->connections[i], deferred);
                     }
                     
                     delete task;
                     break;
             }
             
+            // 队列处理完（或连续处理任务过多）时才唤醒延迟发送的连接，使同一轮的数据合并发送
             task = queue.pop();
+            if (!deferred.empty() && (!task || ++taskNum >= CORPC_SENDER_MAX_DEFER_TASKS)) {
+                for (auto& connection : deferred) {
+                    connection->_resumePending = false;
+                    resumeConnection(connection.get());
+                }
+                
+                deferred.clear();
+                taskNum = 0;
+            }
         }
     }
     
     return NULL;
 }
 
+void Sender::pushData(std::shared_ptr<Connection>& connection, std::shared_ptr<void>& data) {
+    if (connection->_isClosing) {
+        connection->cleanDataOnClosing(data);
+        return;
+    }
+    
+    if (connection->_flushPolicy.mode == FlushPolicy::COALESCE) {
+        if (connection->_pendingTime == 0) {
+            connection->_pendingTime = mtime();
+        }
+        connection->_pendingBytes += connection->getDataLength(data);
+    }
+    
+    connection->_datas.push_back(data);
+}
+
+void Sender::wakeConnection(std::shared_ptr<Connection>& connection, std::vector<std::shared_ptr<Connection>>& deferred) {
+    if (connection->_isClosing) {
+        return;
+    }
+    
+    if (connection->_flushPolicy.mode == FlushPolicy::IMMEDIATE) {
+        resumeConnection(connection.get());
+    } else if (!connection->_resumePending) {
+        connection->_resumePending = true;
+        deferred.push_back(connection);
+    }
+}
+
+void Sender::resumeConnection(Connection *connection) {
+    if (connection->_reactorSend) {
+        reactorFlush(connection);
+    } else if (connection->_routineHang) {
+        co_resume(connection->_routine);
+    }
+}
+
 void *Sender::connectionRoutine( void * arg ) {
     // 注意: 参数不能传shared_ptr所管理的指针，另外要考虑shared_ptr的多线程问题
     SenderTask *task = (SenderTask*)arg;
@@ -897,22 +1564,47 @@ void *Sender::connectionRoutine( void * arg ) {
     connection->_routine = co_self();
     connection->_routineHang = false;
     
-    std::string buffs(CORPC_MAX_BUFFER_SIZE, 0);
-    uint8_t *buf = (uint8_t *)buffs.data();
+    Sender *sender = connection->_io->_sender;
+    const FlushPolicy &policy = connection->_flushPolicy;
+    bool corked = false;
+    
+    ThreadIOBuffer *ioBuffer = getWriteBuffer();
+    struct iovec iov[CORPC_MAX_IOV_NUM];
+    std::vector<std::shared_ptr<void>> refs; // 被iov引用的待发送数据，发送完成前需保持有效
     //uint32_t startIndex = 0;
     //uint32_t endIndex = 0;
     
     // 若无数据可以发送则挂起，否则整理发送数据并发送
     while (true) {
-        int dataSize = 0;
-        if (!connection->getPipeline()->downflow(buf/* + endIndex*/, CORPC_MAX_BUFFER_SIZE/* - endIndex*/, dataSize)) {
+        // 合并发送：未攒够coalesceBytes时继续等待，直到最早的数据已等待coalesceUs
+        if (policy.mode == FlushPolicy::COALESCE && connection->_pendingTime) {
+            uint64_t deadline = connection->_pendingTime + (policy.coalesceUs + 999) / 1000;
+            while (connection->_pendingBytes < policy.coalesceBytes && !connection->_isClosing && mtime() < deadline) {
+                co_sleep_ms(1);
+            }
+        }
+        
+        int iovcnt = 0;
+        size_t dataNum = connection->getDataSize();
+        uint8_t *buf = ioBuffer->acquire();
+        if (!connection->getPipeline()->downflowv(buf/* + endIndex*/, CORPC_MAX_BUFFER_SIZE/* - endIndex*/, iov, CORPC_MAX_IOV_NUM, iovcnt, refs)) {
+            ioBuffer->release(buf);
             break;
         }
         
+        bool hasMore = connection->getDataSize() > 0;
+        sender->_sentMessageNum.fetch_add(dataNum - connection->getDataSize(), std::memory_order_relaxed);
+        if (!hasMore) {
+            connection->_pendingBytes = 0;
+            connection->_pendingTime = 0;
+        }
+        
         //endIndex += tmp;
         
         //int dataSize = endIndex - startIndex;
-        if (dataSize == 0) {
+        if (iovcnt == 0) {
+            ioBuffer->release(buf);
+            
             //assert(startIndex == 0);
             // 等数据发完再关
             if (connection->_isClosing) {
@@ -927,13 +1619,51 @@ void *Sender::connectionRoutine( void * arg ) {
             continue;
         }
         
-        // 发数据
-        int ret = connection->write(buf/* + startIndex*/, dataSize);
+        size_t dataSize = 0;
+        for (int i = 0; i < iovcnt; i++) {
+            dataSize += iov[i].iov_len;
+        }
+        sender->_loads[connection->_sendThreadIndex].addBytes(dataSize);
+        
+        // 一次发不完时用TCP_CORK让内核把各次写入拼成完整报文段，全部写完后再取消
+        if (policy.mode == FlushPolicy::CORK && hasMore && !corked) {
+            setCork(connection->_fd, true);
+            corked = true;
+        }
+        
+        // 发数据（先直接写，写不完时把剩余数据转存到连接自己的缓冲区后再挂起等待发送，挂起期间不占用线程共享缓冲区）
+        sender->_writeNum.fetch_add(1, std::memory_order_relaxed);
+        int ret = (int)(iovcnt == 1 ? connection->writeNowait(iov[0].iov_base, iov[0].iov_len) : connection->writevNowait(iov, iovcnt));
         if (ret < 0) {
-            break;
+            if (errno != EAGAIN && errno != EINTR) {
+                ioBuffer->release(buf);
+                break;
+            }
+            
+            ret = 0;
+        }
+        
+        if ((size_t)ret < dataSize) {
+            // 只有线程共享缓冲区中的片段需要转存，引用的数据体由refs保持有效
+            std::string left;
+            int idx = saveLeftSegments(buf, iov, iovcnt, ret, left);
+            ioBuffer->release(buf);
+            
+            sender->_writeNum.fetch_add(1, std::memory_order_relaxed);
+            if (connection->writev(iov + idx, iovcnt - idx) < 0) {
+                refs.clear();
+                break;
+            }
+        } else {
+            ioBuffer->release(buf);
+        }
+        
+        refs.clear();
+        
+        if (corked && !hasMore) {
+            setCork(connection->_fd, false);
+            corked = false;
         }
-
-        assert(ret == dataSize);
         //startIndex = endIndex = 0;
 
 
@@ -963,16 +1693,205 @@ void *Sender::connectionRoutine( void * arg ) {
     connection->_isClosing = true;
     shutdown(connection->_fd, SHUT_RD);
     connection->_canClose = true;
+    sender->_loads[connection->_sendThreadIndex].removeConnection();
+    connection->_io->_receiver->notifySenderClosed(connection);
     
     DEBUG_LOG("Sender::connectionRoutine -- routine end for fd %d\n", connection->_fd);
     
     return NULL;
 }
 
+void Sender::onWritable( int fd, short revents, void *arg ) {
+    Connection *connection = (Connection *)arg;
+    
+    // 待发送队列中的数据总是在入队时就发送（或由合并定时器发送），可写时只需处理上次写不进内核的数据
+    if (!connection->_leftIov.empty()) {
+        reactorFlush(connection);
+    }
+}
+
+void *Sender::coalesceTimerRoutine( void * arg ) {
+    CoalesceTimer *timer = (CoalesceTimer *)arg;
+    timer->routine = co_self();
+    
+    std::vector<std::shared_ptr<Connection>> connections;
+    while (true) {
+        if (timer->connections.empty()) {
+            timer->hang = true;
+            co_yield_ct();
+            timer->hang = false;
+            
+            continue;
+        }
+        
+        co_sleep_ms(1);
+        
+        connections.swap(timer->connections);
+        for (auto& connection : connections) {
+            connection->_coalesceWaiting = false;
+            reactorFlush(connection.get());
+        }
+        connections.clear();
+    }
+    
+    return NULL;
+}
+
+void Sender::reactorFlush(Connection *connection) {
+    if (connection->_canClose) {
+        return; // 已结束发送
+    }
+    
+    if (!reactorWrite(connection)) {
+        // 与connectionRoutine结束时相同，但要先取消回调（之后receiver可能随时关闭fd并释放连接）
+        co_set_fd_callback(connection->_fd, POLLOUT, NULL, NULL);
+        
+        connection->_isClosing = true;
+        shutdown(connection->_fd, SHUT_RD);
+        connection->_canClose = true;
+        connection->_io->_sender->_loads[connection->_sendThreadIndex].removeConnection();
+        
+        std::shared_ptr<Connection> ptr = connection->getPtr();
+        connection->_io->_receiver->notifySenderClosed(ptr);
+        
+        DEBUG_LOG("Sender::reactorFlush -- send end for fd %d\n", connection->_fd);
+    }
+}
+
+bool Sender::reactorWrite(Connection *connection) {
+    Sender *sender = connection->_io->_sender;
+    const FlushPolicy &policy = connection->_flushPolicy;
+    
+    // 先发上次剩余的数据，写不完时继续等待可写（关闭时不再等待）
+    std::vector<struct iovec> &leftIov = connection->_leftIov;
+    if (!leftIov.empty()) {
+        sender->_writeNum.fetch_add(1, std::memory_order_relaxed);
+        int ret = (int)(leftIov.size() == 1 ? connection->writeNowait(leftIov[0].iov_base, leftIov[0].iov_len) : connection->writevNowait(leftIov.data(), (int)leftIov.size()));
+        if (ret < 0) {
+            if (errno != EAGAIN && errno != EINTR) {
+                return false;
+            }
+            
+            ret = 0;
+        }
+        
+        size_t sentNum = ret;
+        size_t idx = 0;
+        while (idx < leftIov.size() && sentNum >= leftIov[idx].iov_len) {
+            sentNum -= leftIov[idx].iov_len;
+            idx++;
+        }
+        
+        if (idx < leftIov.size()) {
+            leftIov.erase(leftIov.begin(), leftIov.begin() + idx);
+            leftIov[0].iov_base = (uint8_t *)leftIov[0].iov_base + sentNum;
+            leftIov[0].iov_len -= sentNum;
+            
+            return !connection->_isClosing;
+        }
+        
+        // 全部写完，释放转存的数据
+        std::vector<struct iovec>().swap(leftIov);
+        std::vector<std::shared_ptr<void>>().swap(connection->_leftRefs);
+        std::string().swap(connection->_leftData);
+    }
+    
+    ThreadIOBuffer *ioBuffer = getWriteBuffer();
+    struct iovec iov[CORPC_MAX_IOV_NUM];
+    std::vector<std::shared_ptr<void>> refs; // 被iov引用的待发送数据，发送完成前需保持有效
+    while (true) {
+        // 合并发送：未攒够coalesceBytes且未到coalesceUs时交给合并定时器稍后再发
+        if (policy.mode == FlushPolicy::COALESCE && connection->_pendingTime && connection->_pendingBytes < policy.coalesceBytes &&
+            !connection->_isClosing && mtime() < connection->_pendingTime + (policy.coalesceUs + 999) / 1000) {
+            if (!connection->_coalesceWaiting) {
+                connection->_coalesceWaiting = true;
+                
+                if (!g_coalesceTimer) {
+                    g_coalesceTimer = new CoalesceTimer;
+                }
+                
+                g_coalesceTimer->connections.push_back(connection->getPtr());
+                if (!g_coalesceTimer->routine) {
+                    RoutineEnvironment::startCoroutine(coalesceTimerRoutine, g_coalesceTimer);
+                } else if (g_coalesceTimer->hang) {
+                    co_resume(g_coalesceTimer->routine);
+                }
+            }
+            
+            return true;
+        }
+        
+        int iovcnt = 0;
+        size_t dataNum = connection->getDataSize();
+        uint8_t *buf = ioBuffer->acquire();
+        if (!connection->getPipeline()->downflowv(buf, CORPC_MAX_BUFFER_SIZE, iov, CORPC_MAX_IOV_NUM, iovcnt, refs)) {
+            ioBuffer->release(buf);
+            return false;
+        }
+        
+        bool hasMore = connection->getDataSize() > 0;
+        sender->_sentMessageNum.fetch_add(dataNum - connection->getDataSize(), std::memory_order_relaxed);
+        if (!hasMore) {
+            connection->_pendingBytes = 0;
+            connection->_pendingTime = 0;
+        }
+        
+        if (iovcnt == 0) {
+            ioBuffer->release(buf);
+            
+            if (connection->_corked) {
+                setCork(connection->_fd, false);
+                connection->_corked = false;
+            }
+            
+            // 等数据发完再关
+            return !connection->_isClosing;
+        }
+        
+        size_t dataSize = 0;
+        for (int i = 0; i < iovcnt; i++) {
+            dataSize += iov[i].iov_len;
+        }
+        sender->_loads[connection->_sendThreadIndex].addBytes(dataSize);
+        
+        if (policy.mode == FlushPolicy::CORK && hasMore && !connection->_corked) {
+            setCork(connection->_fd, true);
+            connection->_corked = true;
+        }
+        
+        sender->_writeNum.fetch_add(1, std::memory_order_relaxed);
+        int ret = (int)(iovcnt == 1 ? connection->writeNowait(iov[0].iov_base, iov[0].iov_len) : connection->writevNowait(iov, iovcnt));
+        if (ret < 0) {
+            if (errno != EAGAIN && errno != EINTR) {
+                ioBuffer->release(buf);
+                return false;
+            }
+            
+            ret = 0;
+        }
+        
+        if ((size_t)ret < dataSize) {
+            // 线程共享缓冲区中的片段转存到连接中，引用的数据体随refs一起保存，等待可写回调
+            int idx = saveLeftSegments(buf, iov, iovcnt, ret, connection->_leftData);
+            ioBuffer->release(buf);
+            
+            leftIov.assign(iov + idx, iov + iovcnt);
+            connection->_leftRefs.swap(refs);
+            
+            return !connection->_isClosing;
+        }
+        
+        ioBuffer->release(buf);
+        refs.clear();
+    }
+}
+
 bool MultiThreadSender::start() {
     // 启动线程
-    for (auto& td : _threadDatas) {
+    for (size_t i = 0; i < _threadDatas.size(); i++) {
+        ThreadData& td = _threadDatas[i];
         td._queueContext._sender = this;
+        td._index = i;
         td._t = std::thread(threadEntry, &td);
     }
     
@@ -980,9 +1899,8 @@ bool MultiThreadSender::start() {
 }
 
 void MultiThreadSender::addConnection(std::shared_ptr<Connection>& connection) {
-    uint16_t index = (_lastThreadIndex++) % _threadNum;
-    
-    connection->setSendThreadIndex(index);
+    uint16_t index = connection->getSendThreadIndex();
+    _loads[index].addConnection();
     
     SenderTask *senderTask = new SenderTask;
     senderTask->type = SenderTask::INIT;
@@ -1008,21 +1926,65 @@ void MultiThreadSender::send(std::shared_ptr<Connection>& connection, std::share
     _threadDatas[connection->getSendThreadIndex()]._queueContext._queue.push(senderTask);
 }
 
+void MultiThreadSender::sendBatch(std::shared_ptr<Connection>& connection, std::vector<std::shared_ptr<void>>& datas) {
+    if (datas.empty()) {
+        return;
+    }
+    
+    SenderTask *senderTask = new SenderTask;
+    senderTask->type = SenderTask::DATAS;
+    senderTask->connection = connection;
+    senderTask->datas.swap(datas);
+    
+    _threadDatas[connection->getSendThreadIndex()]._queueContext._queue.push(senderTask);
+}
+
+void MultiThreadSender::multicast(std::vector<std::shared_ptr<Connection>>& connections, std::vector<std::shared_ptr<void>>& datas) {
+    assert(connections.size() == datas.size());
+    
+    // 按发送线程分组，每个线程只推送一个任务
+    std::vector<SenderTask*> tasks(_threadNum, nullptr);
+    for (size_t i = 0; i < connections.size(); i++) {
+        int index = connections[i]->getSendThreadIndex();
+        SenderTask *senderTask = tasks[index];
+        if (!senderTask) {
+            senderTask = new SenderTask;
+            senderTask->type = SenderTask::MULTICAST;
+            tasks[index] = senderTask;
+        }
+        
+        senderTask->connections.push_back(connections[i]);
+        senderTask->datas.push_back(datas[i]);
+    }
+    
+    for (int i = 0; i < _threadNum; i++) {
+        if (tasks[i]) {
+            _threadDatas[i]._queueContext._queue.push(tasks[i]);
+        }
+    }
+}
+
 void MultiThreadSender::threadEntry( ThreadData *tdata ) {
+    ThreadPlacement::apply(THREAD_ROLE_SENDER, tdata->_index);
+    
     // 启动send协程
     RoutineEnvironment::startCoroutine(taskQueueRoutine, &tdata->_queueContext);
     
+    // 启动本线程负载采样协程
+    RoutineEnvironment::startCoroutine(ThreadLoadCounter::sampleRoutine, &static_cast<MultiThreadSender *>(tdata->_queueContext._sender)->_loads[tdata->_index]);
+    
     RoutineEnvironment::runEventLoop();
 }
 
 bool CoroutineSender::start() {
     RoutineEnvironment::startCoroutine(taskQueueRoutine, &_queueContext);
+    RoutineEnvironment::startCoroutine(ThreadLoadCounter::sampleRoutine, &_loads[0]);
     
     return true;
 }
 
 void CoroutineSender::addConnection(std::shared_ptr<Connection>& connection) {
-    connection->setSendThreadIndex(0);
+    _loads[0].addConnection();
     
     SenderTask *senderTask = new SenderTask;
     senderTask->type = SenderTask::INIT;
@@ -1048,6 +2010,33 @@ void CoroutineSender::send(std::shared_ptr<Connection>& connection, std::shared_
     _queueContext._queue.push(senderTask);
 }
 
+void CoroutineSender::sendBatch(std::shared_ptr<Connection>& connection, std::vector<std::shared_ptr<void>>& datas) {
+    if (datas.empty()) {
+        return;
+    }
+    
+    SenderTask *senderTask = new SenderTask;
+    senderTask->type = SenderTask::DATAS;
+    senderTask->connection = connection;
+    senderTask->datas.swap(datas);
+    
+    _queueContext._queue.push(senderTask);
+}
+
+void CoroutineSender::multicast(std::vector<std::shared_ptr<Connection>>& connections, std::vector<std::shared_ptr<void>>& datas) {
+    assert(connections.size() == datas.size());
+    if (connections.empty()) {
+        return;
+    }
+    
+    SenderTask *senderTask = new SenderTask;
+    senderTask->type = SenderTask::MULTICAST;
+    senderTask->connections = connections;
+    senderTask->datas = datas;
+    
+    _queueContext._queue.push(senderTask);
+}
+
 Heartbeater::Heartbeater(): _heartbeatmsg(new SendMessageInfo) {
     _heartbeatmsg->type = CORPC_MSG_TYPE_HEARTBEAT;
     _heartbeatmsg->isRaw = true;
@@ -1070,24 +2059,23 @@ void *Heartbeater::dispatchRoutine( void * arg ) {
     
     HeartbeatQueue& queue = self->_queue;
     
-    // 初始化pipe readfd
-    int readFd = queue.getReadFd();
-    co_register_fd(readFd);
-    co_set_timeout(readFd, -1, 1000);
+    // 注册队列通知fd
+    int notifyFd = queue.getNotifyFd();
+    co_register_fd(notifyFd);
+    co_set_timeout(notifyFd, -1, 1000);
     
     int ret;
-    std::vector<char> buf(1024);
     while (true) {
         // 等待处理信号
-        ret = (int)read(readFd, &buf[0], 1024);
+        ret = queue.wait();
         assert(ret != 0);
         if (ret < 0) {
             if (errno == EAGAIN) {
                 continue;
             } else {
-                // 管道出错
-                ERROR_LOG("Heartbeater::dispatchRoutine read from pipe fd %d ret %d errno %d (%s)\n",
-                       readFd, ret, errno, strerror(errno));
+                // 通知fd出错
+                ERROR_LOG("Heartbeater::dispatchRoutine wait on notify fd %d ret %d errno %d (%s)\n",
+                       notifyFd, ret, errno, strerror(errno));
                 
                 // TODO: 如何处理？退出协程？
                 // sleep 10 milisecond
@@ -1196,16 +2184,16 @@ void Heartbeater::removeConnection(std::shared_ptr<Connection>& connection) {
     _queue.push(task);
 }
 
-IO::IO(uint16_t receiveThreadNum, uint16_t sendThreadNum): _receiveThreadNum(receiveThreadNum), _sendThreadNum(sendThreadNum) {
+IO::IO(uint16_t receiveThreadNum, uint16_t sendThreadNum, bool reactor): _receiveThreadNum(receiveThreadNum), _sendThreadNum(sendThreadNum), _reactor(reactor), _lastThreadIndex(0) {
 }
 
-IO* IO::create(uint16_t receiveThreadNum, uint16_t sendThreadNum) {
+IO* IO::create(uint16_t receiveThreadNum, uint16_t sendThreadNum, bool reactor) {
     if (receiveThreadNum == 0 && sendThreadNum == 0) {
         ERROR_LOG("IO::create() -- sender and receiver can't run at same thread.\n");
         return nullptr;
     }
     
-    IO *io = new IO(receiveThreadNum, sendThreadNum);
+    IO *io = new IO(receiveThreadNum, sendThreadNum, reactor);
     io->start();
     
     return io;
@@ -1244,12 +2232,122 @@ bool IO::start() {
     return true;
 }
 
-void IO::addConnection(std::shared_ptr<Connection>& connection) {
+void IO::addConnection(std::shared_ptr<Connection>& connection, int recvThreadIndex) {
+    placeConnection(connection, recvThreadIndex);
+    
     // 注意：以下两行顺序不能调换，不然会有多线程问题
     _sender->addConnection(connection);
-    _receiver->addConnection(connection);
+    if (recvThreadIndex >= 0) {
+        _receiver->addLocalConnection(connection);
+    } else {
+        _receiver->addConnection(connection);
+    }
 }
 
 void IO::removeConnection(std::shared_ptr<Connection>& connection) {
     _sender->removeConnection(connection);
 }
+
+void IO::placeConnection(std::shared_ptr<Connection>& connection, int recvThreadIndex) {
+    uint16_t recvNum = _receiver->getThreadNum();
+    uint16_t sendNum = _sender->getThreadNum();
+    
+    if (recvThreadIndex >= 0 && recvNum == sendNum) {
+        connection->setRecvThreadIndex(recvThreadIndex);
+        connection->setSendThreadIndex(recvThreadIndex);
+        return;
+    }
+    
+    uint32_t seq = _lastThreadIndex++;
+    
+    std::vector<ThreadLoad> recvLoads;
+    std::vector<ThreadLoad> sendLoads;
+    if (_placementPolicy.mode == PlacementPolicy::LEAST_CONNECTIONS || _placementPolicy.mode == PlacementPolicy::LEAST_BYTES || _placementPolicy.mode == PlacementPolicy::INCOMING_CPU) {
+        _receiver->getThreadLoads(recvLoads);
+        _sender->getThreadLoads(sendLoads);
+    } else {
+        recvLoads.resize(recvNum);
+        sendLoads.resize(sendNum);
+    }
+    
+    if (recvNum == sendNum) {
+        // 收发线程数相同时收发使用同一线程下标，按收发负载之和选择（下标相同的收发线程绑定到同一核上可避免跨核访问连接数据）
+        for (uint16_t i = 0; i < recvNum; i++) {
+            recvLoads[i].connectionNum += sendLoads[i].connectionNum;
+            recvLoads[i].bytesPerSecond += sendLoads[i].bytesPerSecond;
+        }
+        
+        uint16_t index = selectThread(connection, THREAD_ROLE_RECEIVER, recvLoads, seq);
+        connection->setRecvThreadIndex(index);
+        connection->setSendThreadIndex(index);
+    } else {
+        connection->setRecvThreadIndex(recvThreadIndex >= 0 ? recvThreadIndex : selectThread(connection, THREAD_ROLE_RECEIVER, recvLoads, seq));
+        connection->setSendThreadIndex(selectThread(connection, THREAD_ROLE_SENDER, sendLoads, seq));
+    }
+}
+
+uint16_t IO::selectThread(std::shared_ptr<Connection>& connection, ThreadRole role, const std::vector<ThreadLoad>& loads, uint32_t seq) {
+    uint16_t threadNum = (uint16_t)loads.size();
+    if (threadNum == 1) {
+        return 0;
+    }
+    
+    switch (_placementPolicy.mode) {
+        case PlacementPolicy::LEAST_CONNECTIONS:
+        case PlacementPolicy::LEAST_BYTES: {
+            // 从seq对应的线程开始比较，负载相同时仍然轮流分配
+            uint16_t best = seq % threadNum;
+            for (uint16_t i = 1; i < threadNum; i++) {
+                uint16_t index = (seq + i) % threadNum;
+                const ThreadLoad &a = loads[index];
+                const ThreadLoad &b = loads[best];
+                if (_placementPolicy.mode == PlacementPolicy::LEAST_BYTES && a.bytesPerSecond != b.bytesPerSecond) {
+                    if (a.bytesPerSecond < b.bytesPerSecond) {
+                        best = index;
+                    }
+                } else if (a.connectionNum < b.connectionNum) {
+                    best = index;
+                }
+            }
+            
+            return best;
+        }
+        case PlacementPolicy::AFFINITY: {
+            uint64_t key = _placementPolicy.affinity ? _placementPolicy.affinity(connection) : connection->getAffinityKey();
+            return std::hash<uint64_t>()(key) % threadNum;
+        }
+        case PlacementPolicy::INCOMING_CPU: {
+            // 优先选绑定在处理该连接数据包的核（网卡接收队列中断所在的核）上的线程，其次是同一NUMA节点上的线程，同级中选连接数最少的
+            int cpu = -1;
+#ifdef SO_INCOMING_CPU
+            socklen_t len = sizeof(cpu);
+            if (getsockopt(connection->getfd(), SOL_SOCKET, SO_INCOMING_CPU, &cpu, &len) < 0) {
+                cpu = -1;
+            }
+#endif
+            int node = ThreadPlacement::getNode(cpu);
+            
+            uint16_t best = 0;
+            int bestRank = -1;
+            for (uint16_t i = 0; i < threadNum; i++) {
+                uint16_t index = (seq + i) % threadNum;
+                int threadCpu = ThreadPlacement::getCpu(role, index);
+                int rank = 2;
+                if (cpu >= 0 && threadCpu == cpu) {
+                    rank = 0;
+                } else if (node >= 0 && ThreadPlacement::getNode(threadCpu) == node) {
+                    rank = 1;
+                }
+                
+                if (bestRank < 0 || rank < bestRank || (rank == bestRank && loads[index].connectionNum < loads[best].connectionNum)) {
+                    best = index;
+                    bestRank = rank;
+                }
+            }
+            
+            return best;
+        }
+        default:
+            return seq % threadNum;
+    }
+}
@@ -21,6 +21,7 @@
 #include "corpc_define.h"
 #include "corpc_queue.h"
 #include "corpc_timeout_list.h"
+#include "corpc_thread_placement.h"
 #include <functional>
 
 #include <thread>
@@ -43,8 +44,13 @@ namespace corpc {
     // 下流流水线处理流程：
     //   1.编码器链：根据数据类型进行编码，从链头编码器开始，如果当前编码器认识要处理的数据类型则编码并返回，否则交由链中下一个编码器处理，直到有编码器可处理数据为止，若无编码器可处理数据，则报错
     
+    // 解码器参数中的head和body是借用的内存片段：完整消息在本次读取的数据中时直接指向IO线程的读缓冲区，否则指向pipeline的重组缓冲区
+    // 解码器可以原地修改（如解密），但只在调用期间有效，不能保留指针，需要保留的数据必须拷贝
     typedef std::function<void* (std::shared_ptr<Connection>&, uint8_t*, uint8_t*, int)> DecodeFunction;
     typedef std::function<bool (std::shared_ptr<Connection>&, std::shared_ptr<void>&, uint8_t*, int, int&, std::string&, uint32_t&)> EncodeFunction;
+    // 引用编码器：数据体已在某个缓冲区中（如转发、广播的原始消息）时只把头部编码到buf中，数据体通过iovec返回，由sender用writev直接发送
+    // 返回false表示该数据不能引用发送，改由EncodeFunction编码；返回true且size为0表示buf空间不足
+    typedef std::function<bool (std::shared_ptr<Connection>&, std::shared_ptr<void>&, uint8_t*, int, int&, struct iovec&)> EncodeRefFunction;
     
     typedef MPMC_NoLockBlockQueue<void*> WorkerMessageQueue;
     
@@ -56,6 +62,7 @@ namespace corpc {
         virtual void start() = 0;
         
         void addMessage(void *msg);
+        void addMessages(std::vector<void*>& msgs); // 批量提交消息，只通知一次
         
     protected:
         static void *msgHandleRoutine(void * arg);
@@ -74,7 +81,7 @@ namespace corpc {
         virtual void start();
         
     protected:
-        static void threadEntry( Worker *self );
+        static void threadEntry( Worker *self, uint16_t index );
         
         virtual void handleMessage(void *msg) = 0; // 注意：处理完消息需要自己删除msg
         
@@ -102,6 +109,10 @@ namespace corpc {
         virtual bool upflow(uint8_t *buf, int size) = 0;
         virtual bool downflow(uint8_t *buf, int space, int &size) = 0;
         
+        // 分散写版本的downflow：iov中依次记录要发送的片段，片段可以在buf中，也可以引用待发送数据自身的缓冲区，
+        // 被引用的数据放入refs中保持有效直到发送完成。默认实现只产生buf中的一个片段
+        virtual bool downflowv(uint8_t *buf, int space, struct iovec *iov, int maxIov, int &iovcnt, std::vector<std::shared_ptr<void>> &refs);
+        
     protected:
         Worker *_worker;
         
@@ -117,10 +128,14 @@ namespace corpc {
         virtual ~MessagePipeline() = 0;
         
         virtual bool downflow(uint8_t *buf, int space, int &size) override final;
+        virtual bool downflowv(uint8_t *buf, int space, struct iovec *iov, int maxIov, int &iovcnt, std::vector<std::shared_ptr<void>> &refs) override final;
+        
+        void setEncodeRefFunction(EncodeRefFunction encodeRefFun) { _encodeRefFun = encodeRefFun; }
         
     protected:
         DecodeFunction _decodeFun;
         EncodeFunction _encodeFun;
+        EncodeRefFunction _encodeRefFun;
         
         uint _headSize;
         uint _maxBodySize;
@@ -128,10 +143,28 @@ namespace corpc {
         std::string _head;
         uint8_t *_headBuf;
         
-        std::string _body;
+        std::unique_ptr<uint8_t[]> _body; // 按需分配，大小随消息头中声明的_bodySize增长
         uint8_t *_bodyBuf;
+        uint _bodyCapacity;
         uint _bodySize;
         
+        std::vector<void*> _msgBatch; // 本次upflow解码出的消息，upflow结束时一次性提交给worker
+        
+    protected:
+        void flushMessages();
+        
+        // 保证消息体缓冲区至少能容纳size字节（仅在开始接收消息体前调用，不保留原有数据）
+        void reserveBody(uint size);
+        
+        // 没有未接收完的消息体时，释放超过CORPC_PIPELINE_BUFFER_KEEP_SIZE的消息体缓冲区
+        void shrinkBody();
+        
+        // 从消息头的bodySizeOffset处按bodySizeType读取消息体长度（网络字节序）
+        static uint parseBodySize(const uint8_t *head, uint bodySizeOffset, SIZE_TYPE bodySizeType);
+        
+    private:
+        int flushDownflowBuf(uint8_t *buf, int space); // 将_downflowBuf中未发送的数据拷贝到buf，返回拷贝的数据量
+        
     private:
         std::string _downflowBuf; // 在downflow过程中写不进buf的数据将记录到_downflowBuf中
         uint32_t _downflowBufSentNum; // 已发送的数据量
@@ -193,9 +226,13 @@ namespace corpc {
         
         virtual std::shared_ptr<Pipeline> buildPipeline(std::shared_ptr<Connection> &connection);
         
+        void setEncodeRefFunction(EncodeRefFunction encodeRefFun) { _encodeRefFun = encodeRefFun; } // 设置后该工厂创建的pipeline用writev发送可引用的数据
+        
     public:
         uint _bodySizeOffset;
         MessagePipeline::SIZE_TYPE _bodySizeType;
+        
+        EncodeRefFunction _encodeRefFun;
     };
     
     class UdpPipelineFactory: public MessagePipelineFactory {
@@ -206,6 +243,33 @@ namespace corpc {
         virtual std::shared_ptr<Pipeline> buildPipeline(std::shared_ptr<Connection> &connection);
     };
     
+    // 发送刷新策略（按服务器设置）
+    struct FlushPolicy {
+        enum Mode {
+            IMMEDIATE,  // 有数据立即发送
+            COALESCE,   // 积累到coalesceBytes字节或数据等待超过coalesceUs后才发送（计时精度为事件循环的1毫秒）
+            CORK,       // 发送线程处理完当前任务队列后再发送，超过发送缓冲区的数据用TCP_CORK合并成完整报文段
+        };
+        
+        Mode mode = IMMEDIATE;
+        uint32_t coalesceBytes = 0x4000;
+        uint32_t coalesceUs = 1000;
+        bool noDelay = false; // 是否设置TCP_NODELAY（关闭Nagle算法），对每个接受的TCP连接显式设置
+    };
+    
+    // TCP接受连接方式（按服务器设置）
+    struct AcceptPolicy {
+        int backlog = 1024; // 每个侦听socket的全连接队列长度
+        
+        // 为每个IO接收线程各开一个SO_REUSEPORT侦听socket并在该线程中accept，由内核在这些socket之间分配新连接，
+        // 连接留在接受它的接收线程中（不再经过acceptor线程转交）
+        bool reusePort = false;
+        
+        // reusePort时附加SO_ATTACH_REUSEPORT_CBPF程序，把新连接交给绑定在处理其SYN的核上的接收线程
+        // （绑定关系见ThreadPlacement，无接收线程绑定在该核上时按核号取模）
+        bool cpuSteering = false;
+    };
+    
     class Connection: public std::enable_shared_from_this<Connection> {
     public:
         Connection(int fd, IO* io, bool needHB);
@@ -239,6 +303,7 @@ namespace corpc {
         void setDecodeError() { _decodeError = true; }
         
         void send(std::shared_ptr<void> data);
+        void sendBatch(std::vector<std::shared_ptr<void>>& datas); // 多个数据只产生一个发送任务
         
         void close();
         
@@ -247,9 +312,24 @@ namespace corpc {
         void popFrontData() { _datas.pop_front(); }
         
         bool isOpen() const { return !(_isClosing || _closed); }
+        
+        const FlushPolicy &getFlushPolicy() { return _flushPolicy; }
+        void setFlushPolicy(const FlushPolicy &policy) { _flushPolicy = policy; }
+        
+        // PlacementPolicy::AFFINITY策略下未设置亲和函数时使用的亲和键，需在连接加入IO前设置
+        uint64_t getAffinityKey() { return _affinityKey; }
+        void setAffinityKey(uint64_t key) { _affinityKey = key; }
 
     protected:
+        // 待发送数据编码后的大致字节数，COALESCE策略据此判断是否攒够数据，返回0表示未知（只按时间合并）
+        virtual size_t getDataLength(std::shared_ptr<void>& data) { return 0; }
+        
         virtual ssize_t write(const void *buf, size_t nbyte);
+        virtual ssize_t writev(const struct iovec *iov, int iovcnt);
+        
+        // 不挂起协程的写，写不进内核的部分由调用方处理（返回-1且errno为EAGAIN表示当前不可写）
+        virtual ssize_t writeNowait(const void *buf, size_t nbyte);
+        virtual ssize_t writevNowait(const struct iovec *iov, int iovcnt);
         
     protected:
         IO *_io;
@@ -269,7 +349,22 @@ namespace corpc {
         bool _decodeError; // 是否数据解码出错
         std::atomic<bool> _closed; // 是否已关闭
         std::atomic<bool> _isClosing; // 是否正在关闭
-        std::atomic<bool> _canClose; // 是否可调用close（当sender中fd相关协程退出时设置canClose为true，receiver中fd相关协程才可以进行close调用）
+        std::atomic<bool> _canClose; // sender是否已结束发送（结束后通知receiver，由receiver线程关闭fd）
+        uint8_t _closeStage; // receiver线程中记录收发两端已结束的数量，两端都结束时才关闭fd
+        
+        FlushPolicy _flushPolicy;
+        uint64_t _affinityKey;
+        bool _resumePending; // 已在发送线程的延迟唤醒列表中
+        size_t _pendingBytes; // COALESCE策略下上次发送后积累的数据量
+        uint64_t _pendingTime; // COALESCE策略下上次发送后第一条数据到达的时间（毫秒）
+        
+        // reactor模式下发送端的状态（没有连接协程，由任务队列、可写回调和合并定时器驱动发送）
+        bool _reactorSend; // 是否由reactor驱动发送
+        bool _corked; // 是否设置了TCP_CORK
+        bool _coalesceWaiting; // 是否在合并定时器的等待列表中
+        std::vector<struct iovec> _leftIov; // 上次未能写入内核的数据片段，可写时优先发送
+        std::string _leftData; // _leftIov中原位于线程共享缓冲区的数据的拷贝
+        std::vector<std::shared_ptr<void>> _leftRefs; // _leftIov引用的数据体
         
     public:
         friend class Receiver;
@@ -285,7 +380,17 @@ namespace corpc {
         Server(IO *io): _io(io), _acceptor(nullptr), _worker(nullptr), _pipelineFactory(nullptr) {}
         virtual ~Server() = 0;
         
-        std::shared_ptr<Connection> buildAndAddConnection(int fd);
+        std::shared_ptr<Connection> buildAndAddConnection(int fd, int recvThreadIndex = -1); // recvThreadIndex见IO::addConnection
+        
+        IO *getIO() { return _io; }
+        
+        // 需在start之前设置，之后建立的连接使用该策略
+        void setFlushPolicy(const FlushPolicy &policy) { _flushPolicy = policy; }
+        const FlushPolicy &getFlushPolicy() { return _flushPolicy; }
+        
+        // 需在start之前设置
+        void setAcceptPolicy(const AcceptPolicy &policy) { _acceptPolicy = policy; }
+        const AcceptPolicy &getAcceptPolicy() { return _acceptPolicy; }
         
     protected:
         virtual bool start();
@@ -300,6 +405,9 @@ namespace corpc {
         Worker *_worker;
         
         PipelineFactory *_pipelineFactory;
+        
+        FlushPolicy _flushPolicy;
+        AcceptPolicy _acceptPolicy;
     };
     
     class Acceptor {
@@ -321,6 +429,13 @@ namespace corpc {
     };
     
     class TcpAcceptor: public Acceptor {
+        // 一个侦听socket及其accept协程
+        struct ListenContext {
+            TcpAcceptor *acceptor;
+            int listenFd;
+            int recvThreadIndex; // reusePort模式下accept协程所在的接收线程，否则为-1
+        };
+        
     public:
         TcpAcceptor(Server *server, const std::string& ip, uint16_t port): Acceptor(server, ip, port) {}
         virtual ~TcpAcceptor() {}
@@ -328,8 +443,13 @@ namespace corpc {
         virtual bool start();
         
     private:
+        int createListenSocket(bool reusePort);
+        bool attachCpuSteering(int listenFd, uint16_t threadNum);
+        
         static void *acceptRoutine( void * arg );
         
+    private:
+        std::vector<ListenContext> _listens;
     };
 
     class SockAddrCmp: public std::less<sockaddr_in> {
@@ -382,14 +502,21 @@ namespace corpc {
     };
     
     struct SenderTask {
-        enum TaskType {INIT, CLOSE, DATA};
+        enum TaskType {INIT, CLOSE, DATA, DATAS, MULTICAST};
         std::shared_ptr<Connection> connection;
         TaskType type;
         std::shared_ptr<void> data;
+        std::vector<std::shared_ptr<void>> datas; // DATAS类型的批量数据，MULTICAST类型中与connections一一对应的数据
+        std::vector<std::shared_ptr<Connection>> connections; // MULTICAST类型的目标连接（同一发送线程）
     };
     
     struct ReceiverTask {
+        enum TaskType {INIT, SENDER_CLOSED, START_ROUTINE};
+        TaskType type = INIT;
         std::shared_ptr<Connection> connection;
+        bool stream = true; // reactor模式下是否为流式socket（短读说明内核中已无数据）
+        pfn_co_routine_t routine = nullptr; // START_ROUTINE任务要在接收线程中启动的协程
+        void *arg = nullptr;
     };
 
     struct HeartbeatTask {
@@ -398,7 +525,11 @@ namespace corpc {
         std::shared_ptr<Connection> connection;
     };
     
-#ifdef USE_NO_LOCK_QUEUE
+#if defined(USE_SEGMENT_QUEUE)
+    typedef Co_MPSC_SegmentQueue<ReceiverTask*> ReceiverTaskQueue; // 用于从Acceptor向Receiver传递建立的连接fd
+    typedef Co_MPSC_SegmentQueue<SenderTask*> SenderTaskQueue; // 用于向Sender发送任务
+    typedef Co_MPSC_SegmentQueue<HeartbeatTask*> HeartbeatQueue; // 用于向Heartbeater发送需要心跳的连接
+#elif defined(USE_NO_LOCK_QUEUE)
     typedef Co_MPSC_NoLockQueue<ReceiverTask*> ReceiverTaskQueue; // 用于从Acceptor向Receiver传递建立的连接fd
     typedef Co_MPSC_NoLockQueue<SenderTask*> SenderTaskQueue; // 用于向Sender发送任务
     typedef Co_MPSC_NoLockQueue<HeartbeatTask*> HeartbeatQueue; // 用于向Heartbeater发送需要心跳的连接
@@ -408,6 +539,56 @@ namespace corpc {
     typedef CoSyncQueue<HeartbeatTask*> HeartbeatQueue; // 用于向Heartbeater发送需要心跳的连接
 #endif
     
+    // IO线程负载（由getThreadLoads返回的快照）
+    struct ThreadLoad {
+        uint32_t connectionNum;  // 分配到该线程的连接数
+        uint64_t bytes;          // 累计收（或发）字节数
+        uint64_t bytesPerSecond; // 最近一个统计周期（约1秒）的每秒字节数
+    };
+    
+    // IO线程负载计数，收发线程中更新，分配连接和查询负载时读取
+    // 速率由所在IO线程中的采样协程每个采样周期更新一次，查询时直接返回最近一次采样结果
+    class ThreadLoadCounter {
+    public:
+        static const int SAMPLE_INTERVAL = 1000; // 速率采样周期（毫秒）
+        
+        ThreadLoadCounter(): _connectionNum(0), _bytes(0), _bytesPerSecond(0), _sampleBytes(0), _sampleTime(0) {}
+        
+        void addConnection() { _connectionNum.fetch_add(1, std::memory_order_relaxed); }
+        void removeConnection() { _connectionNum.fetch_sub(1, std::memory_order_relaxed); }
+        void addBytes(size_t bytes) { _bytes.fetch_add(bytes, std::memory_order_relaxed); }
+        
+        void sample(uint64_t nowms); // 只在计数所属的IO线程中调用
+        void getLoad(ThreadLoad &load); // 可在任意线程调用
+        
+        static void *sampleRoutine( void *arg ); // 在IO线程中定时采样的协程，arg为ThreadLoadCounter*
+        
+    private:
+        std::atomic<uint32_t> _connectionNum;
+        std::atomic<uint64_t> _bytes;
+        std::atomic<uint64_t> _bytesPerSecond;
+        
+        uint64_t _sampleBytes;
+        uint64_t _sampleTime;
+    };
+    
+    // 连接分配到IO线程的策略（按IO设置）
+    struct PlacementPolicy {
+        enum Mode {
+            ROUND_ROBIN,        // 轮流分配
+            LEAST_CONNECTIONS,  // 分配到连接数最少的线程
+            LEAST_BYTES,        // 分配到最近每秒收发字节数最少的线程（相同时选连接数少的）
+            AFFINITY,           // 按亲和键分配，亲和键相同的连接分配到同一线程
+            INCOMING_CPU,       // 按处理连接数据包的核（SO_INCOMING_CPU）分配到绑定在该核或同一NUMA节点上的线程（见ThreadPlacement），
+                                // 把网卡各接收队列的中断绑定到接收线程所在的核上即可实现接收队列到IO线程的映射
+        };
+        
+        typedef std::function<uint64_t (std::shared_ptr<Connection>&)> AffinityFunction;
+        
+        Mode mode = ROUND_ROBIN;
+        AffinityFunction affinity; // AFFINITY模式下返回连接的亲和键，未设置时使用Connection::getAffinityKey()
+    };
+    
     // Receiver负责rpc连接的数据接受
     class Receiver {
     protected:
@@ -419,20 +600,39 @@ namespace corpc {
         };
         
     public:
-        Receiver(IO *io):_io(io) {}
+        Receiver(IO *io, uint16_t threadNum):_io(io), _loads(threadNum) {}
         virtual ~Receiver() = 0;
         
         virtual bool start() = 0;
         
-        virtual void addConnection(std::shared_ptr<Connection>& connection) = 0;
+        virtual void addConnection(std::shared_ptr<Connection>& connection) = 0; // 连接的接收线程下标已由IO按分配策略设置
+        virtual void notifySenderClosed(std::shared_ptr<Connection>& connection) = 0; // sender结束发送后调用，由连接所在的接收线程完成关闭
+        virtual void startRoutine(uint16_t threadIndex, pfn_co_routine_t routine, void *arg) = 0; // 在指定的接收线程中启动协程
+        
+        // 调用方已运行在连接的接收线程中时（如在接收线程中accept），直接开始接收，不经过任务队列
+        void addLocalConnection(std::shared_ptr<Connection>& connection);
+        
+        uint16_t getThreadNum() { return (uint16_t)_loads.size(); }
+        void getThreadLoads(std::vector<ThreadLoad>& loads); // 各接收线程的负载，bytes为接收字节数
         
     protected:
         static void *connectionDispatchRoutine( void * arg );
         
         static void *connectionRoutine( void * arg );
         
+    private:
+        static void startReceive(ReceiverTask *recvTask);
+        
+        // reactor模式：可读回调中读取并upflow，断线后在协程中关闭
+        static void onReadable( int fd, short revents, void *arg );
+        static void *closeRoutine( void * arg );
+        static void closeConnection(std::shared_ptr<Connection>& connection);
+        static void finishClose(std::shared_ptr<Connection>& connection);
+        
     protected:
         IO *_io;
+        
+        std::vector<ThreadLoadCounter> _loads;
     };
     
     class MultiThreadReceiver: public Receiver {
@@ -440,35 +640,39 @@ namespace corpc {
         struct ThreadData {
             QueueContext _queueContext;
             
+            uint16_t _index; // 线程下标
+            
             // 保持thread对象
             std::thread _t;
         };
         
     public:
-        MultiThreadReceiver(IO *io, uint16_t threadNum): Receiver(io), _threadNum(threadNum), _lastThreadIndex(0), _threadDatas(threadNum) {}
+        MultiThreadReceiver(IO *io, uint16_t threadNum): Receiver(io, threadNum), _threadDatas(threadNum) {}
         virtual ~MultiThreadReceiver() {}
         
         virtual bool start();
         
         virtual void addConnection(std::shared_ptr<Connection>& connection);
+        virtual void notifySenderClosed(std::shared_ptr<Connection>& connection);
+        virtual void startRoutine(uint16_t threadIndex, pfn_co_routine_t routine, void *arg);
         
     protected:
         static void threadEntry( ThreadData *tdata );
         
     private:
-        uint16_t _threadNum;
-        std::atomic<uint16_t> _lastThreadIndex;
         std::vector<ThreadData> _threadDatas;
     };
     
     class CoroutineReceiver: public Receiver {
     public:
-        CoroutineReceiver(IO *io): Receiver(io) { _queueContext._receiver = this; }
+        CoroutineReceiver(IO *io): Receiver(io, 1) { _queueContext._receiver = this; }
         virtual ~CoroutineReceiver() {}
         
         virtual bool start();
         
         virtual void addConnection(std::shared_ptr<Connection>& connection);
+        virtual void notifySenderClosed(std::shared_ptr<Connection>& connection);
+        virtual void startRoutine(uint16_t threadIndex, pfn_co_routine_t routine, void *arg);
         
     private:
         QueueContext _queueContext;
@@ -485,20 +689,46 @@ namespace corpc {
         };
         
     public:
-        Sender(IO *io):_io(io) {}
+        Sender(IO *io, uint16_t threadNum):_io(io), _sentMessageNum(0), _writeNum(0), _loads(threadNum) {}
         virtual ~Sender() = 0;
         
         virtual bool start() = 0;
         
-        virtual void addConnection(std::shared_ptr<Connection>& connection) = 0;
+        virtual void addConnection(std::shared_ptr<Connection>& connection) = 0; // 连接的发送线程下标已由IO按分配策略设置
         virtual void removeConnection(std::shared_ptr<Connection>& connection) = 0;
         virtual void send(std::shared_ptr<Connection>& connection, std::shared_ptr<void> data) = 0;
+        virtual void sendBatch(std::shared_ptr<Connection>& connection, std::vector<std::shared_ptr<void>>& datas) = 0; // 注意：datas中的数据会被移走
+        virtual void multicast(std::vector<std::shared_ptr<Connection>>& connections, std::vector<std::shared_ptr<void>>& datas) = 0; // datas[i]发给connections[i]，每个发送线程只产生一个发送任务
+        
+        // 统计：已发送的消息数和发送时的写系统调用次数，二者之比即每条消息的系统调用数
+        uint64_t getSentMessageNum() { return _sentMessageNum.load(std::memory_order_relaxed); }
+        uint64_t getWriteNum() { return _writeNum.load(std::memory_order_relaxed); }
+        
+        uint16_t getThreadNum() { return (uint16_t)_loads.size(); }
+        void getThreadLoads(std::vector<ThreadLoad>& loads); // 各发送线程的负载，bytes为发送字节数
     protected:
         static void *taskQueueRoutine( void * arg );
         static void *connectionRoutine( void * arg );
         
+    private:
+        static void pushData(std::shared_ptr<Connection>& connection, std::shared_ptr<void>& data);
+        static void wakeConnection(std::shared_ptr<Connection>& connection, std::vector<std::shared_ptr<Connection>>& deferred);
+        static void resumeConnection(Connection *connection); // 唤醒连接协程，reactor模式下直接发送
+        
+        // reactor模式：发送逻辑与connectionRoutine相同，但写不进内核时把剩余数据存到连接中等待可写回调，不挂起
+        static void onWritable( int fd, short revents, void *arg );
+        static void *coalesceTimerRoutine( void * arg );
+        static void reactorFlush(Connection *connection);
+        static bool reactorWrite(Connection *connection); // 返回false表示连接出错或已关闭且数据发完
+        
     private:
         IO *_io;
+        
+        std::atomic<uint64_t> _sentMessageNum;
+        std::atomic<uint64_t> _writeNum;
+        
+    protected:
+        std::vector<ThreadLoadCounter> _loads;
     };
     
     class MultiThreadSender: public Sender {
@@ -506,12 +736,14 @@ namespace corpc {
         struct ThreadData {
             QueueContext _queueContext;
             
+            uint16_t _index; // 线程下标
+            
             // 保持thread对象
             std::thread _t;
         };
         
     public:
-        MultiThreadSender(IO *io, uint16_t threadNum): Sender(io), _threadNum(threadNum), _lastThreadIndex(0), _threadDatas(threadNum) {}
+        MultiThreadSender(IO *io, uint16_t threadNum): Sender(io, threadNum), _threadNum(threadNum), _threadDatas(threadNum) {}
         virtual ~MultiThreadSender() {}
         
         virtual bool start();
@@ -519,18 +751,19 @@ namespace corpc {
         virtual void addConnection(std::shared_ptr<Connection>& connection);
         virtual void removeConnection(std::shared_ptr<Connection>& connection);
         virtual void send(std::shared_ptr<Connection>& connection, std::shared_ptr<void> data);
+        virtual void sendBatch(std::shared_ptr<Connection>& connection, std::vector<std::shared_ptr<void>>& datas);
+        virtual void multicast(std::vector<std::shared_ptr<Connection>>& connections, std::vector<std::shared_ptr<void>>& datas);
     private:
         static void threadEntry( ThreadData *tdata );
         
     private:
         uint16_t _threadNum;
-        std::atomic<uint16_t> _lastThreadIndex;
         std::vector<ThreadData> _threadDatas;
     };
     
     class CoroutineSender: public Sender {
     public:
-        CoroutineSender(IO *io): Sender(io) { _queueContext._sender = this; }
+        CoroutineSender(IO *io): Sender(io, 1) { _queueContext._sender = this; }
         virtual ~CoroutineSender() {}
         
         virtual bool start();
@@ -538,6 +771,8 @@ namespace corpc {
         virtual void addConnection(std::shared_ptr<Connection>& connection);
         virtual void removeConnection(std::shared_ptr<Connection>& connection);
         virtual void send(std::shared_ptr<Connection>& connection, std::shared_ptr<void> data);
+        virtual void sendBatch(std::shared_ptr<Connection>& connection, std::vector<std::shared_ptr<void>>& datas);
+        virtual void multicast(std::vector<std::shared_ptr<Connection>>& connections, std::vector<std::shared_ptr<void>>& datas);
     private:
         QueueContext _queueContext;
     };
@@ -580,7 +815,9 @@ namespace corpc {
     
     class IO {
     public:
-        static IO* create(uint16_t receiveThreadNum, uint16_t sendThreadNum);
+        // reactor为true时连接的收发由IO线程事件循环中的fd回调直接驱动，不再为每个连接创建收发协程（消息处理仍在协程中），
+        // 要求pipeline的编解码过程不挂起协程
+        static IO* create(uint16_t receiveThreadNum, uint16_t sendThreadNum, bool reactor = false);
         
         bool start();
         
@@ -589,17 +826,32 @@ namespace corpc {
         Receiver *getReceiver() { return _receiver; }
         Sender *getSender() { return _sender; }
         
-        void addConnection(std::shared_ptr<Connection>& connection);
+        bool isReactor() { return _reactor; }
+        
+        // 需在添加连接前设置
+        void setPlacementPolicy(const PlacementPolicy &policy) { _placementPolicy = policy; }
+        const PlacementPolicy &getPlacementPolicy() { return _placementPolicy; }
+        
+        // recvThreadIndex>=0时调用方运行在该接收线程中，连接固定分配到该接收线程并直接开始接收
+        void addConnection(std::shared_ptr<Connection>& connection, int recvThreadIndex = -1);
         void removeConnection(std::shared_ptr<Connection>& connection);
         
     private:
         // 注意：sendThreadNum和receiveThreadNum不能同为0，因为同一线程中一个fd不能同时在两个协程中进行处理，会触发EEXIST错误
-        IO(uint16_t receiveThreadNum, uint16_t sendThreadNum);
+        IO(uint16_t receiveThreadNum, uint16_t sendThreadNum, bool reactor);
         ~IO() {}  // 不允许在栈上创建IO
         
+        // 按分配策略为连接选择收发线程
+        void placeConnection(std::shared_ptr<Connection>& connection, int recvThreadIndex);
+        uint16_t selectThread(std::shared_ptr<Connection>& connection, ThreadRole role, const std::vector<ThreadLoad>& loads, uint32_t seq);
+        
     private:
         uint16_t _receiveThreadNum;
         uint16_t _sendThreadNum;
+        bool _reactor;
+        
+        PlacementPolicy _placementPolicy;
+        std::atomic<uint32_t> _lastThreadIndex; // ROUND_ROBIN策略的分配序号
         
         Receiver *_receiver;
         Sender *_sender;
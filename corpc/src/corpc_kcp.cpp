@@ -55,6 +55,20 @@ ssize_t KcpMessageServer::Connection::write(const void *buf, size_t nbyte) {
     return nbyte;
 }
 
+ssize_t KcpMessageServer::Connection::writev(const struct iovec *iov, int iovcnt) {
+    ssize_t total = 0;
+    for (int i = 0; i < iovcnt; i++) {
+        ssize_t ret = write(iov[i].iov_base, iov[i].iov_len);
+        if (ret < 0) {
+            return ret;
+        }
+        
+        total += ret;
+    }
+    
+    return total;
+}
+
 void KcpMessageServer::Connection::onSenderInit() {
     RoutineEnvironment::startCoroutine(updateRoutine, this);
 }
@@ -176,6 +190,36 @@ bool KcpPipeline::upflow(uint8_t *buf, int size) {
         int dataSize = ret;
         int offset = 0;
         while (dataSize > offset) {
+            // 没有待重组的消息且本次数据中包含完整消息时，直接在_dataBuf上解码，不再拷贝
+            if (_headNum == 0 && dataSize - offset >= (int)_headSize) {
+                uint8_t *head = _dataBuf + offset;
+                uint bodySize = parseBodySize(head, _bodySizeOffset, _bodySizeType);
+                
+                if (bodySize > _maxBodySize) { // 数据超长
+                    ERROR_LOG("KcpPipeline::upflow -- request too large in thread\n");
+                    
+                    flushMessages();
+                    return false;
+                }
+                
+                if (dataSize - offset - _headSize >= bodySize) {
+                    void *msg = _decodeFun(connection, head, head + _headSize, bodySize);
+                    
+                    if (connection->isDecodeError()) {
+                        flushMessages();
+                        return false;
+                    }
+                    
+                    if (msg) {
+                        _msgBatch.push_back(msg);
+                    }
+                    
+                    offset += _headSize + bodySize;
+                    continue;
+                }
+            }
+            
+            // 不完整的消息拷贝到重组缓冲区中
             // 先解析头部
             if (_headNum < _headSize) {
                 int needNum = _headSize - _headNum;
@@ -194,20 +238,16 @@ bool KcpPipeline::upflow(uint8_t *buf, int size) {
             
             if (!_bodySize) {
                 // 解析消息长度值
-                if (_bodySizeType == TWO_BYTES) {
-                    uint16_t x = *(uint16_t*)(_headBuf + _bodySizeOffset);
-                    _bodySize = be16toh(x);
-                } else {
-                    assert(_bodySizeType == FOUR_BYTES);
-                    uint32_t x = *(uint32_t*)(_headBuf + _bodySizeOffset);
-                    _bodySize = be32toh(x);
-                }
+                _bodySize = parseBodySize(_headBuf, _bodySizeOffset, _bodySizeType);
                 
                 if (_bodySize > _maxBodySize) { // 数据超长
                     ERROR_LOG("KcpPipeline::upflow -- request too large in thread\n");
                     
+                    flushMessages();
                     return false;
                 }
+                
+                reserveBody(_bodySize);
             }
             
             // 从缓存中解析数据
@@ -229,11 +269,12 @@ bool KcpPipeline::upflow(uint8_t *buf, int size) {
             void *msg = _decodeFun(connection, _headBuf, _bodyBuf, _bodySize);
             
             if (connection->isDecodeError()) {
+                flushMessages();
                 return false;
             }
             
             if (msg) {
-                _worker->addMessage(msg);
+                _msgBatch.push_back(msg);
             }
             
             // 处理完一个请求消息，复位状态
@@ -245,6 +286,11 @@ bool KcpPipeline::upflow(uint8_t *buf, int size) {
 
     kcpCon->kcpFlush();
     
+    // 本次收到的所有消息只通知worker一次
+    flushMessages();
+    
+    shrinkBody();
+    
     return true;
 }
 
@@ -40,6 +40,9 @@ namespace corpc {
 
         protected:
             virtual ssize_t write(const void *buf, size_t nbyte);
+            virtual ssize_t writev(const struct iovec *iov, int iovcnt);
+            virtual ssize_t writeNowait(const void *buf, size_t nbyte) { return write(buf, nbyte); } // kcpSend只写入kcp发送队列，不会阻塞
+            virtual ssize_t writevNowait(const struct iovec *iov, int iovcnt) { return writev(iov, iovcnt); }
 
         private:
             static void *updateRoutine( void * arg );
@@ -1294,24 +1294,24 @@ void *KcpClient::sendRoutine(void *arg) {
 
     auto& queue = self->_sendQueue;
     
-    // 初始化pipe readfd
-    int readFd = queue.getReadFd();
-    co_register_fd(readFd);
-    co_set_timeout(readFd, -1, 1000);
+    // 注册队列通知fd
+    int notifyFd = queue.getNotifyFd();
+    co_register_fd(notifyFd);
+    co_set_timeout(notifyFd, -1, 1000);
     
     int ret;
     while (self->_running) {
 //DEBUG_LOG("KcpClient::sendRoutine 1\n");
         // 等待处理信号
-        ret = (int)read(readFd, buf, 1024);
+        ret = queue.wait();
         assert(ret != 0);
         if (ret < 0) {
             if (errno == EAGAIN) {
                 continue;
             } else {
-                // 管道出错
-                ERROR_LOG("KcpClient::sendRoutine read from pipe fd %d ret %d errno %d (%s)\n",
-                       readFd, ret, errno, strerror(errno));
+                // 通知fd出错
+                ERROR_LOG("KcpClient::sendRoutine wait on notify fd %d ret %d errno %d (%s)\n",
+                       notifyFd, ret, errno, strerror(errno));
                 
                 // TODO: 如何处理？退出协程？
                 // sleep 10 milisecond
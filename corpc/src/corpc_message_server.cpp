@@ -79,6 +79,90 @@ void MessageServer::Connection::resend() {
     }
 }
 
+size_t MessageServer::Connection::getDataLength(std::shared_ptr<void>& data) {
+    std::shared_ptr<SendMessageInfo> msgInfo = std::static_pointer_cast<SendMessageInfo>(data);
+    if (!msgInfo->msg) {
+        return CORPC_MESSAGE_HEAD_SIZE;
+    }
+    
+    if (msgInfo->isRaw) {
+        return CORPC_MESSAGE_HEAD_SIZE + std::static_pointer_cast<std::string>(msgInfo->msg)->size();
+    }
+    
+    std::shared_ptr<google::protobuf::Message> msg = std::static_pointer_cast<google::protobuf::Message>(msgInfo->msg);
+    size_t msgSize = msg->GetCachedSize();
+    if (msgSize == 0) {
+        msgSize = msg->ByteSizeLong();
+    }
+    
+    return CORPC_MESSAGE_HEAD_SIZE + msgSize;
+}
+
+void MessageServer::ConnectionGroup::broadcast(int16_t type, bool needCrypt, bool needBuffer, uint16_t tag, std::shared_ptr<google::protobuf::Message> msg) {
+    if (_connections.empty()) {
+        return;
+    }
+    
+    // 只序列化一次，之后按原始消息广播
+    std::shared_ptr<std::string> raw(new std::string);
+    if (msg) {
+        msg->SerializeToString(raw.get());
+    }
+    
+    broadcastRaw(type, needCrypt, needBuffer, tag, raw);
+}
+
+void MessageServer::ConnectionGroup::broadcastRaw(int16_t type, bool needCrypt, bool needBuffer, uint16_t tag, std::shared_ptr<std::string> msg) {
+    if (_connections.empty()) {
+        return;
+    }
+    
+    std::shared_ptr<corpc::SendMessageInfo> sendInfo(new corpc::SendMessageInfo);
+    sendInfo->type = type;
+    sendInfo->isRaw = true;
+    sendInfo->needCrypt = needCrypt;
+    sendInfo->tag = tag;
+    sendInfo->serial = 0;
+    sendInfo->msg = msg;
+    
+    if (!needCrypt && _server->_enableSendCRC && msg) {
+        sendInfo->crc = CRC::CheckSum((uint8_t *)msg->data(), 0xFFFF, msg->size());
+        sendInfo->crcReady = true;
+    }
+    
+    bool buffered = needBuffer && _server->_enableSerial;
+    
+    std::vector<std::shared_ptr<corpc::Connection>> connections;
+    std::vector<std::shared_ptr<void>> datas;
+    connections.reserve(_connections.size());
+    datas.reserve(_connections.size());
+    for (auto& kv : _connections) {
+        std::shared_ptr<Connection> &conn = kv.second;
+        if (buffered) {
+            // 需缓存的消息带有各连接自己的序号，只能共享消息体
+            if (!conn->isOpen() && !conn->_msgBuffer->needBuf()) {
+                continue;
+            }
+            
+            std::shared_ptr<corpc::SendMessageInfo> connInfo(new corpc::SendMessageInfo(*sendInfo));
+            assert(conn->_msgBuffer);
+            conn->_msgBuffer->insertMessage(connInfo);
+            
+            if (conn->isOpen()) {
+                connections.push_back(conn);
+                datas.push_back(connInfo);
+            }
+        } else if (conn->isOpen()) {
+            connections.push_back(conn);
+            datas.push_back(sendInfo);
+        }
+    }
+    
+    if (!connections.empty()) {
+        _server->_io->getSender()->multicast(connections, datas);
+    }
+}
+
 void * MessageServer::Worker::taskCallRoutine( void * arg ) {
     WorkerTask *task = (WorkerTask *)arg;
     
@@ -190,6 +274,8 @@ bool MessageServer::setBanMessages(std::list<int> &msgTypes) {
             }
         }
     }
+
+    return true;
 }
 
 //bool MessageServer::banMessage(int type) {
@@ -367,6 +453,18 @@ void* MessageServer::decode(std::shared_ptr<corpc::Connection> &connection, uint
     
 }
 
+static inline void encodeHead(uint8_t *buf, uint32_t msgSize, SendMessageInfo *msgInfo, bool needCrypt, uint16_t crc) {
+    *(uint32_t *)buf = htobe32(msgSize);
+    *(uint16_t *)(buf + 4) = htobe16(msgInfo->type);
+    
+    // 头部设置加密标志
+    *(uint16_t *)(buf + 6) = htobe16(msgInfo->tag);
+    uint16_t flag = needCrypt?CORPC_MESSAGE_FLAG_CRYPT:0;
+    *(uint16_t *)(buf + 8) = htobe16(flag);
+    *(uint32_t *)(buf + 14) = htobe32(msgInfo->serial);
+    *(uint16_t *)(buf + 18) = htobe16(crc);
+}
+
 bool MessageServer::encode(std::shared_ptr<corpc::Connection> &connection, std::shared_ptr<void>& data, uint8_t *buf, int space, int &size, std::string &downflowBuf, uint32_t &downflowBufSentNum) {
     std::shared_ptr<SendMessageInfo> msgInfo = std::static_pointer_cast<SendMessageInfo>(data);
     std::shared_ptr<Connection> conn = std::static_pointer_cast<Connection>(connection);
@@ -401,7 +499,7 @@ bool MessageServer::encode(std::shared_ptr<corpc::Connection> &connection, std::
                 }
 
                 if (needCRC) {
-                    crc = CRC::CheckSum(buf + CORPC_MESSAGE_HEAD_SIZE, 0xFFFF, msgSize);
+                    crc = msgInfo->crcReady ? msgInfo->crc : CRC::CheckSum(buf + CORPC_MESSAGE_HEAD_SIZE, 0xFFFF, msgSize);
                 }
             }
             
@@ -415,7 +513,7 @@ bool MessageServer::encode(std::shared_ptr<corpc::Connection> &connection, std::
             }
 
             if (needCRC) {
-                crc = CRC::CheckSum(dbuf, 0xFFFF, msgSize);
+                crc = msgInfo->crcReady ? msgInfo->crc : CRC::CheckSum(dbuf, 0xFFFF, msgSize);
             }
 
             if (spaceleft > 0) {
@@ -474,23 +572,53 @@ bool MessageServer::encode(std::shared_ptr<corpc::Connection> &connection, std::
         }
     }
     
-    *(uint32_t *)buf = htobe32(msgSize);
-    *(uint16_t *)(buf + 4) = htobe16(msgInfo->type);
-    
-    // 头部设置加密标志
-    *(uint16_t *)(buf + 6) = htobe16(msgInfo->tag);
-    uint16_t flag = needCrypt?CORPC_MESSAGE_FLAG_CRYPT:0;
-    *(uint16_t *)(buf + 8) = htobe16(flag);
-    *(uint32_t *)(buf + 14) = htobe32(msgInfo->serial);
-    *(uint16_t *)(buf + 18) = htobe16(crc);
+    encodeHead(buf, msgSize, msgInfo.get(), needCrypt, crc);
+
+    return true;
+}
 
+bool MessageServer::encodeRef(std::shared_ptr<corpc::Connection> &connection, std::shared_ptr<void>& data, uint8_t *buf, int space, int &size, struct iovec &payload) {
+    std::shared_ptr<SendMessageInfo> msgInfo = std::static_pointer_cast<SendMessageInfo>(data);
+    
+    // 加密会修改消息体，而原始消息可能被多个连接共享（如广播），因此加密消息不能引用发送；小消息直接拷贝更划算
+    if (!msgInfo->isRaw || msgInfo->needCrypt) {
+        return false;
+    }
+    
+    std::shared_ptr<std::string> msg = std::static_pointer_cast<std::string>(msgInfo->msg);
+    if (!msg || msg->size() < CORPC_MIN_REF_PAYLOAD_SIZE) {
+        return false;
+    }
+    
+    // 若空间不足容纳消息头部则等待下次
+    if (CORPC_MESSAGE_HEAD_SIZE > space) {
+        size = 0;
+        return true;
+    }
+    
+    std::shared_ptr<Connection> conn = std::static_pointer_cast<Connection>(connection);
+    
+    uint32_t msgSize = msg->size();
+    uint16_t crc = 0;
+    if (conn->_server->_enableSendCRC) {
+        crc = msgInfo->crcReady ? msgInfo->crc : CRC::CheckSum((uint8_t *)msg->data(), 0xFFFF, msgSize);
+    }
+    
+    encodeHead(buf, msgSize, msgInfo.get(), false, crc);
+    
+    size = CORPC_MESSAGE_HEAD_SIZE;
+    payload.iov_base = (void *)msg->data();
+    payload.iov_len = msgSize;
+    
     return true;
 }
 
 TcpMessageServer::TcpMessageServer(corpc::IO *io, bool needHB, bool enableSendCRC, bool enableRecvCRC, bool enableSerial, const std::string& ip, uint16_t port): MessageServer(io, needHB, enableSendCRC, enableRecvCRC, enableSerial) {
     _acceptor = new TcpAcceptor(this, ip, port);
     
-    _pipelineFactory = new TcpPipelineFactory(_worker, decode, encode, CORPC_MESSAGE_HEAD_SIZE, CORPC_MAX_MESSAGE_SIZE, 0, corpc::MessagePipeline::FOUR_BYTES);
+    TcpPipelineFactory *pipelineFactory = new TcpPipelineFactory(_worker, decode, encode, CORPC_MESSAGE_HEAD_SIZE, CORPC_MAX_MESSAGE_SIZE, 0, corpc::MessagePipeline::FOUR_BYTES);
+    pipelineFactory->setEncodeRefFunction(encodeRef);
+    _pipelineFactory = pipelineFactory;
 }
 
 UdpMessageServer::UdpMessageServer(corpc::IO *io, bool needHB, bool enableSendCRC, bool enableRecvCRC, bool enableSerial, const std::string& ip, uint16_t port): MessageServer(io, needHB, enableSendCRC, enableRecvCRC, enableSerial) {
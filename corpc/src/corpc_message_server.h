@@ -46,6 +46,8 @@ namespace corpc {
             // 注意：此send方法使用了消息缓存，非线程安全
             void send(int16_t type, bool isRaw, bool needCrypt, bool needBuffer, uint16_t tag, std::shared_ptr<void> msg);
             void resend(); // 重发消息缓存中所有消息
+        protected:
+            virtual size_t getDataLength(std::shared_ptr<void>& data);
         private:
             MessageServer *_server;
             std::shared_ptr<Crypter> _crypter;
@@ -57,6 +59,25 @@ namespace corpc {
             friend class MessageServer::Worker;
         };
         
+        // 连接组（如房间）：广播的消息只序列化一次，不加密时CRC也只计算一次，按发送线程分组后每个线程只推送一个发送任务
+        // 注意：与Connection::send一样非线程安全（在worker中使用），断开的连接需由使用者调用remove移除
+        class ConnectionGroup {
+        public:
+            ConnectionGroup(MessageServer *server): _server(server) {}
+            
+            void add(std::shared_ptr<Connection> &conn) { _connections[conn.get()] = conn; }
+            void remove(std::shared_ptr<Connection> &conn) { _connections.erase(conn.get()); }
+            void clear() { _connections.clear(); }
+            size_t size() const { return _connections.size(); }
+            
+            void broadcast(int16_t type, bool needCrypt, bool needBuffer, uint16_t tag, std::shared_ptr<google::protobuf::Message> msg);
+            void broadcastRaw(int16_t type, bool needCrypt, bool needBuffer, uint16_t tag, std::shared_ptr<std::string> msg);
+            
+        private:
+            MessageServer *_server;
+            std::map<Connection*, std::shared_ptr<Connection>> _connections;
+        };
+        
     private:
         typedef std::function<void(int16_t type, uint16_t tag, std::shared_ptr<google::protobuf::Message>, std::shared_ptr<Connection>)> MessageHandle;
         typedef std::function<void(int16_t type, uint16_t tag, std::shared_ptr<std::string>, std::shared_ptr<Connection>)> OtherMessageHandle;
@@ -112,6 +133,9 @@ namespace corpc {
         
         static bool encode(std::shared_ptr<corpc::Connection> &connection, std::shared_ptr<void>& data, uint8_t *buf, int space, int &size, std::string &downflowBuf, uint32_t &downflowBufSentNum);
         
+        // 不加密的原始消息只编码头部，消息体直接引用原数据用writev发送（转发、广播时不拷贝消息体）
+        static bool encodeRef(std::shared_ptr<corpc::Connection> &connection, std::shared_ptr<void>& data, uint8_t *buf, int space, int &size, struct iovec &payload);
+        
         virtual bool start() { return corpc::Server::start(); }
     protected:
         virtual corpc::Connection * buildConnection(int fd);
@@ -130,6 +154,7 @@ namespace corpc {
 
     public:
         friend class MessageServer::Connection;
+        friend class MessageServer::ConnectionGroup;
     };
     
     class TcpMessageServer: public MessageServer {
@@ -214,7 +214,7 @@ void Mutex::unlockSlow(int32_t newV) {
 }
 
 void Mutex::wait(bool queueLifo) {
-    pid_t pid = GetPid();
+    RoutineEnvironment *env = RoutineEnvironment::getEnv();
     stCoRoutine_t *coSelf = co_self();
 
     bool v = false;
@@ -222,16 +222,16 @@ void Mutex::wait(bool queueLifo) {
         v = false;
         if (_waitlock.compare_exchange_weak(v, true)) {
             if (_dontWait) {
-//                ERROR_LOG("Mutex::wait -- dont wait pid:%d co:%d\n", pid, coSelf);
+//                ERROR_LOG("Mutex::wait -- dont wait env:%p co:%p\n", env, coSelf);
                 _dontWait = false;
                 _waitlock.store(false);
                 return;
             }
 
             if (queueLifo) {
-                _waitRoutines.push_front({pid, coSelf});
+                _waitRoutines.push_front({env, coSelf});
             } else {
-                _waitRoutines.push_back({pid, coSelf});
+                _waitRoutines.push_back({env, coSelf});
             }
             
             _waitlock.store(false);
@@ -262,7 +262,7 @@ void Mutex::post() {
 
             _waitlock.store(false);
 
-            RoutineEnvironment::resumeCoroutine(info.pid, info.co, 0);
+            RoutineEnvironment::resumeCoroutine(info.env, info.co, 0);
             return;
         } else {
             // 自旋一会
@@ -29,10 +29,12 @@
 #define ACTIVE_SPIN_CNT 30
 
 namespace corpc {
+    class RoutineEnvironment;
+    
     // 本实现参考go的Mutex实现（不可重入）
     class Mutex {
         struct RoutineInfo {
-            pid_t pid;
+            RoutineEnvironment *env;
             stCoRoutine_t *co;
         };
 
@@ -0,0 +1,60 @@
+/*
+ * Created by Xianke Liu on 2026/10/17.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "corpc_queue.h"
+#include "corpc_routine_env.h"
+
+using namespace corpc;
+
+void CoWaitList::prepareWait() {
+    RoutineEnvironment *env = RoutineEnvironment::getEnv();
+    stCoRoutine_t *coSelf = co_self();
+    
+    std::unique_lock<std::mutex> lock( _waitMutex );
+    _waitRoutines.push_back({env, coSelf});
+    _waitNum++; // 必须在调用者再次检查数据之前对生产者可见
+}
+
+bool CoWaitList::cancelWait() {
+    stCoRoutine_t *coSelf = co_self();
+    
+    std::unique_lock<std::mutex> lock( _waitMutex );
+    for (auto it = _waitRoutines.begin(); it != _waitRoutines.end(); ++it) {
+        if (it->co == coSelf) {
+            _waitRoutines.erase(it);
+            _waitNum--;
+            return true;
+        }
+    }
+    
+    return false;
+}
+
+void CoWaitList::wakeOneSlow() {
+    RoutineInfo info;
+    {
+        std::unique_lock<std::mutex> lock( _waitMutex );
+        if (_waitRoutines.empty()) {
+            return;
+        }
+        
+        info = _waitRoutines.front();
+        _waitRoutines.erase(_waitRoutines.begin());
+        _waitNum--;
+    }
+    
+    RoutineEnvironment::resumeCoroutine(info.env, info.co, 0);
+}
@@ -23,8 +23,110 @@
 #include "corpc_mutex.h"
 #include "corpc_semaphore.h"
 
+#if defined( __APPLE__ ) || defined( __FreeBSD__ )
+#include <fcntl.h>
+#else
+#include <sys/eventfd.h>
+#endif
+#include <sched.h>
+
+#define CORPC_CACHELINE_SIZE 64
+#define CORPC_RING_QUEUE_SIZE 4096 // 有界环形队列默认容量
+#define CORPC_QUEUE_SEGMENT_SIZE 256 // 无界分段队列每段槽位数
+
 namespace corpc {
 
+    // 队列通知器：每个队列只占用一个fd（linux下为eventfd）
+    // 消费者准备睡眠时置_sleeping标志，生产者只有把标志从true改为false时才写fd，
+    // 因此只有队列由空变为非空（且消费者在等待）的那次入队才产生系统调用
+    // 注意：fd由消费者协程调用co_register_fd注册，注册后读操作才是协程阻塞式的
+    class QueueNotifier {
+    public:
+        QueueNotifier(): _sleeping(false) {
+#if defined( __APPLE__ ) || defined( __FreeBSD__ )
+            pipe(_fds);
+            fcntl(_fds[1], F_SETFL, fcntl(_fds[1], F_GETFL, 0) | O_NONBLOCK);
+#else
+            _fds[0] = _fds[1] = eventfd(0, EFD_CLOEXEC);
+#endif
+        }
+        ~QueueNotifier() {
+            close(_fds[0]);
+            if (_fds[1] != _fds[0]) {
+                close(_fds[1]);
+            }
+        }
+        
+        int getFd() { return _fds[0]; }
+        
+        // 生产者入队后调用
+        void notify() {
+            if (_sleeping.load() && _sleeping.exchange(false)) {
+#if defined( __APPLE__ ) || defined( __FreeBSD__ )
+                char buf = 'X';
+                ::write(_fds[1], &buf, 1);
+#else
+                // eventfd_write不经过hook，不会切出协程
+                eventfd_write(_fds[1], 1);
+#endif
+            }
+        }
+        
+        // 消费者检查队列为空之前调用（与notify中的exchange配对，保证不丢通知）
+        void prepareWait() { _sleeping.store(true); }
+        
+        // 消费者发现队列非空，取消等待
+        void cancelWait() { _sleeping.store(false); }
+        
+        // 阻塞等待通知，返回值同read
+        int wait() {
+            uint64_t buf[8];
+            return (int)read(_fds[0], buf, sizeof(buf));
+        }
+        
+    private:
+        int _fds[2];
+        std::atomic<bool> _sleeping; // 消费者是否在等待通知
+    };
+
+    // 为消费者提供协程阻塞等待能力的队列适配器
+    // Base需提供value_type、push、pop以及empty（由消费者调用）
+    template <typename Base>
+    class CoQueue: public Base {
+        typedef typename Base::value_type T;
+        
+    public:
+        template <typename... Args>
+        CoQueue(Args&&... args): Base(std::forward<Args>(args)...) {}
+        ~CoQueue() {}
+        
+        int getNotifyFd() { return _notifier.getFd(); }
+        
+        void push(T & v) {
+            Base::push(v);
+            _notifier.notify();
+        }
+        
+        void push(T && v) {
+            Base::push(std::move(v));
+            _notifier.notify();
+        }
+        
+        // 等待队列中有数据（队列非空时立即返回），返回值同read
+        int wait() {
+            _notifier.prepareWait();
+            if (!Base::empty()) {
+                _notifier.cancelWait();
+                return 1;
+            }
+            
+            return _notifier.wait();
+        }
+        
+    private:
+        QueueNotifier _notifier; // 通知处理协程有新任务入队
+    };
+    
     // 多生产者单消费者无锁队列实现
     // 注意：该实现只能在gcc 4.8.3之上版本使用，否则会出错，详见（https://gcc.gnu.org/bugzilla/show_bug.cgi?id=60272）
     template <typename T>
@@ -35,6 +137,8 @@ namespace corpc {
         };
         
     public:
+        typedef T value_type;
+        
         MPSC_NoLockQueue():_head(NULL), _outqueue(NULL) {}
         ~MPSC_NoLockQueue() {}
         
@@ -83,6 +187,11 @@ namespace corpc {
             
             return ret;
         }
+        
+        // 只能由消费者调用
+        bool empty() {
+            return !_outqueue && _head.load() == NULL;
+        }
             
     private:
         std::atomic<Node*> _head;
@@ -90,45 +199,15 @@ namespace corpc {
     };
     
     template <typename T>
-    class Co_MPSC_NoLockQueue: public MPSC_NoLockQueue<T> {
-    public:
-        Co_MPSC_NoLockQueue() {
-            pipe(_queuePipe.pipefd);
-            
-            co_register_fd(_queuePipe.pipefd[1]);
-            co_set_nonblock(_queuePipe.pipefd[1]);
-        }
-        ~Co_MPSC_NoLockQueue() {
-            close(_queuePipe.pipefd[0]);
-            close(_queuePipe.pipefd[1]);
-        }
-        
-        int getReadFd() { return _queuePipe.pipefd[0]; }
-        int getWriteFd() { return _queuePipe.pipefd[1]; }
-        
-        void push(T & v) {
-            MPSC_NoLockQueue<T>::push(v);
-            
-            char buf = 'X';
-            write(getWriteFd(), &buf, 1);
-        }
-        
-        void push(T && v) {
-            MPSC_NoLockQueue<T>::push(std::move(v));
-            
-            char buf = 'X';
-            write(getWriteFd(), &buf, 1);
-        }
-        
-    private:
-        PipeType _queuePipe; // 管道（用于通知处理协程有新rpc任务入队）
-    };
+    class Co_MPSC_NoLockQueue: public CoQueue<MPSC_NoLockQueue<T>> {};
 
     // 另一种形式的非锁实现
     // 注意：该Queue实现只支持多生产者和单消费者情形（因为_outqueue不是线程安全）
     template <typename T>
     class SyncQueue {
     public:
+        typedef T value_type;
+        
         SyncQueue() {}
         ~SyncQueue() {}
         
@@ -165,6 +244,16 @@ namespace corpc {
             return ret;
         }
         
+        // 只能由消费者调用
+        bool empty() {
+            if (!_outqueue.empty()) {
+                return false;
+            }
+            
+            LockGuard lock( _queueMutex );
+            return _inqueue.empty();
+        }
+        
     private:
         Mutex _queueMutex;
         std::list<T> _inqueue;
@@ -172,44 +261,14 @@ namespace corpc {
     };
     
     template <typename T>
-    class CoSyncQueue: public SyncQueue<T> {
-    public:
-        CoSyncQueue() {
-            pipe(_queuePipe.pipefd);
-            
-            co_register_fd(_queuePipe.pipefd[1]);
-            co_set_nonblock(_queuePipe.pipefd[1]);
-        }
-        ~CoSyncQueue() {
-            close(_queuePipe.pipefd[0]);
-            close(_queuePipe.pipefd[1]);
-        }
-        
-        int getReadFd() { return _queuePipe.pipefd[0]; }
-        int getWriteFd() { return _queuePipe.pipefd[1]; }
-        
-        void push(T & v) {
-            SyncQueue<T>::push(v);
-            
-            char buf = 'K';
-            write(getWriteFd(), &buf, 1);
-        }
-        
-        void push(T && v) {
-            SyncQueue<T>::push(std::move(v));
-            
-            char buf = 'K';
-            write(getWriteFd(), &buf, 1);
-        }
-        
-    private:
-        PipeType _queuePipe; // 管道（用于通知处理协程有新rpc任务入队）
-    };
+    class CoSyncQueue: public CoQueue<SyncQueue<T>> {};
     
      // 注意：该Queue实现只支持多生产者和单消费者情形
     template <typename T>
     class LockQueue {
     public:
+        typedef T value_type;
+        
         LockQueue() {}
         ~LockQueue() {}
         
@@ -246,6 +305,16 @@ namespace corpc {
             return ret;
         }
         
+        // 只能由消费者调用
+        bool empty() {
+            if (!_outqueue.empty()) {
+                return false;
+            }
+            
+            std::unique_lock<std::mutex> lock( _queueMutex );
+            return _inqueue.empty();
+        }
+        
     private:
         std::mutex _queueMutex;
         std::list<T> _inqueue;
@@ -253,81 +322,467 @@ namespace corpc {
     };
     
     template <typename T>
-    class CoLockQueue: public LockQueue<T> {
+    class CoLockQueue: public CoQueue<LockQueue<T>> {};
+
+    // 有界无锁环形队列（参考Dmitry Vyukov的bounded MPMC queue），每个槽位带序号，push/pop不分配内存
+    // MultiConsumer为false时为多生产者单消费者队列，消费端不需要CAS
+    // 容量向上取整为2的幂，队列满时push会让出执行（协程中sleep 1ms，线程中sched_yield）直到有空位
+    template <typename T, bool MultiConsumer>
+    class RingQueue {
+        struct Cell {
+            std::atomic<size_t> seq;
+            T value;
+        };
+        
     public:
-        CoLockQueue() {
-            pipe(_queuePipe.pipefd);
+        typedef T value_type;
+        
+        explicit RingQueue(size_t capacity = CORPC_RING_QUEUE_SIZE) {
+            size_t size = 2;
+            while (size < capacity) {
+                size <<= 1;
+            }
             
-            co_register_fd(_queuePipe.pipefd[1]);
-            co_set_nonblock(_queuePipe.pipefd[1]);
-        }
-        ~CoLockQueue() {
-            close(_queuePipe.pipefd[0]);
-            close(_queuePipe.pipefd[1]);
+            _mask = size - 1;
+            _cells = new Cell[size];
+            for (size_t i = 0; i < size; i++) {
+                _cells[i].seq.store(i, std::memory_order_relaxed);
+            }
+            
+            _pushPos.store(0);
+            _popPos.store(0);
         }
+        ~RingQueue() { delete [] _cells; }
+        
+        size_t capacity() { return _mask + 1; }
         
-        int getReadFd() { return _queuePipe.pipefd[0]; }
-        int getWriteFd() { return _queuePipe.pipefd[1]; }
+        // 队列满时返回false（v不被修改）
+        bool tryPush(T & v) { return doPush(v); }
+        bool tryPush(T && v) { return doPush(std::move(v)); }
         
         void push(T & v) {
-            SyncQueue<T>::push(v);
-            
-            char buf = 'K';
-            write(getWriteFd(), &buf, 1);
+            while (!doPush(v)) {
+                backoff();
+            }
         }
         
         void push(T && v) {
-            SyncQueue<T>::push(std::move(v));
+            while (!doPush(std::move(v))) {
+                backoff();
+            }
+        }
+        
+        T pop() {
+            T ret(nullptr);
+            
+            Cell *cell;
+            size_t pos = _popPos.load(std::memory_order_relaxed);
+            while (true) {
+                cell = &_cells[pos & _mask];
+                intptr_t diff = (intptr_t)cell->seq.load() - (intptr_t)(pos + 1);
+                if (diff == 0) {
+                    if (!MultiConsumer) {
+                        _popPos.store(pos + 1, std::memory_order_relaxed);
+                        break;
+                    }
+                    
+                    if (_popPos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                        break;
+                    }
+                } else if (diff < 0) {
+                    return ret; // 队列空
+                } else {
+                    pos = _popPos.load(std::memory_order_relaxed);
+                }
+            }
+            
+            ret = std::move(cell->value);
+            cell->seq.store(pos + _mask + 1, std::memory_order_release);
+            return ret;
+        }
+        
+        // 多消费者时结果只是参考值
+        bool empty() {
+            size_t pos = _popPos.load(std::memory_order_relaxed);
+            return (intptr_t)_cells[pos & _mask].seq.load() - (intptr_t)(pos + 1) < 0;
+        }
+        
+    private:
+        template <typename V>
+        bool doPush(V && v) {
+            Cell *cell;
+            size_t pos = _pushPos.load(std::memory_order_relaxed);
+            while (true) {
+                cell = &_cells[pos & _mask];
+                intptr_t diff = (intptr_t)cell->seq.load(std::memory_order_acquire) - (intptr_t)pos;
+                if (diff == 0) {
+                    if (_pushPos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                        break;
+                    }
+                } else if (diff < 0) {
+                    return false; // 队列满
+                } else {
+                    pos = _pushPos.load(std::memory_order_relaxed);
+                }
+            }
+            
+            cell->value = std::forward<V>(v);
+            cell->seq.store(pos + 1); // 需与QueueNotifier中的_sleeping构成全序，不能放宽为release
+            return true;
+        }
+        
+        void backoff() {
+            if (co_is_enable_sys_hook()) {
+                co_sleep_ms(1);
+            } else {
+                sched_yield();
+            }
+        }
+        
+    private:
+        Cell *_cells;
+        size_t _mask;
+        
+        // 生产者与消费者的位置分处不同cache line，避免伪共享
+        char _pad0[CORPC_CACHELINE_SIZE];
+        std::atomic<size_t> _pushPos;
+        char _pad1[CORPC_CACHELINE_SIZE - sizeof(std::atomic<size_t>)];
+        std::atomic<size_t> _popPos;
+        char _pad2[CORPC_CACHELINE_SIZE - sizeof(std::atomic<size_t>)];
+    };
+    
+    template <typename T>
+    using MPSC_RingQueue = RingQueue<T, false>;
+    
+    template <typename T>
+    using MPMC_RingQueue = RingQueue<T, true>;
+    
+    template <typename T>
+    class Co_MPSC_RingQueue: public CoQueue<MPSC_RingQueue<T>> {
+    public:
+        explicit Co_MPSC_RingQueue(size_t capacity = CORPC_RING_QUEUE_SIZE): CoQueue<MPSC_RingQueue<T>>(capacity) {}
+    };
+    
+    // 无界多生产者单消费者队列：由固定大小的段链接而成，段用完后经空闲链表回收复用
+    // 生产者通过段内计数器认领槽位，只有段写满时才分配（或复用）新段，因此平均每CORPC_QUEUE_SEGMENT_SIZE次push才有一次加锁
+    // 注意：生产者可能持有已被消费完的段的指针，因此段只回收到空闲链表而不释放，队列占用内存保持在峰值
+    template <typename T>
+    class MPSC_SegmentQueue {
+        struct Cell {
+            Cell(): ready(false) {}
+            
+            std::atomic<bool> ready;
+            T value;
+        };
+        
+        struct Segment {
+            Segment(): pushIdx(0), refs(0), next(NULL), freeNext(NULL) {}
+            
+            std::atomic<size_t> pushIdx; // 下一个待认领的槽位
+            std::atomic<int> refs; // 正在访问本段的生产者数
+            std::atomic<Segment*> next;
+            Segment *freeNext; // 空闲链表/待回收链表
+            Cell cells[CORPC_QUEUE_SEGMENT_SIZE];
+        };
+        
+    public:
+        typedef T value_type;
+        
+        MPSC_SegmentQueue(): _free(NULL), _popIdx(0), _retired(NULL) {
+            _head = new Segment;
+            _tail.store(_head);
+        }
+        
+        ~MPSC_SegmentQueue() {
+            deleteList(_free);
+            deleteList(_retired);
+            
+            Segment *seg = _head;
+            while (seg) {
+                Segment *next = seg->next.load();
+                delete seg;
+                seg = next;
+            }
+        }
+        
+        void push(T & v) { doPush(v); }
+        void push(T && v) { doPush(std::move(v)); }
+        
+        T pop() {
+            T ret(nullptr);
+            
+            if (_popIdx == CORPC_QUEUE_SEGMENT_SIZE) {
+                Segment *next = _head->next.load();
+                if (!next) {
+                    return ret;
+                }
+                
+                retire(_head);
+                _head = next;
+                _popIdx = 0;
+            }
             
-            char buf = 'K';
-            write(getWriteFd(), &buf, 1);
+            Cell &cell = _head->cells[_popIdx];
+            if (!cell.ready.load()) {
+                return ret;
+            }
+            
+            ret = std::move(cell.value);
+            cell.ready.store(false, std::memory_order_relaxed);
+            _popIdx++;
+            return ret;
+        }
+        
+        // 只能由消费者调用
+        bool empty() {
+            if (_popIdx == CORPC_QUEUE_SEGMENT_SIZE) {
+                Segment *next = _head->next.load();
+                return !next || !next->cells[0].ready.load();
+            }
+            
+            return !_head->cells[_popIdx].ready.load();
         }
         
     private:
-        PipeType _queuePipe; // 管道（用于通知处理协程有新rpc任务入队）
+        template <typename V>
+        void doPush(V && v) {
+            while (true) {
+                Segment *seg = _tail.load();
+                seg->refs.fetch_add(1);
+                if (_tail.load() != seg) {
+                    // 段已被替换（可能已回收），重新获取
+                    seg->refs.fetch_sub(1);
+                    continue;
+                }
+                
+                size_t idx = seg->pushIdx.fetch_add(1);
+                if (idx < CORPC_QUEUE_SEGMENT_SIZE) {
+                    Cell &cell = seg->cells[idx];
+                    cell.value = std::forward<V>(v);
+                    cell.ready.store(true); // 需与QueueNotifier中的_sleeping构成全序
+                    seg->refs.fetch_sub(1);
+                    return;
+                }
+                
+                // 当前段已满，链接新段并推进_tail
+                Segment *next = seg->next.load();
+                if (!next) {
+                    Segment *newSeg = allocSegment();
+                    if (seg->next.compare_exchange_strong(next, newSeg)) {
+                        next = newSeg;
+                    } else {
+                        freeSegment(newSeg);
+                    }
+                }
+                
+                Segment *expected = seg;
+                _tail.compare_exchange_strong(expected, next);
+                seg->refs.fetch_sub(1);
+            }
+        }
+        
+        Segment *allocSegment() {
+            Segment *seg = NULL;
+            {
+                std::unique_lock<std::mutex> lock( _freeMutex );
+                if (_free) {
+                    seg = _free;
+                    _free = seg->freeNext;
+                }
+            }
+            
+            if (!seg) {
+                return new Segment;
+            }
+            
+            // 槽位的ready标志已在消费时清除
+            seg->pushIdx.store(0);
+            seg->next.store(NULL);
+            seg->freeNext = NULL;
+            return seg;
+        }
+        
+        void freeSegment(Segment *seg) {
+            std::unique_lock<std::mutex> lock( _freeMutex );
+            seg->freeNext = _free;
+            _free = seg;
+        }
+        
+        // 消费完的段需等没有生产者引用后才能回收
+        void retire(Segment *seg) {
+            seg->freeNext = _retired;
+            _retired = seg;
+            
+            Segment **pp = &_retired;
+            while (*pp) {
+                Segment *s = *pp;
+                if (_tail.load() != s && s->refs.load() == 0) {
+                    *pp = s->freeNext;
+                    freeSegment(s);
+                } else {
+                    pp = &s->freeNext;
+                }
+            }
+        }
+        
+        static void deleteList(Segment *seg) {
+            while (seg) {
+                Segment *next = seg->freeNext;
+                delete seg;
+                seg = next;
+            }
+        }
+        
+    private:
+        std::mutex _freeMutex;
+        Segment *_free; // 空闲段链表
+        
+        char _pad0[CORPC_CACHELINE_SIZE];
+        std::atomic<Segment*> _tail; // 生产者写入段
+        char _pad1[CORPC_CACHELINE_SIZE - sizeof(std::atomic<Segment*>)];
+        
+        // 以下只由消费者访问
+        Segment *_head;
+        size_t _popIdx;
+        Segment *_retired; // 待回收段链表
     };
+    
+    template <typename T>
+    class Co_MPSC_SegmentQueue: public CoQueue<MPSC_SegmentQueue<T>> {};
 
+    // 等待数据的消费者协程列表（可跨线程），生产者只在有等待者时才进行唤醒
+    class CoWaitList {
+        struct RoutineInfo {
+            RoutineEnvironment *env;
+            stCoRoutine_t *co;
+        };
+        
+    public:
+        CoWaitList(): _waitNum(0) {}
+        ~CoWaitList() {}
+        
+        // 将当前协程登记为等待者（登记后需再次检查数据，再决定是否cancelWait或co_yield_ct）
+        void prepareWait();
+        
+        // 取消登记，返回false表示已被生产者取走唤醒，调用者仍需co_yield_ct等待该唤醒
+        bool cancelWait();
+        
+        // 唤醒一个等待者
+        void wakeOne() {
+            if (_waitNum.load() > 0) {
+                wakeOneSlow();
+            }
+        }
+        
+    private:
+        void wakeOneSlow();
+        
+    private:
+        std::atomic<int> _waitNum;
+        std::mutex _waitMutex;
+        std::vector<RoutineInfo> _waitRoutines;
+    };
+    
     // 跨线程多协程阻塞等待消息队列
+    // 数据存放在无锁的MPMC_RingQueue中，环形队列满时暂存到溢出链表（溢出期间新数据都进入溢出链表以保持顺序）
+    // 只有存在等待中的消费者协程时push才会进行唤醒
     template <typename T>
     class MPMC_NoLockBlockQueue {
     public:
-        MPMC_NoLockBlockQueue():_sem(0) {}
+        typedef T value_type;
+        
+        explicit MPMC_NoLockBlockQueue(size_t capacity = CORPC_RING_QUEUE_SIZE): _ring(capacity), _overflowNum(0) {}
         ~MPMC_NoLockBlockQueue() {}
 
         void push(T& v) {
-            {
-                LockGuard lock(_queueMutex);
-                _queue.push_back(v);
-            }
-
-            _sem.post();
+            enqueue(v);
+            _waitList.wakeOne();
         }
-
+        
         void push(T&& v) {
-            {
-                LockGuard lock( _queueMutex );
-                _queue.push_back(std::move(v));
+            enqueue(std::move(v));
+            _waitList.wakeOne();
+        }
+        
+        // 批量入队，只进行一次唤醒（被唤醒的消费者取满一批后若还有数据会继续唤醒其他消费者）
+        void pushBatch(T *items, int num) {
+            for (int i = 0; i < num; i++) {
+                enqueue(std::move(items[i]));
             }
             
-            _sem.post();
+            if (num > 0) {
+                _waitList.wakeOne();
+            }
+        }
+        
+        // 不阻塞，队列空时返回nullptr
+        T tryPop() {
+            T ret = _ring.pop();
+            if (!ret && _overflowNum.load() > 0) {
+                std::unique_lock<std::mutex> lock( _overflowMutex );
+                if (!_overflow.empty()) {
+                    ret = std::move(_overflow.front());
+                    _overflow.pop_front();
+                    _overflowNum--;
+                }
+            }
+            
+            return ret;
+        }
+        
+        // 阻塞直到取到至少一个数据，最多取num个，返回取到的个数
+        int popBatch(T *buf, int num) {
+            while (true) {
+                int count = 0;
+                while (count < num && (buf[count] = tryPop())) {
+                    count++;
+                }
+                
+                if (count > 0) {
+                    if (count == num && !empty()) {
+                        _waitList.wakeOne();
+                    }
+                    
+                    return count;
+                }
+                
+                _waitList.prepareWait();
+                if (!empty() && _waitList.cancelWait()) {
+                    continue;
+                }
+                
+                co_yield_ct(); // 等待生产者唤醒
+            }
         }
 
         T pop() {
-            _sem.wait();
-
-            {
-                LockGuard lock( _queueMutex );
-                T ret = std::move(_queue.front());
-                _queue.pop_front();
+            T ret;
+            popBatch(&ret, 1);
+            return ret;
+        }
+        
+        bool empty() {
+            return _ring.empty() && _overflowNum.load() == 0;
+        }
 
-                return ret;
+    private:
+        template <typename V>
+        void enqueue(V&& v) {
+            if (_overflowNum.load() > 0 || !_ring.tryPush(std::forward<V>(v))) {
+                std::unique_lock<std::mutex> lock( _overflowMutex );
+                _overflow.push_back(std::forward<V>(v));
+                _overflowNum++;
             }
         }
-
+        
     private:
-        Semaphore _sem;
-        Mutex _queueMutex;
-        std::list<T> _queue;
+        MPMC_RingQueue<T> _ring;
+        
+        std::atomic<int> _overflowNum;
+        std::mutex _overflowMutex;
+        std::list<T> _overflow;
+        
+        CoWaitList _waitList;
     };
 
 }
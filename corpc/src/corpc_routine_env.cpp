@@ -28,14 +28,29 @@
 
 using namespace corpc;
 
-// 由于需要线程间通信，这里没有使用__thread来实现线程相关变量，而是全局数组，风险点是pid超出204800导致数组越界（一般也不会在系统中启动那么多线程）
-static RoutineEnvironment* g_routineEnvPerThread[ 204800 ] = { 0 };
+// 线程相关的协程环境，跨线程唤醒时直接使用记录下来的环境指针（协程环境创建后不会销毁）
+static __thread RoutineEnvironment* g_routineEnv = NULL;
 std::atomic<uint32_t> RoutineEnvironment::_keyRoutineNum(0);
+unsigned int RoutineEnvironment::_shareStackCount = SHARE_STACK_COUNT;
+unsigned int RoutineEnvironment::_shareStackSize = SHARE_STACK_SIZE;
+unsigned int RoutineEnvironment::_privateStackLimit = PRIVATE_STACK_LIMIT;
+
+// 线程单独设置的共享栈配置（为0时使用全局配置）
+static __thread unsigned int g_threadShareStackCount = 0;
+static __thread unsigned int g_threadShareStackSize = 0;
 
 RoutineEnvironment::RoutineEnvironment() {
+    unsigned int count = g_threadShareStackCount ? g_threadShareStackCount : _shareStackCount;
+    unsigned int size = g_threadShareStackSize ? g_threadShareStackSize : _shareStackSize;
+    
     _attr = new stCoRoutineAttr_t;
-    _attr->stack_size = SHARE_STACK_SIZE;
-    _attr->share_stack = co_alloc_sharestack(SHARE_STACK_COUNT, SHARE_STACK_SIZE);
+    _attr->stack_size = size;
+    _attr->share_stack = co_alloc_sharestack(count, size);
+    
+    _privateAttr = new stCoRoutineAttr_t;
+    _privateAttr->stack_size = size;
+    _privateAttr->share_stack = NULL;
+    _privateStackNum = 0;
     
     pipe(_endPipe.pipefd);
     co_register_fd(_endPipe.pipefd[1]);
@@ -51,10 +66,12 @@ RoutineEnvironment::~RoutineEnvironment() {
     if (_attr) {
         delete _attr;
     }
+    
+    delete _privateAttr;
 }
 
 RoutineEnvironment *RoutineEnvironment::getEnv() {
-    RoutineEnvironment *env = g_routineEnvPerThread[GetPid()];
+    RoutineEnvironment *env = g_routineEnv;
     if (!env) {
         env = initialize();
     }
@@ -62,18 +79,27 @@ RoutineEnvironment *RoutineEnvironment::getEnv() {
     return env;
 }
 
+void RoutineEnvironment::setShareStackConfig(unsigned int count, unsigned int size, bool threadOnly) {
+    if (threadOnly) {
+        g_threadShareStackCount = count;
+        g_threadShareStackSize = size;
+    } else {
+        _shareStackCount = count;
+        _shareStackSize = size;
+    }
+}
+
 void RoutineEnvironment::init() {
     co_start_hook();
 }
 
 RoutineEnvironment *RoutineEnvironment::initialize() {
-    pid_t pid = GetPid();
-    assert(!g_routineEnvPerThread[pid]);
+    assert(!g_routineEnv);
     
-    DEBUG_LOG("initialize env for pid: %d\n", pid);
+    DEBUG_LOG("initialize env for pid: %d\n", GetPid());
     
     RoutineEnvironment *env = new RoutineEnvironment();
-    g_routineEnvPerThread[pid] = env;
+    g_routineEnv = env;
     
     stCoRoutine_t *co = NULL;
     
@@ -108,7 +134,7 @@ void RoutineEnvironment::addTimeoutTask( std::shared_ptr<RpcClientTask>& rpcTask
 }
 
 void RoutineEnvironment::pause() {
-    resumeCoroutine(GetPid(), co_self());
+    resumeCoroutine(getEnv(), co_self());
     co_yield_ct();
 }
 
@@ -125,7 +151,7 @@ void RoutineEnvironment::pauseIfRuntimeBusy() {
 //    //   1.禁止新协程创建
 //    //   2.等待正在运行的协程结束（这点不好处理，原因：1.协程正注册在IO事件中等待，当IO事件发生时会唤醒协程执行，若此时协程已被清理则程序跑飞，2.程序员在协程中在堆中创建的对象无法释放，导致资源泄漏。一般只能等待协程自然结束，而协程中的处理很可能不会结束）
 //    //   3.守护协程结束
-//    //   4.从g_routineEnvPerThread中清理线程协程环境
+//    //   4.清理线程协程环境g_routineEnv
 //    //   5.delete this;
 //    //
 //    // 由于第2点不好处理，而且一般情况开的线程不需要结束，因此先不实现
@@ -140,8 +166,10 @@ stCoRoutine_t *RoutineEnvironment::startCoroutine(pfn_co_routine_t pfn,void *arg
     context->pfn = pfn;
     context->arg = arg;
     
-    co_create( &co, curenv->_attr, routineEntry, context);
-    co_resume( co );
+    co = curenv->createCoroutine(context, routineEntry);
+    if (co) {
+        co_resume( co );
+    }
     
     return co;
 }
@@ -155,14 +183,69 @@ stCoRoutine_t *RoutineEnvironment::startKeyCoroutine(pfn_co_routine_t pfn,void *
     context->pfn = pfn;
     context->arg = arg;
     
-    co_create( &co, curenv->_attr, keyRoutineEntry, context);
-    co_resume( co );
+    co = curenv->createCoroutine(context, keyRoutineEntry);
+    if (co) {
+        co_resume( co );
+    }
     
     return co;
 }
 
-void RoutineEnvironment::resumeCoroutine( pid_t pid, stCoRoutine_t *co, uint64_t expireTime, int err ) {
-    RoutineEnvironment *env = g_routineEnvPerThread[pid];
+stCoRoutine_t *RoutineEnvironment::createCoroutine( RoutineContext *context, pfn_co_routine_t entry ) {
+    stCoRoutine_t *co = NULL;
+    if (co_create( &co, selectAttr(context), entry, context) == 0) {
+        return co;
+    }
+    
+    // 独立栈分配失败（如映射数达到vm.max_map_count）时改用共享栈
+    if (context->privateStack) {
+        context->privateStack = false;
+        _privateStackNum--;
+        if (co_create( &co, _attr, entry, context) == 0) {
+            return co;
+        }
+    }
+    
+    ERROR_LOG("RoutineEnvironment::createCoroutine() -- alloc coroutine stack failed\n");
+    delete context;
+    return NULL;
+}
+
+stCoRoutineAttr_t *RoutineEnvironment::selectAttr( RoutineContext *context ) {
+    // 运行中的协程不能换栈，只能按入口学习：入口曾有协程成为热点时，之后以此入口启动的协程直接使用独立栈
+    context->privateStack = false;
+    if (_hotScores.empty() || _privateStackNum >= _privateStackLimit) {
+        return _attr;
+    }
+    
+    auto it = _hotScores.find(context->pfn);
+    if (it == _hotScores.end()) {
+        return _attr;
+    }
+    
+    context->privateStack = true;
+    _privateStackNum++;
+    co_get_stat_ct()->ullPrivateStackCnt++;
+    return _privateAttr;
+}
+
+void RoutineEnvironment::updateHotScore( pfn_co_routine_t pfn, bool hot ) {
+    if (hot) {
+        int &score = _hotScores[pfn];
+        if (score < HOT_SCORE_LIMIT) {
+            score++;
+        }
+        return;
+    }
+    
+    // 独立栈达到上限后同一入口的协程回到共享栈，未成为热点时热度衰减，衰减到0后不再分配独立栈
+    auto it = _hotScores.find(pfn);
+    if (it != _hotScores.end() && (it->second /= 2) == 0) {
+        _hotScores.erase(it);
+    }
+}
+
+void RoutineEnvironment::resumeCoroutine( RoutineEnvironment *env, stCoRoutine_t *co, uint64_t expireTime, int err ) {
     assert(env);
     
     WaitResumeRPCRoutine *wr = new WaitResumeRPCRoutine;
@@ -189,6 +272,7 @@ void *RoutineEnvironment::routineEntry( void *arg ) {
     RoutineContext *context = (RoutineContext*)arg;
     pfn_co_routine_t pfn = context->pfn;
     void *ar = context->arg;
+    bool privateStack = context->privateStack;
     
     delete context;
     
@@ -198,7 +282,15 @@ void *RoutineEnvironment::routineEntry( void *arg ) {
     curenv->_livingRoutineNum--;
 #endif
     
-    getEnv()->addEndedCoroutine(co_self());
+    RoutineEnvironment *env = getEnv();
+    stCoRoutine_t *self = co_self();
+    if (privateStack) {
+        env->_privateStackNum--;
+    } else {
+        env->updateHotScore(pfn, co_is_hot(self));
+    }
+    
+    env->addEndedCoroutine(self);
     
     return NULL;
 }
@@ -247,7 +339,7 @@ void *RoutineEnvironment::cleanRoutine( void *arg ) {
             stCoRoutine_t *co = curenv->_endedCoroutines.front();
             curenv->_endedCoroutines.pop_front();
             
-            co_release(co);
+            co_recycle(co);
             
 #ifdef MONITOR_ROUTINE
             curenv->_routineNum--;
@@ -263,23 +355,22 @@ void *RoutineEnvironment::resumeRoutine( void *arg ) {
     
     RoutineEnvironment *curenv = (RoutineEnvironment *)arg;
     
-    int readFd = curenv->_waitResumeQueue.getReadFd();
-    co_register_fd(readFd);
-    co_set_timeout(readFd, -1, 1000);
+    int notifyFd = curenv->_waitResumeQueue.getNotifyFd();
+    co_register_fd(notifyFd);
+    co_set_timeout(notifyFd, -1, 1000);
     
     int ret;
-    std::vector<char> buf(1024);
     while (true) {
         // 等待处理信号
-        ret = (int)read(readFd, &buf[0], 1024);
+        ret = curenv->_waitResumeQueue.wait();
         assert(ret != 0);
         if (ret < 0) {
             if (errno == EAGAIN) {
                 continue;
             } else {
-                // 管道出错
-                ERROR_LOG("RoutineEnvironment::resumeRoutine read from up pipe fd %d ret %d errno %d (%s)\n",
-                       readFd, ret, errno, strerror(errno));
+                // 通知fd出错
+                ERROR_LOG("RoutineEnvironment::resumeRoutine wait on notify fd %d ret %d errno %d (%s)\n",
+                       notifyFd, ret, errno, strerror(errno));
                 
                 // TODO: 如何处理？退出协程？
                 // sleep 10 milisecond
@@ -355,7 +446,7 @@ void *RoutineEnvironment::monitorRoutine( void *arg ) {
     while( true ) {
         sleep(1);
         
-        LOG("monitorRoutine -- env: %ld, living: %d, dead: %d\n", curenv, curenv->_livingRoutineNum, curenv->_routineNum - curenv->_livingRoutineNum);
+        LOG("monitorRoutine -- env: %ld, living: %d, dead: %d, share stacks: %d, stack resident: %lu\n", curenv, curenv->_livingRoutineNum, curenv->_routineNum - curenv->_livingRoutineNum, curenv->getShareStackCount(), curenv->getStackResidentSize());
     }
     
     return NULL;
@@ -23,11 +23,13 @@
 #include "corpc_timeout_list.h"
 
 #include <list>
+#include <unordered_map>
 
 namespace corpc {
     struct RoutineContext {
         pfn_co_routine_t pfn;
         void *arg;
+        bool privateStack; // 是否因入口曾成为热点而使用独立栈
     };
 
     struct WaitResumeRPCRoutine {
@@ -39,8 +41,10 @@ namespace corpc {
     // 协程环境是否应该与线程绑定，约定每个线程只有一个协程环境
     // 每个线程可初始化自己的协程环境，约定只能初始化一次，一般在线程开始时初始化
     class RoutineEnvironment {
-        static const unsigned int SHARE_STACK_COUNT = 50; //多个共享栈可以降低栈数据切换
+        static const unsigned int SHARE_STACK_COUNT = 50; //多个共享栈可以降低栈数据切换（数量上限，按需创建）
         static const unsigned int SHARE_STACK_SIZE = 1024 * 1024;
+        static const unsigned int PRIVATE_STACK_LIMIT = 64; // 每线程同时存在的热点独立栈数量上限
+        static const int HOT_SCORE_LIMIT = 16; // 入口热度分值上限
         
 #ifdef USE_NO_LOCK_QUEUE
         typedef Co_MPSC_NoLockQueue<WaitResumeRPCRoutine *> WaitResumeQueue;
@@ -66,14 +70,23 @@ namespace corpc {
     public:
         //void destroy(); // 清理当前线程协程环境
         static void init();
-        static stCoRoutine_t *startCoroutine(pfn_co_routine_t pfn,void *arg);
+        static stCoRoutine_t *startCoroutine(pfn_co_routine_t pfn,void *arg); // 栈内存分配失败时返回NULL，协程不会运行
         static stCoRoutine_t *startKeyCoroutine(pfn_co_routine_t pfn,void *arg);
-        static void resumeCoroutine( pid_t pid, stCoRoutine_t *co, uint64_t expireTime = 0, int err = 0 ); // 用于跨线程唤醒RPC协程
+        static void resumeCoroutine( RoutineEnvironment *env, stCoRoutine_t *co, uint64_t expireTime = 0, int err = 0 ); // 用于跨线程唤醒RPC协程（env为协程所在线程的协程环境）
         static void runEventLoop(); // 事件循环
         
         static RoutineEnvironment *getEnv();    // 获取线程相关的协程环境
         stCoRoutineAttr_t *getAttr() { return _attr; }
         
+        // 设置之后创建的协程环境的共享栈数量上限和大小，threadOnly为true时只对当前线程（需在本线程协程环境创建前调用）
+        static void setShareStackConfig(unsigned int count, unsigned int size, bool threadOnly = false);
+        int getShareStackCount() { return co_get_sharestack_count(_attr->share_stack); } // 已创建的共享栈数
+        size_t getStackResidentSize() { return co_get_sharestack_resident_size(_attr->share_stack); } // 共享栈实际占用的物理内存
+        
+        // 设置每个线程同时存在的热点独立栈数量上限（为0时不使用独立栈）
+        static void setPrivateStackLimit(unsigned int limit) { _privateStackLimit = limit; }
+        unsigned int getPrivateStackNum() { return _privateStackNum; } // 本线程当前使用热点独立栈的协程数
+        
         static void quit();
         
         static void addTimeoutTask( std::shared_ptr<RpcClientTask>& rpcTask );
@@ -100,8 +113,18 @@ namespace corpc {
         
         void addEndedCoroutine( stCoRoutine_t *co ); // 协程结束
         
+        stCoRoutine_t *createCoroutine( RoutineContext *context, pfn_co_routine_t entry ); // 创建协程，栈分配失败时返回NULL
+        stCoRoutineAttr_t *selectAttr( RoutineContext *context ); // 按入口热度选择共享栈或独立栈
+        void updateHotScore( pfn_co_routine_t pfn, bool hot ); // 协程结束时更新入口热度
+        
     private:
         stCoRoutineAttr_t *_attr;
+        stCoRoutineAttr_t *_privateAttr; // 独立栈属性（用于曾成为热点的协程入口）
+        
+        // 入口函数热度：以该入口启动的协程在共享栈上成为热点结束时加1，在共享栈上未成为热点结束时减半，
+        // 热度大于0的入口启动的协程使用独立栈（不超过_privateStackLimit个），独立栈上结束的协程不改变热度
+        std::unordered_map<pfn_co_routine_t, int> _hotScores;
+        unsigned int _privateStackNum; // 本线程当前使用热点独立栈的协程数
         
         PipeType _endPipe; // 用于通知cleanRoutine“有已结束协程”
         std::list<stCoRoutine_t*> _endedCoroutines; // 已结束的协程（待清理的协程）
@@ -112,6 +135,10 @@ namespace corpc {
         
         static std::atomic<uint32_t> _keyRoutineNum;
         
+        static unsigned int _shareStackCount;
+        static unsigned int _shareStackSize;
+        static unsigned int _privateStackLimit;
+        
 #ifdef MONITOR_ROUTINE
         // 监控状态
         static void *monitorRoutine( void *arg ); // 监控协程
@@ -18,6 +18,7 @@
 
 #include "corpc_rpc_client.h"
 #include "corpc_utils.h"
+#include "corpc_thread_placement.h"
 
 #include <errno.h>
 #include <sys/time.h>
@@ -71,13 +72,13 @@ void * RpcClient::decode(std::shared_ptr<corpc::Connection> &connection, uint8_t
         ERROR_LOG("RpcClient::decode -- parse response body fail\n");
         assert(false);
         // 什么情况会导致proto消息解析失败？
-        RoutineEnvironment::resumeCoroutine(task->rpcTask->pid, task->rpcTask->co, expireTime, EBADMSG);
+        RoutineEnvironment::resumeCoroutine(task->rpcTask->env, task->rpcTask->co, expireTime, EBADMSG);
 
         return nullptr;
     }
     
     // 注意：在这直接进行跨线程协程唤醒，而不是返回后再处理
-    RoutineEnvironment::resumeCoroutine(task->rpcTask->pid, task->rpcTask->co, expireTime);
+    RoutineEnvironment::resumeCoroutine(task->rpcTask->env, task->rpcTask->co, expireTime);
     
     return nullptr;
 }
@@ -206,7 +207,7 @@ void RpcClient::ChannelCore::CallMethod(const google::protobuf::MethodDescriptor
     std::shared_ptr<ClientTask> clientTask(new ClientTask);
     clientTask->channel = shared_from_this();
     clientTask->rpcTask = std::make_shared<RpcClientTask>();
-    clientTask->rpcTask->pid = GetPid();
+    clientTask->rpcTask->env = RoutineEnvironment::getEnv();
     clientTask->rpcTask->co = co_self();
     clientTask->rpcTask->request = request;
     clientTask->rpcTask->request_1 = NULL; // 跨进程RPC调用不需要拷贝request
@@ -272,10 +273,13 @@ RpcClient* RpcClient::create(IO *io) {
 }
 
 void RpcClient::start() {
-    _t = std::thread(threadEntry, this);
+    static std::atomic<uint16_t> clientNum(0); // 每个RpcClient一个线程，按启动顺序作为线程下标
+    _t = std::thread(threadEntry, this, clientNum++);
 }
 
-void RpcClient::threadEntry(RpcClient *self) {
+void RpcClient::threadEntry(RpcClient *self, uint16_t index) {
+    ThreadPlacement::apply(THREAD_ROLE_RPC_CLIENT, index);
+    
     RoutineEnvironment::startCoroutine(connectionRoutine, self);
     
     RoutineEnvironment::startCoroutine(taskHandleRoutine, self);
@@ -288,26 +292,25 @@ void RpcClient::threadEntry(RpcClient *self) {
 void *RpcClient::connectionRoutine( void * arg ) {
     RpcClient *self = (RpcClient *)arg;
     
-    int readFd = self->_connectionTaskQueue.getReadFd();
-    co_register_fd(readFd);
-    co_set_timeout(readFd, -1, 1000);
+    int notifyFd = self->_connectionTaskQueue.getNotifyFd();
+    co_register_fd(notifyFd);
+    co_set_timeout(notifyFd, -1, 1000);
     
     IO *io = self->_io;
     Sender *sender = io->getSender();
     
     int ret;
-    std::vector<char> buf(1024);
     while (true) {
         // 等待处理信号
-        ret = (int)read(readFd, &buf[0], 1024);
+        ret = self->_connectionTaskQueue.wait();
         assert(ret != 0);
         if (ret < 0) {
             if (errno == EAGAIN) {
                 continue;
             } else {
-                // 管道出错
-                ERROR_LOG("RpcClient::connectionRoutine read from up pipe fd %d ret %d errno %d (%s)\n",
-                       readFd, ret, errno, strerror(errno));
+                // 通知fd出错
+                ERROR_LOG("RpcClient::connectionRoutine wait on notify fd %d ret %d errno %d (%s)\n",
+                       notifyFd, ret, errno, strerror(errno));
                 
                 // TODO: 如何处理？退出协程？
                 // sleep 10 milisecond
@@ -338,7 +341,7 @@ void *RpcClient::connectionRoutine( void * arg ) {
                                 task->rpcTask->controller->SetFailed(strerror(ENETDOWN));
                             }
                             
-                            RoutineEnvironment::resumeCoroutine(task->rpcTask->pid, task->rpcTask->co, task->rpcTask->expireTime, ENETDOWN);
+                            RoutineEnvironment::resumeCoroutine(task->rpcTask->env, task->rpcTask->co, task->rpcTask->expireTime, ENETDOWN);
                         }
                     }
                     
@@ -442,7 +445,7 @@ void *RpcClient::connectionRoutine( void * arg ) {
                                     task->rpcTask->controller->SetFailed(strerror(errno));
                                 }
 
-                                RoutineEnvironment::resumeCoroutine(task->rpcTask->pid, task->rpcTask->co, task->rpcTask->expireTime, errno);
+                                RoutineEnvironment::resumeCoroutine(task->rpcTask->env, task->rpcTask->co, task->rpcTask->expireTime, errno);
                             } else {
                                 if (task->rpcTask->controller) {
                                     task->rpcTask->controller->SetFailed(strerror(errno));
@@ -514,24 +517,23 @@ void *RpcClient::taskHandleRoutine(void *arg) {
     ClientTaskQueue& queue = self->_taskQueue;
     Sender *sender = self->_io->getSender();
     
-    // 初始化pipe readfd
-    int readFd = queue.getReadFd();
-    co_register_fd(readFd);
-    co_set_timeout(readFd, -1, 1000);
+    // 注册队列通知fd
+    int notifyFd = queue.getNotifyFd();
+    co_register_fd(notifyFd);
+    co_set_timeout(notifyFd, -1, 1000);
     
     int ret;
-    std::vector<char> buf(1024);
     while (true) {
         // 等待处理信号
-        ret = (int)read(readFd, &buf[0], 1024);
+        ret = queue.wait();
         assert(ret != 0);
         if (ret < 0) {
             if (errno == EAGAIN) {
                 continue;
             } else {
-                // 管道出错
-                ERROR_LOG("RpcClient::taskHandleRoutine read from pipe fd %d ret %d errno %d (%s)\n",
-                       readFd, ret, errno, strerror(errno));
+                // 通知fd出错
+                ERROR_LOG("RpcClient::taskHandleRoutine wait on notify fd %d ret %d errno %d (%s)\n",
+                       notifyFd, ret, errno, strerror(errno));
                 
                 // TODO: 如何处理？退出协程？
                 // sleep 10 milisecond
@@ -544,6 +546,10 @@ void *RpcClient::taskHandleRoutine(void *arg) {
         uint64_t now = t1.tv_sec * 1000 + t1.tv_usec / 1000; // 当前时间（毫秒精度）
         int count = 0;
         
+        // 发往同一连接的连续请求合并成一个发送任务
+        std::shared_ptr<corpc::Connection> batchConn;
+        std::vector<std::shared_ptr<void>> batchDatas;
+        
         // 处理任务队列
         std::shared_ptr<ClientTask> task = queue.pop();
         while (task) {
@@ -558,7 +564,7 @@ void *RpcClient::taskHandleRoutine(void *arg) {
                         task->rpcTask->controller->SetFailed(strerror(ENETDOWN));
                     }
                     
-                    RoutineEnvironment::resumeCoroutine(task->rpcTask->pid, task->rpcTask->co, task->rpcTask->expireTime, ENETDOWN);
+                    RoutineEnvironment::resumeCoroutine(task->rpcTask->env, task->rpcTask->co, task->rpcTask->expireTime, ENETDOWN);
                 } else {
                     if (task->rpcTask->controller) {
                         task->rpcTask->controller->SetFailed(strerror(ENETDOWN));
@@ -576,21 +582,29 @@ void *RpcClient::taskHandleRoutine(void *arg) {
                 } else {
                     std::shared_ptr<corpc::Connection> ioConn = std::static_pointer_cast<corpc::Connection>(conn);
                     
+                    bool needSend = true;
                     if (task->rpcTask->response) {
                         // 若rpc任务已超时就不需发给服务器
                         if (task->rpcTask->expireTime == 0 || now < task->rpcTask->expireTime) {
-                            {
-                                LockGuard lock(conn->_waitResultCoMapMutex);
+                            LockGuard lock(conn->_waitResultCoMapMutex);
 
-                                // 注意：由于加入RPC超时机制后，rpc请求协程会在处理超时时结束请求，但_waitResultCoMap中还留有旧记录，新rpc请求会insert不了，改为赋值替换
-                                //conn->_waitResultCoMap.insert(std::make_pair(uint64_t(task->rpcTask->co), task));
-                                conn->_waitResultCoMap[uint64_t(task->rpcTask->co)] = task;
+                            // 注意：由于加入RPC超时机制后，rpc请求协程会在处理超时时结束请求，但_waitResultCoMap中还留有旧记录，新rpc请求会insert不了，改为赋值替换
+                            //conn->_waitResultCoMap.insert(std::make_pair(uint64_t(task->rpcTask->co), task));
+                            conn->_waitResultCoMap[uint64_t(task->rpcTask->co)] = task;
+                        } else {
+                            needSend = false;
+                        }
+                    }
+                    
+                    if (needSend) {
+                        if (batchConn != ioConn) {
+                            if (batchConn) {
+                                sender->sendBatch(batchConn, batchDatas);
                             }
-                        
-                            sender->send(ioConn, task->rpcTask);
+                            batchConn = ioConn;
                         }
-                    } else {
-                        sender->send(ioConn, task->rpcTask);
+                        
+                        batchDatas.push_back(task->rpcTask);
                     }
                 }
             }
@@ -600,6 +614,12 @@ void *RpcClient::taskHandleRoutine(void *arg) {
             if (count == 100) {
                 gettimeofday(&t2, NULL);
                 if ((t2.tv_sec - t1.tv_sec) * 1000000 + t2.tv_usec - t1.tv_usec > 100000) {
+                    // 让出前先把已合并的请求发出
+                    if (batchConn) {
+                        sender->sendBatch(batchConn, batchDatas);
+                        batchConn.reset();
+                    }
+                    
                     RoutineEnvironment::pause();
                     
                     gettimeofday(&t1, NULL);
@@ -610,6 +630,10 @@ void *RpcClient::taskHandleRoutine(void *arg) {
             
             task = queue.pop();
         }
+        
+        if (batchConn) {
+            sender->sendBatch(batchConn, batchDatas);
+        }
     }
     
     return NULL;
@@ -620,24 +644,23 @@ void *RpcClient::clearChannelRoutine(void *arg) {
     
     ClearChannelQueue& queue = self->_clearChannelQueue;
 
-    // 初始化pipe readfd
-    int readFd = queue.getReadFd();
-    co_register_fd(readFd);
-    co_set_timeout(readFd, -1, 1000);
+    // 注册队列通知fd
+    int notifyFd = queue.getNotifyFd();
+    co_register_fd(notifyFd);
+    co_set_timeout(notifyFd, -1, 1000);
     
     int ret;
-    std::vector<char> buf(1024);
     while (true) {
         // 等待处理信号
-        ret = (int)read(readFd, &buf[0], 1024);
+        ret = queue.wait();
         assert(ret != 0);
         if (ret < 0) {
             if (errno == EAGAIN) {
                 continue;
             } else {
-                // 管道出错
-                ERROR_LOG("RpcClient::clearChannelRoutine read from pipe fd %d ret %d errno %d (%s)\n",
-                          readFd, ret, errno, strerror(errno));
+                // 通知fd出错
+                ERROR_LOG("RpcClient::clearChannelRoutine wait on notify fd %d ret %d errno %d (%s)\n",
+                          notifyFd, ret, errno, strerror(errno));
                 
                 // TODO: 如何处理？退出协程？
                 // sleep 10 milisecond
@@ -161,7 +161,7 @@ namespace corpc {
         
         // 注意：需要开启线程来执行connectionRoutine和taskHandleRoutine协程，原因是not_care_response类型的rpc调用不会触发调用处协程切换，
         // 此时如果在同一线程中开启connectionRoutine和taskHandleRoutine协程，它们将等到调用处协程将来让出执行后才能得到调度，导致数据不能及时发送。
-        static void threadEntry(RpcClient *self);
+        static void threadEntry(RpcClient *self, uint16_t index);
         
         static void *connectionRoutine(void * arg);  // 负责为connection连接建立和断线处理
         
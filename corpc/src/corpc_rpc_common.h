@@ -24,9 +24,12 @@
 #define corpc_rpc_common_h
 
 namespace corpc {
+    class RoutineEnvironment;
+    
     class RpcClientTask {
     public:
-        pid_t pid;
+        RoutineEnvironment *env; // 发起调用的协程所在线程的协程环境
+
         stCoRoutine_t *co;
         const google::protobuf::Message* request;
         google::protobuf::Message* request_1;
@@ -23,7 +23,7 @@ using namespace corpc;
 void Semaphore::wait() {
     // 判断是否能直接获得资源
     // _res值：为0时表示已上锁，大于0时表示未上锁，为-1时表示有协程正在进行排队，为-2时表示正在进行解锁
-    pid_t pid = GetPid();
+    RoutineEnvironment *env = RoutineEnvironment::getEnv();
     stCoRoutine_t *coSelf = co_self();
     int retryTimes = 0;
     while (true) {
@@ -33,7 +33,7 @@ void Semaphore::wait() {
             if (_res.compare_exchange_weak(v, -1)) {
                 //assert(v == 0);
                 // 若改成功，将本协程插入等待唤醒队列（由于只会有一个协程成功将_res改为-1，因此这里不需要用锁或者CAS机制），然后将_res从-1改为0（这里必然一次成功），yeld协程等待唤醒，退出
-                _waitRoutines.push_back({pid, coSelf});
+                _waitRoutines.push_back({env, coSelf});
 
                 //assert(_res.load() == -1);
 
@@ -80,7 +80,7 @@ void Semaphore::post() {
 
                     _res.store(0);
 
-                    RoutineEnvironment::resumeCoroutine(info.pid, info.co, 0);
+                    RoutineEnvironment::resumeCoroutine(info.env, info.co, 0);
                 }
                 return;
             }
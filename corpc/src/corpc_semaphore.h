@@ -22,9 +22,11 @@
 #include <atomic>
 
 namespace corpc {
+    class RoutineEnvironment;
+    
     class Semaphore {
         struct RoutineInfo {
-            pid_t pid;
+            RoutineEnvironment *env;
             stCoRoutine_t *co;
         };
 
@@ -0,0 +1,126 @@
+/*
+ * Created by Xianke Liu on 2026/10/17.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "corpc_thread_placement.h"
+#include "corpc_utils.h"
+
+#include <errno.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <dirent.h>
+
+#if defined( __linux__ )
+#include <sched.h>
+#include <sys/syscall.h>
+#endif
+
+// 不依赖libnuma，直接使用set_mempolicy系统调用
+#define CORPC_MPOL_PREFERRED 1
+
+using namespace corpc;
+
+std::vector<int> ThreadPlacement::_cpus[THREAD_ROLE_NUM];
+bool ThreadPlacement::_numaLocal = true;
+
+static const char *g_roleNames[THREAD_ROLE_NUM] = {"receiver", "sender", "worker", "inner rpc", "rpc client"};
+
+// 从sysfs读取各CPU所在的NUMA节点（/sys/devices/system/cpu/cpuN/nodeM）
+static std::vector<int> loadCpuNodes() {
+    std::vector<int> nodes;
+
+    long cpuNum = sysconf(_SC_NPROCESSORS_CONF);
+    for (long cpu = 0; cpu < cpuNum; cpu++) {
+        int node = -1;
+
+        char path[64];
+        snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%ld", cpu);
+        DIR *dir = opendir(path);
+        if (dir) {
+            struct dirent *entry;
+            while ((entry = readdir(dir)) != NULL) {
+                if (strncmp(entry->d_name, "node", 4) == 0) {
+                    node = atoi(entry->d_name + 4);
+                    break;
+                }
+            }
+            closedir(dir);
+        }
+
+        nodes.push_back(node);
+    }
+
+    return nodes;
+}
+
+void ThreadPlacement::setCpus(ThreadRole role, const std::vector<int>& cpus) {
+    _cpus[role] = cpus;
+}
+
+int ThreadPlacement::getCpu(ThreadRole role, uint16_t index) {
+    const std::vector<int>& cpus = _cpus[role];
+    if (cpus.empty()) {
+        return -1;
+    }
+
+    return cpus[index % cpus.size()];
+}
+
+int ThreadPlacement::getNode(int cpu) {
+    static std::vector<int> nodes = loadCpuNodes();
+
+    if (cpu < 0 || cpu >= (int)nodes.size()) {
+        return -1;
+    }
+
+    return nodes[cpu];
+}
+
+void ThreadPlacement::apply(ThreadRole role, uint16_t index) {
+    int cpu = getCpu(role, index);
+
+#if defined( __linux__ )
+    if (cpu >= 0) {
+        cpu_set_t mask;
+        CPU_ZERO(&mask);
+        CPU_SET(cpu, &mask);
+        if (sched_setaffinity(0, sizeof(mask), &mask) < 0) {
+            ERROR_LOG("ThreadPlacement::apply() -- %s thread %d bind cpu %d failed, errno %d (%s)\n", g_roleNames[role], index, cpu, errno, strerror(errno));
+            cpu = -1;
+        }
+    }
+
+    int node = getNode(cpu);
+    if (cpu >= 0 && node >= 0 && _numaLocal && node < (int)sizeof(unsigned long) * 8) {
+        unsigned long nodemask = 1UL << node;
+        if (syscall(SYS_set_mempolicy, CORPC_MPOL_PREFERRED, &nodemask, sizeof(nodemask) * 8) < 0) {
+            WARN_LOG("ThreadPlacement::apply() -- %s thread %d set mempolicy for node %d failed, errno %d (%s)\n", g_roleNames[role], index, node, errno, strerror(errno));
+        }
+    }
+
+    // 输出线程当前所在的核和NUMA节点，未绑定的线程之后可能会被调度到其他核
+    unsigned int curCpu = 0;
+    unsigned int curNode = 0;
+    if (syscall(SYS_getcpu, &curCpu, &curNode, NULL) == 0) {
+        LOG("ThreadPlacement -- %s thread %d on cpu %u node %u%s\n", g_roleNames[role], index, curCpu, curNode, cpu >= 0 ? "" : " (not bound)");
+    }
+#else
+    if (cpu >= 0) {
+        WARN_LOG("ThreadPlacement::apply() -- binding cpu is not supported on this platform\n");
+    }
+#endif
+}
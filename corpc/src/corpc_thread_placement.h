@@ -0,0 +1,59 @@
+/*
+ * Created by Xianke Liu on 2026/10/17.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef corpc_thread_placement_h
+#define corpc_thread_placement_h
+
+#include <stdint.h>
+#include <vector>
+
+namespace corpc {
+    // 线程角色，按角色配置线程绑定的CPU
+    enum ThreadRole {
+        THREAD_ROLE_RECEIVER,   // IO接收线程
+        THREAD_ROLE_SENDER,     // IO发送线程
+        THREAD_ROLE_WORKER,     // MultiThreadWorker消息处理线程
+        THREAD_ROLE_INNER_RPC,  // InnerRpcServer请求处理线程
+        THREAD_ROLE_RPC_CLIENT, // RpcClient线程
+        THREAD_ROLE_NUM
+    };
+
+    // 线程绑核配置（需在创建相应线程前设置，即IO::create、Worker::start等之前）
+    // 线程绑核后，线程中之后创建的共享栈、线程共享缓冲区等都在线程开始后才分配，因此会落在所在核的NUMA节点上；
+    // 另外可把内存分配策略设为优先本地节点，避免进程级的交错分配等策略把它们分配到远端节点
+    class ThreadPlacement {
+    public:
+        // 角色的第i个线程绑定到cpus[i % cpus.size()]，cpus为空时不绑定（默认）
+        // 接收线程和发送线程配置相同的CPU列表时，同一连接的收发线程在同一核上（收发线程数相同时IO为连接分配相同下标的收发线程）
+        static void setCpus(ThreadRole role, const std::vector<int>& cpus);
+        static const std::vector<int>& getCpus(ThreadRole role) { return _cpus[role]; }
+
+        // 绑核的线程是否把内存分配策略设为优先所在NUMA节点（默认开启）
+        static void setNumaLocal(bool numaLocal) { _numaLocal = numaLocal; }
+
+        static int getCpu(ThreadRole role, uint16_t index); // 角色的第index个线程绑定的CPU，未绑定时返回-1
+        static int getNode(int cpu); // CPU所在的NUMA节点，未知时返回-1
+
+        // 在新线程开始时（创建协程环境之前）调用：按配置绑核、设置内存分配策略，并输出线程所在的核和NUMA节点
+        static void apply(ThreadRole role, uint16_t index);
+
+    private:
+        static std::vector<int> _cpus[THREAD_ROLE_NUM];
+        static bool _numaLocal;
+    };
+}
+
+#endif /* corpc_thread_placement_h */
@@ -137,6 +137,37 @@ namespace corpc {
         
         return 0;
     }
+    
+    int setNoDelay(int fd, bool on)
+    {
+        int val = on ? 1 : 0;
+        
+        if (setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &val, sizeof(val)) < 0) {
+            ERROR_LOG("setsockopt TCP_NODELAY: %s\n", strerror(errno));
+            return -1;
+        }
+        
+        return 0;
+    }
+    
+    int setCork(int fd, bool on)
+    {
+        int val = on ? 1 : 0;
+        
+#if defined( __APPLE__ ) || defined( __FreeBSD__ )
+        if (setsockopt(fd, IPPROTO_TCP, TCP_NOPUSH, &val, sizeof(val)) < 0) {
+            ERROR_LOG("setsockopt TCP_NOPUSH: %s\n", strerror(errno));
+            return -1;
+        }
+#else
+        if (setsockopt(fd, IPPROTO_TCP, TCP_CORK, &val, sizeof(val)) < 0) {
+            ERROR_LOG("setsockopt TCP_CORK: %s\n", strerror(errno));
+            return -1;
+        }
+#endif
+        
+        return 0;
+    }
 
     void callDoneHandle(::google::protobuf::Message *request, corpc::Controller *controller) {
         delete controller;
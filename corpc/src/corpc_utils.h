@@ -22,15 +22,14 @@
 #include <sys/poll.h>
 #include <sys/time.h>
 
+#include "co_routine.h"
 #include "corpc_controller.h"
 // 注意：若这里不包含message.h会产生内存泄露，callDoneHandle中释放request时没有释放正确的对象
 #include <google/protobuf/message.h>
 
 inline void msleep(int msec)
 {
-    struct pollfd pf = { 0 };
-    pf.fd = -1;
-    poll( &pf,1,msec );
+    co_sleep_ms( msec );
 }
 
 inline uint64_t mtime()
@@ -45,6 +44,8 @@ inline uint64_t mtime()
 
 namespace corpc {
     int setKeepAlive(int fd, int interval);
+    int setNoDelay(int fd, bool on);
+    int setCork(int fd, bool on); // 打开后内核攒满报文段才发送，关闭时立即发出剩余数据
     
     void callDoneHandle(::google::protobuf::Message *request, corpc::Controller *controller);
     void callDoneHandle(::google::protobuf::Message *request);
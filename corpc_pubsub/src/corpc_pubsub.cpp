@@ -176,22 +176,21 @@ void *PubsubService::registerRoutine(void *arg) {
 
     TopicRegisterMessageQueue& queue = self->_queue;
 
-    int readFd = queue.getReadFd();
-    co_register_fd(readFd);
-    co_set_timeout(readFd, -1, 1000);
+    int notifyFd = queue.getNotifyFd();
+    co_register_fd(notifyFd);
+    co_set_timeout(notifyFd, -1, 1000);
     int ret;
-    std::vector<char> buf(1024);
     while (true) {
         // 等待处理信号
-        ret = (int)read(readFd, &buf[0], 1024);
+        ret = queue.wait();
         assert(ret != 0);
         if (ret < 0) {
             if (errno == EAGAIN) {
                 continue;
             } else {
-                // 管道出错
-                ERROR_LOG("PubsubService::registerRoutine read from pipe fd %d ret %d errno %d (%s)\n",
-                       readFd, ret, errno, strerror(errno));
+                // 通知fd出错
+                ERROR_LOG("PubsubService::registerRoutine wait on notify fd %d ret %d errno %d (%s)\n",
+                       notifyFd, ret, errno, strerror(errno));
                 
                 // TODO: 如何处理？退出协程？
                 // sleep 10 milisecond
@@ -282,22 +281,21 @@ void *SubscribeEnv::deamonRoutine(void *arg) {
 
     TopicMessageQueue& queue = self->_queue;
 
-    int readFd = queue.getReadFd();
-    co_register_fd(readFd);
-    co_set_timeout(readFd, -1, 1000);
+    int notifyFd = queue.getNotifyFd();
+    co_register_fd(notifyFd);
+    co_set_timeout(notifyFd, -1, 1000);
     int ret;
-    std::vector<char> buf(1024);
     while (true) {
         // 等待处理信号
-        ret = (int)read(readFd, &buf[0], 1024);
+        ret = queue.wait();
         assert(ret != 0);
         if (ret < 0) {
             if (errno == EAGAIN) {
                 continue;
             } else {
-                // 管道出错
-                ERROR_LOG("SubscribeEnv::deamonRoutine read from pipe fd %d ret %d errno %d (%s)\n",
-                       readFd, ret, errno, strerror(errno));
+                // 通知fd出错
+                ERROR_LOG("SubscribeEnv::deamonRoutine wait on notify fd %d ret %d errno %d (%s)\n",
+                       notifyFd, ret, errno, strerror(errno));
                 
                 // TODO: 如何处理？退出协程？
                 // sleep 10 milisecond
@@ -116,7 +116,7 @@ int main(int argc, const char * argv[])
 
     if(argc<3){
         printf("Usage:\n"
-               "echoUdpclt [HOST] [PORT]\n");
+               "echoUdpclt [HOST] [PORT] [THREAD_NUM] [CLIENT_PER_THREAD]\n");
         return -1;
     }
     
@@ -128,8 +128,8 @@ int main(int argc, const char * argv[])
     sigaction( SIGPIPE, &sa, NULL );
 
     // 启动多个线程创建client
-    int threadNum = 4;
-    int clientPerThread = 20;
+    int threadNum = argc > 3 ? atoi(argv[3]) : 4;
+    int clientPerThread = argc > 4 ? atoi(argv[4]) : 20;
     std::vector<std::thread> threads;
     for (int i = 0; i < threadNum; i++) {
         threads.push_back(std::thread(testThread, host, port, clientPerThread));
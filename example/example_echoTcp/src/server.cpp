@@ -14,6 +14,7 @@
 #include <signal.h>
 #include <map>
 #include <stdlib.h>
+#include <string.h>
 
 #include <google/protobuf/message.h>
 #include "corpc_crypter.h"
@@ -98,13 +99,24 @@ int main(int argc, const char * argv[]) {
     co_start_hook();
     if(argc<3){
         LOG("Usage:\n"
-               "rpcsvr [IP] [PORT]\n");
+               "rpcsvr [IP] [PORT] [epoll|uring|reactor]\n");
         return -1;
     }
     
     std::string ip = argv[1];
     unsigned short int port = atoi(argv[2]);
     
+    // 可选使用io_uring后端，内核不支持时自动退回epoll；reactor模式由事件循环回调直接驱动连接收发，不创建连接协程
+    bool reactor = false;
+    if (argc > 3 && strcmp(argv[3], "uring") == 0) {
+        if (!co_enable_uring(true)) {
+            WARN_LOG("io_uring not supported, fallback to epoll\n");
+        }
+    } else if (argc > 3 && strcmp(argv[3], "reactor") == 0) {
+        reactor = true;
+    }
+    LOG("io backend: %s%s\n", co_is_uring_enabled() ? "io_uring" : "epoll", reactor ? " (reactor)" : "");
+    
     struct sigaction sa;
     sa.sa_handler = SIG_IGN;
     sigaction( SIGPIPE, &sa, NULL );
@@ -115,7 +127,7 @@ int main(int argc, const char * argv[]) {
     std::shared_ptr<corpc::Crypter> crypter = std::shared_ptr<corpc::Crypter>(new corpc::SimpleXORCrypter(key));
 
     // 注册服务
-    corpc::IO *io = corpc::IO::create(1, 1);
+    corpc::IO *io = corpc::IO::create(1, 1, reactor);
     
     corpc::TcpMessageServer *server = new corpc::TcpMessageServer(io, true, true, true, true, ip, port);
     server->start();
@@ -0,0 +1,186 @@
+/*
+ * Created by Xianke Liu on 2026/10/17.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// 比较逐连接send与ConnectionGroup::broadcast向大量连接广播同一消息的耗时
+// 用法: ./test [connectionNum] [rounds] [messageSize] [port]
+
+#include "corpc_routine_env.h"
+#include "corpc_message_server.h"
+#include "corpc_utils.h"
+
+#include <thread>
+#include <atomic>
+#include <vector>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <sys/time.h>
+#include <google/protobuf/wrappers.pb.h>
+
+using namespace corpc;
+
+static int g_connNum = 1000;
+static int g_rounds = 200;
+static int g_msgSize = 200;
+static uint16_t g_port = 21300;
+static std::atomic<int> g_connected(0);
+static std::atomic<uint64_t> g_recvBytes(0);
+
+static std::vector<std::shared_ptr<MessageServer::Connection>> g_conns;
+
+static uint64_t utime() {
+    struct timeval t;
+    gettimeofday(&t, NULL);
+    return t.tv_sec * 1000000 + t.tv_usec;
+}
+
+static uint64_t cputime() {
+    struct rusage ru;
+    getrusage(RUSAGE_SELF, &ru);
+    return (ru.ru_utime.tv_sec + ru.ru_stime.tv_sec) * 1000000 + ru.ru_utime.tv_usec + ru.ru_stime.tv_usec;
+}
+
+// 在非协程线程中建立连接并接收所有数据（不走hook）
+static void clientThread() {
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(g_port);
+    addr.sin_addr.s_addr = inet_addr("127.0.0.1");
+
+    int epfd = epoll_create(1024);
+    for (int i = 0; i < g_connNum; i++) {
+        int fd = socket(AF_INET, SOCK_STREAM, 0);
+        if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+            ERROR_LOG("connect failed, errno %d (%s)\n", errno, strerror(errno));
+            exit(1);
+        }
+        fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+
+        struct epoll_event ev;
+        ev.events = EPOLLIN;
+        ev.data.fd = fd;
+        epoll_ctl(epfd, EPOLL_CTL_ADD, fd, &ev);
+        g_connected++;
+    }
+
+    char buf[0x10000];
+    struct epoll_event events[256];
+    while (true) {
+        int n = epoll_wait(epfd, events, 256, -1);
+        for (int i = 0; i < n; i++) {
+            int ret;
+            while ((ret = (int)read(events[i].data.fd, buf, sizeof(buf))) > 0) {
+                g_recvBytes += ret;
+            }
+        }
+    }
+}
+
+static void waitRecv(uint64_t expect) {
+    while (g_recvBytes < expect) {
+        msleep(1);
+    }
+}
+
+static void *bench_routine( void *arg ) {
+    MessageServer *server = (MessageServer *)arg;
+
+    std::thread t(clientThread);
+    t.detach();
+
+    while (g_conns.size() < (size_t)g_connNum) {
+        msleep(10);
+    }
+
+    std::shared_ptr<google::protobuf::StringValue> msg(new google::protobuf::StringValue);
+    msg->set_value(std::string(g_msgSize, 'x'));
+    uint64_t roundBytes = (uint64_t)g_connNum * (CORPC_MESSAGE_HEAD_SIZE + msg->ByteSizeLong());
+
+    // 逐连接发送
+    uint64_t expect = roundBytes * g_rounds;
+    uint64_t begin = utime();
+    uint64_t cpuBegin = cputime();
+    for (int r = 0; r < g_rounds; r++) {
+        for (auto& conn : g_conns) {
+            conn->send(1, false, false, false, 0, msg);
+        }
+    }
+    waitRecv(expect);
+    LOG("send loop:  connections: %d, rounds: %d, cost: %llu ms, cpu: %llu ms\n", g_connNum, g_rounds,
+        (unsigned long long)(utime() - begin) / 1000, (unsigned long long)(cputime() - cpuBegin) / 1000);
+
+    // 连接组广播
+    MessageServer::ConnectionGroup group(server);
+    for (auto& conn : g_conns) {
+        group.add(conn);
+    }
+
+    expect += roundBytes * g_rounds;
+    begin = utime();
+    cpuBegin = cputime();
+    for (int r = 0; r < g_rounds; r++) {
+        group.broadcast(1, false, false, 0, msg);
+    }
+    waitRecv(expect);
+    LOG("broadcast:  connections: %d, rounds: %d, cost: %llu ms, cpu: %llu ms\n", g_connNum, g_rounds,
+        (unsigned long long)(utime() - begin) / 1000, (unsigned long long)(cputime() - cpuBegin) / 1000);
+
+    exit(0);
+    return NULL;
+}
+
+int main(int argc, const char *argv[]) {
+    co_start_hook();
+
+    if (argc > 1) {
+        g_connNum = atoi(argv[1]);
+    }
+    if (argc > 2) {
+        g_rounds = atoi(argv[2]);
+    }
+    if (argc > 3) {
+        g_msgSize = atoi(argv[3]);
+    }
+    if (argc > 4) {
+        g_port = atoi(argv[4]);
+    }
+
+    struct rlimit rl;
+    getrlimit(RLIMIT_NOFILE, &rl);
+    rl.rlim_cur = rl.rlim_max;
+    setrlimit(RLIMIT_NOFILE, &rl);
+
+    IO *io = IO::create(1, 1);
+
+    TcpMessageServer *server = new TcpMessageServer(io, false, true, false, false, "127.0.0.1", g_port);
+    server->start();
+
+    server->registerMessage(CORPC_MSG_TYPE_CONNECT, nullptr, false, [](int16_t type, uint16_t tag, std::shared_ptr<google::protobuf::Message> msg, std::shared_ptr<MessageServer::Connection> conn) {
+        g_conns.push_back(conn);
+    });
+
+    RoutineEnvironment::startCoroutine(bench_routine, server);
+
+    RoutineEnvironment::runEventLoop();
+
+    return 0;
+}
@@ -0,0 +1,157 @@
+/*
+ * Created by Xianke Liu on 2026/10/17.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// 回归测试：客户端建立连接后立即发送一条消息并关闭（数据和FIN常在同一次可读事件中到达），
+// 检查服务器收到全部消息并关闭全部连接，有未关闭的连接时返回1；
+// persist为1时开启持久化epoll注册（边缘触发），idleMs大于0时先建立全部连接并空闲idleMs毫秒再发送并关闭（服务器已在等待可读）
+// 用法: ./test [reactor(0/1)] [connectionNum] [port] [persist(0/1)] [idleMs]
+
+#include "corpc_routine_env.h"
+#include "corpc_message_server.h"
+#include "corpc_utils.h"
+
+#include <thread>
+#include <atomic>
+#include <vector>
+#include <string>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include <sys/resource.h>
+#include <google/protobuf/wrappers.pb.h>
+
+using namespace corpc;
+
+static bool g_reactor = true;
+static int g_connNum = 200;
+static uint16_t g_port = 22000;
+static bool g_persist = false;
+static int g_idleMs = 0;
+static std::atomic<int> g_connected(0);
+static std::atomic<int> g_received(0);
+static std::atomic<int> g_closed(0);
+
+// 在非协程线程中发送后立即关闭（不走hook）
+static void clientThread() {
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(g_port);
+    addr.sin_addr.s_addr = inet_addr("127.0.0.1");
+
+    google::protobuf::Int64Value msg;
+    msg.set_value(1);
+    std::string body = msg.SerializeAsString();
+    std::string data(CORPC_MESSAGE_HEAD_SIZE, 0);
+    *(uint32_t *)&data[0] = htobe32(body.size());
+    *(uint16_t *)&data[4] = htobe16(1);
+    data.append(body);
+
+    std::vector<int> fds;
+    for (int i = 0; i < g_connNum; i++) {
+        int fd = socket(AF_INET, SOCK_STREAM, 0);
+        if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+            ERROR_LOG("connect failed, errno %d (%s)\n", errno, strerror(errno));
+            exit(1);
+        }
+        fds.push_back(fd);
+
+        if (g_idleMs > 0) {
+            continue;
+        }
+
+        if (write(fd, data.data(), data.size()) != (ssize_t)data.size()) {
+            ERROR_LOG("write failed, errno %d (%s)\n", errno, strerror(errno));
+            exit(1);
+        }
+        close(fd);
+    }
+
+    if (g_idleMs > 0) {
+        usleep(g_idleMs * 1000);
+        for (int fd : fds) {
+            if (write(fd, data.data(), data.size()) != (ssize_t)data.size()) {
+                ERROR_LOG("write failed, errno %d (%s)\n", errno, strerror(errno));
+                exit(1);
+            }
+            close(fd);
+        }
+    }
+
+    // 最多等待5秒
+    for (int i = 0; i < 5000 && g_closed < g_connNum; i++) {
+        usleep(1000);
+    }
+
+    int leaked = g_connected - g_closed;
+    LOG("reactor: %d, persist: %d, idle ms: %d, connections: %d, connected: %d, received: %d, closed: %d, leaked: %d\n",
+        g_reactor, g_persist, g_idleMs, g_connNum, (int)g_connected, (int)g_received, (int)g_closed, leaked);
+
+    exit(leaked == 0 && g_closed == g_connNum ? 0 : 1);
+}
+
+int main(int argc, const char *argv[]) {
+    co_start_hook();
+
+    if (argc > 1) {
+        g_reactor = atoi(argv[1]) != 0;
+    }
+    if (argc > 2) {
+        g_connNum = atoi(argv[2]);
+    }
+    if (argc > 3) {
+        g_port = atoi(argv[3]);
+    }
+    if (argc > 4) {
+        g_persist = atoi(argv[4]) != 0;
+    }
+    if (argc > 5) {
+        g_idleMs = atoi(argv[5]);
+    }
+
+    co_set_persist_poll(g_persist);
+
+    struct rlimit rl;
+    getrlimit(RLIMIT_NOFILE, &rl);
+    rl.rlim_cur = rl.rlim_max;
+    setrlimit(RLIMIT_NOFILE, &rl);
+
+    IO *io = IO::create(1, 1, g_reactor);
+
+    TcpMessageServer *server = new TcpMessageServer(io, false, false, false, false, "127.0.0.1", g_port);
+    server->start();
+
+    server->registerMessage(CORPC_MSG_TYPE_CONNECT, nullptr, false, [](int16_t type, uint16_t tag, std::shared_ptr<google::protobuf::Message> msg, std::shared_ptr<MessageServer::Connection> conn) {
+        g_connected++;
+    });
+
+    server->registerMessage(CORPC_MSG_TYPE_CLOSE, nullptr, false, [](int16_t type, uint16_t tag, std::shared_ptr<google::protobuf::Message> msg, std::shared_ptr<MessageServer::Connection> conn) {
+        g_closed++;
+    });
+
+    server->registerMessage(1, new google::protobuf::Int64Value, false, [](int16_t type, uint16_t tag, std::shared_ptr<google::protobuf::Message> msg, std::shared_ptr<MessageServer::Connection> conn) {
+        g_received++;
+    });
+
+    std::thread t(clientThread);
+    t.detach();
+
+    RoutineEnvironment::runEventLoop();
+
+    return 0;
+}
@@ -0,0 +1,160 @@
+/*
+ * Created by Xianke Liu on 2026/10/17.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// 连接频繁建立和断开：客户端每轮建立batch个连接后全部断开，统计服务器每秒完成的关闭数、
+// 每轮从断开到全部关闭完成的时间，以及关闭过程中未完成关闭的连接数和进程内存
+// 用法: ./test [reactor(0/1)] [batch] [rounds] [port]
+
+#include "corpc_routine_env.h"
+#include "corpc_message_server.h"
+#include "corpc_utils.h"
+
+#include <thread>
+#include <atomic>
+#include <vector>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include <sys/resource.h>
+#include <sys/time.h>
+
+using namespace corpc;
+
+static bool g_reactor = false;
+static int g_batch = 1000;
+static int g_rounds = 20;
+static uint16_t g_port = 21600;
+static std::atomic<int> g_connected(0);
+static std::atomic<int> g_closed(0);
+
+static uint64_t utime() {
+    struct timeval t;
+    gettimeofday(&t, NULL);
+    return t.tv_sec * 1000000 + t.tv_usec;
+}
+
+static long getRSS() {
+    long rss = 0;
+    FILE *fp = fopen("/proc/self/status", "r");
+    if (fp) {
+        char line[256];
+        while (fgets(line, sizeof(line), fp)) {
+            if (strncmp(line, "VmRSS:", 6) == 0) {
+                rss = atol(line + 6) * 1024;
+                break;
+            }
+        }
+        fclose(fp);
+    }
+
+    return rss;
+}
+
+// 在非协程线程中建立和断开连接（不走hook）
+static void churnThread() {
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(g_port);
+    addr.sin_addr.s_addr = inet_addr("127.0.0.1");
+
+    std::vector<int> fds(g_batch);
+    uint64_t closeCost = 0;
+    uint64_t maxCost = 0;
+    int maxPending = 0;
+    long maxRSSDelta = 0;
+    for (int r = 0; r < g_rounds; r++) {
+        for (int i = 0; i < g_batch; i++) {
+            fds[i] = socket(AF_INET, SOCK_STREAM, 0);
+            if (connect(fds[i], (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+                ERROR_LOG("connect failed, errno %d (%s)\n", errno, strerror(errno));
+                exit(1);
+            }
+        }
+
+        int expect = (r + 1) * g_batch;
+        while (g_connected < expect) {
+            usleep(1000);
+        }
+        long rss0 = getRSS();
+
+        uint64_t begin = utime();
+        for (int i = 0; i < g_batch; i++) {
+            close(fds[i]);
+        }
+
+        // 等待服务器关闭全部连接，期间采样未完成关闭的连接数和内存
+        while (g_closed < expect) {
+            maxPending = std::max(maxPending, expect - g_closed);
+            maxRSSDelta = std::max(maxRSSDelta, getRSS() - rss0);
+            usleep(1000);
+        }
+        uint64_t cost = utime() - begin;
+        closeCost += cost;
+        maxCost = std::max(maxCost, cost);
+    }
+
+    int total = g_batch * g_rounds;
+    LOG("reactor: %d, batch: %d, rounds: %d, closes per second: %llu, batch close avg: %llu ms, max: %llu ms, max closing: %d, max rss held while closing: %ld KB\n",
+        g_reactor, g_batch, g_rounds, (unsigned long long)total * 1000000 / (closeCost ? closeCost : 1),
+        (unsigned long long)closeCost / g_rounds / 1000, (unsigned long long)maxCost / 1000, maxPending, maxRSSDelta / 1024);
+
+    exit(0);
+}
+
+int main(int argc, const char *argv[]) {
+    co_start_hook();
+
+    if (argc > 1) {
+        g_reactor = atoi(argv[1]) != 0;
+    }
+    if (argc > 2) {
+        g_batch = atoi(argv[2]);
+    }
+    if (argc > 3) {
+        g_rounds = atoi(argv[3]);
+    }
+    if (argc > 4) {
+        g_port = atoi(argv[4]);
+    }
+
+    struct rlimit rl;
+    getrlimit(RLIMIT_NOFILE, &rl);
+    rl.rlim_cur = rl.rlim_max;
+    setrlimit(RLIMIT_NOFILE, &rl);
+
+    IO *io = IO::create(1, 1, g_reactor);
+
+    TcpMessageServer *server = new TcpMessageServer(io, false, false, false, false, "127.0.0.1", g_port);
+    server->start();
+
+    server->registerMessage(CORPC_MSG_TYPE_CONNECT, nullptr, false, [](int16_t type, uint16_t tag, std::shared_ptr<google::protobuf::Message> msg, std::shared_ptr<MessageServer::Connection> conn) {
+        g_connected++;
+    });
+
+    server->registerMessage(CORPC_MSG_TYPE_CLOSE, nullptr, false, [](int16_t type, uint16_t tag, std::shared_ptr<google::protobuf::Message> msg, std::shared_ptr<MessageServer::Connection> conn) {
+        g_closed++;
+    });
+
+    std::thread t(churnThread);
+    t.detach();
+
+    RoutineEnvironment::runEventLoop();
+
+    return 0;
+}
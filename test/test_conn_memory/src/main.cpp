@@ -0,0 +1,133 @@
+/*
+ * Created by Xianke Liu on 2026/10/17.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// 建立大量空闲连接，输出服务器每个连接占用的内存
+// 用法: ./test [connectionNum] [port] [uring(1:开启io_uring)]
+
+#include "corpc_routine_env.h"
+#include "corpc_message_server.h"
+#include "corpc_utils.h"
+
+#include <thread>
+#include <atomic>
+#include <vector>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include <sys/resource.h>
+
+using namespace corpc;
+
+static int g_connNum = 2000;
+static uint16_t g_port = 21000;
+static std::atomic<int> g_connected(0);
+
+static long getRSS() {
+    long rss = 0;
+    FILE *fp = fopen("/proc/self/status", "r");
+    if (fp) {
+        char line[256];
+        while (fgets(line, sizeof(line), fp)) {
+            if (strncmp(line, "VmRSS:", 6) == 0) {
+                rss = atol(line + 6) * 1024;
+                break;
+            }
+        }
+        fclose(fp);
+    }
+    
+    return rss;
+}
+
+// 在非协程线程中建立连接（不走hook）
+static void connectThread() {
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(g_port);
+    addr.sin_addr.s_addr = inet_addr("127.0.0.1");
+    
+    std::vector<int> fds;
+    for (int i = 0; i < g_connNum; i++) {
+        int fd = socket(AF_INET, SOCK_STREAM, 0);
+        if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+            ERROR_LOG("connect failed, errno %d (%s)\n", errno, strerror(errno));
+            close(fd);
+            break;
+        }
+        fds.push_back(fd);
+        g_connected++;
+    }
+    
+    // 保持连接直到进程退出
+    while (true) {
+        sleep(100);
+    }
+}
+
+static void *bench_routine( void *arg ) {
+    sleep(1);
+    long rss0 = getRSS();
+    
+    std::thread t(connectThread);
+    t.detach();
+    
+    while (g_connected < g_connNum) {
+        sleep(1);
+    }
+    sleep(2); // 等待服务器完成连接初始化
+    
+    long rss1 = getRSS();
+    LOG("connections: %d, rss before: %ld KB, rss after: %ld KB, bytes per connection: %ld\n",
+        g_connNum, rss0 / 1024, rss1 / 1024, (rss1 - rss0) / g_connNum);
+    
+    exit(0);
+    return NULL;
+}
+
+int main(int argc, const char *argv[]) {
+    co_start_hook();
+    
+    if (argc > 1) {
+        g_connNum = atoi(argv[1]);
+    }
+    if (argc > 2) {
+        g_port = atoi(argv[2]);
+    }
+    if (argc > 3 && atoi(argv[3]) && !co_enable_uring(true)) {
+        LOG("io_uring is not supported\n");
+    }
+    
+    struct rlimit rl;
+    getrlimit(RLIMIT_NOFILE, &rl);
+    rl.rlim_cur = rl.rlim_max;
+    setrlimit(RLIMIT_NOFILE, &rl);
+    
+    IO *io = IO::create(1, 1);
+    
+    TcpMessageServer *server = new TcpMessageServer(io, false, false, false, false, "127.0.0.1", g_port);
+    server->start();
+    
+    server->registerMessage(CORPC_MSG_TYPE_CONNECT, nullptr, false, [](int16_t type, uint16_t tag, std::shared_ptr<google::protobuf::Message> msg, std::shared_ptr<MessageServer::Connection> conn) {});
+    
+    RoutineEnvironment::startCoroutine(bench_routine, NULL);
+    
+    RoutineEnvironment::runEventLoop();
+    
+    return 0;
+}
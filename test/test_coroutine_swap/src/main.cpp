@@ -23,7 +23,7 @@
 using namespace corpc;
 
 bool g_start = false;
-pid_t g_pid = 0;
+RoutineEnvironment *g_env = nullptr;
 stCoRoutine_t *g_co = nullptr;
 uint64_t g_count = 0;
 
@@ -57,6 +57,7 @@ static void *thread2_routine( void *arg )
 {
     uint64_t sleepTm = (uint64_t)arg;
     pid_t pid = GetPid();
+    RoutineEnvironment *env = RoutineEnvironment::getEnv();
     stCoRoutine_t *co = co_self();
     LOG("thread2_routine begin, pid:%d, co: %d\n", pid, co);
 
@@ -66,14 +67,14 @@ static void *thread2_routine( void *arg )
     
     while (true)
     {
-        pid_t old_pid = g_pid;
+        RoutineEnvironment *old_env = g_env;
         stCoRoutine_t *old_co = g_co;
 
-        g_pid = pid;
+        g_env = env;
         g_co = co;
 
         if (old_co) {
-            RoutineEnvironment::resumeCoroutine(old_pid, old_co, 0);
+            RoutineEnvironment::resumeCoroutine(old_env, old_co, 0);
         }
 
         co_yield_ct();
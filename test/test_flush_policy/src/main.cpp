@@ -0,0 +1,200 @@
+/*
+ * Created by Xianke Liu on 2026/10/17.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// 在不同发送刷新策略下，客户端以固定速率发送请求，服务器对每个请求回复burst条小消息，
+// 输出每条消息的写系统调用数以及请求往返时延的p50/p99
+// 用法: ./test [mode(0:IMMEDIATE 1:COALESCE 2:CORK)] [noDelay] [connectionNum] [requestsPerSecond] [burst] [seconds] [port]
+
+#include "corpc_routine_env.h"
+#include "corpc_message_server.h"
+#include "corpc_utils.h"
+
+#include <thread>
+#include <vector>
+#include <algorithm>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <arpa/inet.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <sys/epoll.h>
+#include <sys/time.h>
+#include <google/protobuf/wrappers.pb.h>
+
+using namespace corpc;
+
+static int g_mode = 0;
+static bool g_noDelay = true;
+static int g_connNum = 50;
+static int g_rate = 20000;
+static int g_burst = 4;
+static int g_seconds = 5;
+static uint16_t g_port = 21400;
+
+static IO *g_io = nullptr;
+
+static uint64_t utime() {
+    struct timeval t;
+    gettimeofday(&t, NULL);
+    return t.tv_sec * 1000000 + t.tv_usec;
+}
+
+static void sendRequest(int fd, uint64_t now) {
+    google::protobuf::Int64Value req;
+    req.set_value(now);
+    std::string body = req.SerializeAsString();
+
+    uint8_t buf[CORPC_MESSAGE_HEAD_SIZE + 32];
+    memset(buf, 0, CORPC_MESSAGE_HEAD_SIZE);
+    *(uint32_t *)buf = htobe32(body.size());
+    *(uint16_t *)(buf + 4) = htobe16(1);
+    memcpy(buf + CORPC_MESSAGE_HEAD_SIZE, body.data(), body.size());
+
+    if (write(fd, buf, CORPC_MESSAGE_HEAD_SIZE + body.size()) < 0) {
+        ERROR_LOG("write request failed, errno %d (%s)\n", errno, strerror(errno));
+        exit(1);
+    }
+}
+
+// 在非协程线程中运行客户端（不走hook）
+static void clientThread() {
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(g_port);
+    addr.sin_addr.s_addr = inet_addr("127.0.0.1");
+
+    int epfd = epoll_create(1024);
+    std::vector<int> fds;
+    std::vector<std::string> bufs(g_connNum);
+    for (int i = 0; i < g_connNum; i++) {
+        int fd = socket(AF_INET, SOCK_STREAM, 0);
+        if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+            ERROR_LOG("connect failed, errno %d (%s)\n", errno, strerror(errno));
+            exit(1);
+        }
+        int val = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &val, sizeof(val));
+        fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+
+        struct epoll_event ev;
+        ev.events = EPOLLIN;
+        ev.data.u32 = i;
+        epoll_ctl(epfd, EPOLL_CTL_ADD, fd, &ev);
+        fds.push_back(fd);
+    }
+    usleep(500000); // 等待服务器完成连接初始化
+
+    uint64_t interval = 1000000 / g_rate;
+    uint64_t begin = utime();
+    uint64_t end = begin + g_seconds * 1000000ULL;
+    uint64_t nextSend = begin;
+    int next = 0;
+
+    uint64_t msgStart = g_io->getSender()->getSentMessageNum();
+    uint64_t writeStart = g_io->getSender()->getWriteNum();
+
+    std::vector<uint32_t> rtts;
+    char rbuf[0x10000];
+    struct epoll_event events[256];
+    uint64_t now;
+    while ((now = utime()) < end) {
+        while (nextSend <= now) {
+            sendRequest(fds[next], nextSend);
+            next = (next + 1) % g_connNum;
+            nextSend += interval;
+        }
+
+        int n = epoll_wait(epfd, events, 256, (int)((nextSend - now) / 1000));
+        for (int i = 0; i < n; i++) {
+            int idx = events[i].data.u32;
+            std::string &pending = bufs[idx];
+            int ret;
+            while ((ret = (int)read(fds[idx], rbuf, sizeof(rbuf))) > 0) {
+                pending.append(rbuf, ret);
+            }
+
+            // 解析完整的回复，tag为1的是一次请求的最后一条回复，记录往返时延
+            size_t offset = 0;
+            while (pending.size() - offset >= CORPC_MESSAGE_HEAD_SIZE) {
+                const uint8_t *head = (const uint8_t *)pending.data() + offset;
+                uint32_t size = be32toh(*(uint32_t *)head);
+                if (pending.size() - offset < CORPC_MESSAGE_HEAD_SIZE + size) {
+                    break;
+                }
+
+                if (be16toh(*(uint16_t *)(head + 6)) == 1) {
+                    google::protobuf::Int64Value resp;
+                    resp.ParseFromArray(head + CORPC_MESSAGE_HEAD_SIZE, size);
+                    rtts.push_back((uint32_t)(utime() - resp.value()));
+                }
+                offset += CORPC_MESSAGE_HEAD_SIZE + size;
+            }
+            pending.erase(0, offset);
+        }
+    }
+
+    uint64_t msgNum = g_io->getSender()->getSentMessageNum() - msgStart;
+    uint64_t writeNum = g_io->getSender()->getWriteNum() - writeStart;
+
+    std::sort(rtts.begin(), rtts.end());
+    const char *modeNames[] = {"IMMEDIATE", "COALESCE", "CORK"};
+    LOG("policy: %s, noDelay: %d, messages: %llu, syscalls per message: %.3f, rtt p50: %u us, p99: %u us\n",
+        modeNames[g_mode], g_noDelay, (unsigned long long)msgNum, msgNum ? (double)writeNum / msgNum : 0.0,
+        rtts.empty() ? 0 : rtts[rtts.size() / 2], rtts.empty() ? 0 : rtts[rtts.size() * 99 / 100]);
+
+    exit(0);
+}
+
+int main(int argc, const char *argv[]) {
+    co_start_hook();
+
+    if (argc > 1) g_mode = atoi(argv[1]);
+    if (argc > 2) g_noDelay = atoi(argv[2]) != 0;
+    if (argc > 3) g_connNum = atoi(argv[3]);
+    if (argc > 4) g_rate = atoi(argv[4]);
+    if (argc > 5) g_burst = atoi(argv[5]);
+    if (argc > 6) g_seconds = atoi(argv[6]);
+    if (argc > 7) g_port = atoi(argv[7]);
+
+    g_io = IO::create(1, 1);
+
+    TcpMessageServer *server = new TcpMessageServer(g_io, false, false, false, false, "127.0.0.1", g_port);
+
+    FlushPolicy policy;
+    policy.mode = (FlushPolicy::Mode)g_mode;
+    policy.noDelay = g_noDelay;
+    server->setFlushPolicy(policy);
+
+    server->start();
+
+    server->registerMessage(CORPC_MSG_TYPE_CONNECT, nullptr, false, [](int16_t type, uint16_t tag, std::shared_ptr<google::protobuf::Message> msg, std::shared_ptr<MessageServer::Connection> conn) {});
+
+    server->registerMessage(1, new google::protobuf::Int64Value, false, [](int16_t type, uint16_t tag, std::shared_ptr<google::protobuf::Message> msg, std::shared_ptr<MessageServer::Connection> conn) {
+        for (int i = 0; i < g_burst; i++) {
+            conn->send(2, false, false, false, i == g_burst - 1 ? 1 : 0, msg);
+        }
+    });
+
+    std::thread t(clientThread);
+    t.detach();
+
+    RoutineEnvironment::runEventLoop();
+
+    return 0;
+}
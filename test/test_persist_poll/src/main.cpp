@@ -0,0 +1,149 @@
+/*
+ * Created by Xianke Liu on 2026/10/17.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// 对比普通poll模式与持久化epoll注册模式下每条消息的系统调用次数
+// 用法: ./test [pairNum] [msgNum]
+
+#include "corpc_utils.h"
+#include "corpc_routine_env.h"
+
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+using namespace corpc;
+
+#define MSG_SIZE 64
+
+static int g_pairNum = 100;
+static int g_msgNum = 10000;
+static int g_finishNum = 0;
+
+static void *echo_routine( void *arg )
+{
+    int fd = (int)(intptr_t)arg;
+    co_register_fd(fd);
+    co_set_timeout(fd, -1, 1000);
+
+    char buf[MSG_SIZE];
+    while (true) {
+        int ret = read(fd, buf, MSG_SIZE);
+        if (ret <= 0) {
+            break;
+        }
+        
+        if (write(fd, buf, ret) != ret) {
+            break;
+        }
+    }
+    
+    close(fd);
+    return NULL;
+}
+
+static void *ping_routine( void *arg )
+{
+    int fd = (int)(intptr_t)arg;
+    co_register_fd(fd);
+    co_set_timeout(fd, -1, 1000);
+
+    char buf[MSG_SIZE] = {0};
+    for (int i = 0; i < g_msgNum; i++) {
+        if (write(fd, buf, MSG_SIZE) != MSG_SIZE) {
+            ERROR_LOG("write failed\n");
+            break;
+        }
+
+        int received = 0;
+        while (received < MSG_SIZE) {
+            int ret = read(fd, buf + received, MSG_SIZE - received);
+            if (ret <= 0) {
+                ERROR_LOG("read failed\n");
+                break;
+            }
+            received += ret;
+        }
+    }
+    
+    close(fd);
+    g_finishNum++;
+    return NULL;
+}
+
+static void runCase(bool persist) {
+    co_set_persist_poll(persist);
+    
+    stCoStat_t begin = *co_get_stat_ct();
+    struct timeval t1, t2;
+    gettimeofday(&t1, NULL);
+
+    g_finishNum = 0;
+    for (int i = 0; i < g_pairNum; i++) {
+        int fds[2];
+        if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) < 0) {
+            ERROR_LOG("socketpair failed\n");
+            exit(-1);
+        }
+        
+        RoutineEnvironment::startCoroutine(echo_routine, (void*)(intptr_t)fds[0]);
+        RoutineEnvironment::startCoroutine(ping_routine, (void*)(intptr_t)fds[1]);
+    }
+    
+    while (g_finishNum < g_pairNum) {
+        msleep(10);
+    }
+    
+    gettimeofday(&t2, NULL);
+    stCoStat_t *end = co_get_stat_ct();
+    
+    // 每条消息包括一次请求和一次回应
+    double msgs = (double)g_pairNum * g_msgNum * 2;
+    unsigned long long ioCnt = end->ullIoSysCallCnt - begin.ullIoSysCallCnt;
+    unsigned long long ctlCnt = end->ullEpollCtlCnt - begin.ullEpollCtlCnt;
+    unsigned long long waitCnt = end->ullEpollWaitCnt - begin.ullEpollWaitCnt;
+    double cost = (t2.tv_sec - t1.tv_sec) + (t2.tv_usec - t1.tv_usec) / 1000000.0;
+    
+    LOG("%s mode: %.0f msgs in %.3fs (%.0f msgs/s), syscalls per msg: %.2f (io %.2f, epoll_ctl %.2f, epoll_wait %.2f)\n",
+        persist ? "persist" : "poll", msgs, cost, msgs / cost,
+        (ioCnt + ctlCnt + waitCnt) / msgs, ioCnt / msgs, ctlCnt / msgs, waitCnt / msgs);
+}
+
+static void *test_routine( void *arg )
+{
+    runCase(false);
+    runCase(true);
+    
+    exit(0);
+    return NULL;
+}
+
+int main(int argc, const char * argv[]) {
+    if (argc > 1) {
+        g_pairNum = atoi(argv[1]);
+    }
+    
+    if (argc > 2) {
+        g_msgNum = atoi(argv[2]);
+    }
+    
+    co_start_hook();
+    
+    RoutineEnvironment::startCoroutine(test_routine, NULL);
+
+    RoutineEnvironment::runEventLoop();
+    
+    return 0;
+}
@@ -0,0 +1,213 @@
+/*
+ * Created by Xianke Liu on 2026/10/17.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// 在不同连接分配策略下，先建立hot个持续发送大量数据的连接，再建立light个空闲连接，
+// 输出各IO线程的连接数和每秒字节数、与热连接在同一线程的空闲连接数，
+// 以及AFFINITY策略下（按客户端端口每group个连接一组）被拆分到多个线程的组数
+// 用法: ./test [policy(0:ROUND_ROBIN 1:LEAST_CONNECTIONS 2:LEAST_BYTES 3:AFFINITY 4:INCOMING_CPU)] [hot] [light] [threadNum] [group] [port]
+
+#include "corpc_routine_env.h"
+#include "corpc_message_server.h"
+#include "corpc_utils.h"
+
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <vector>
+#include <algorithm>
+#include <map>
+#include <set>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include <google/protobuf/wrappers.pb.h>
+
+using namespace corpc;
+
+static int g_policy = 0;
+static int g_hot = 2;
+static int g_light = 200;
+static int g_threadNum = 4;
+static int g_group = 10;
+static uint16_t g_port = 21700;
+
+static IO *g_io = nullptr;
+static std::atomic<int> g_connected(0);
+
+static std::mutex g_lock;
+static std::vector<int> g_hotPorts;
+static std::map<int, int> g_portThreads; // 客户端端口 -> 接收线程下标
+
+static int connectServer() {
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(g_port);
+    addr.sin_addr.s_addr = inet_addr("127.0.0.1");
+
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+        ERROR_LOG("connect failed, errno %d (%s)\n", errno, strerror(errno));
+        exit(1);
+    }
+
+    return fd;
+}
+
+static int socketPort(int fd, bool peer) {
+    struct sockaddr_in addr;
+    socklen_t len = sizeof(addr);
+    if (peer) {
+        getpeername(fd, (struct sockaddr *)&addr, &len);
+    } else {
+        getsockname(fd, (struct sockaddr *)&addr, &len);
+    }
+
+    return ntohs(addr.sin_port);
+}
+
+// 热连接：在非协程线程中不停地发送消息（不走hook）
+static void hotThread(int fd) {
+    google::protobuf::StringValue msg;
+    msg.set_value(std::string(4000, 'x'));
+    std::string body = msg.SerializeAsString();
+
+    std::string data;
+    for (int i = 0; i < 16; i++) {
+        uint8_t head[CORPC_MESSAGE_HEAD_SIZE];
+        memset(head, 0, CORPC_MESSAGE_HEAD_SIZE);
+        *(uint32_t *)head = htobe32(body.size());
+        *(uint16_t *)(head + 4) = htobe16(1);
+        data.append((char *)head, CORPC_MESSAGE_HEAD_SIZE);
+        data.append(body);
+    }
+
+    while (write(fd, data.data(), data.size()) > 0) {
+    }
+}
+
+static void waitConnected(int expect) {
+    while (g_connected < expect) {
+        usleep(1000);
+    }
+}
+
+static void printLoads(const char *title, std::vector<ThreadLoad> &loads) {
+    for (size_t i = 0; i < loads.size(); i++) {
+        LOG("%s thread %d: connections: %u, bytes per second: %llu\n", title, (int)i, loads[i].connectionNum, (unsigned long long)loads[i].bytesPerSecond);
+    }
+}
+
+static void clientThread() {
+    std::vector<int> fds;
+    for (int i = 0; i < g_hot; i++) {
+        int fd = connectServer();
+        {
+            std::unique_lock<std::mutex> lock(g_lock);
+            g_hotPorts.push_back(socketPort(fd, false));
+        }
+        std::thread(hotThread, fd).detach();
+        fds.push_back(fd);
+    }
+    waitConnected(g_hot);
+
+    // 等IO线程的负载采样统计出热连接的速率
+    sleep(2);
+
+    for (int i = 0; i < g_light; i++) {
+        fds.push_back(connectServer());
+    }
+    waitConnected(g_hot + g_light);
+    sleep(1);
+
+    std::vector<ThreadLoad> recvLoads;
+    std::vector<ThreadLoad> sendLoads;
+    g_io->getReceiver()->getThreadLoads(recvLoads);
+    g_io->getSender()->getThreadLoads(sendLoads);
+    printLoads("receive", recvLoads);
+    printLoads("send", sendLoads);
+
+    std::unique_lock<std::mutex> lock(g_lock);
+    std::set<int> hotThreads;
+    for (int port : g_hotPorts) {
+        hotThreads.insert(g_portThreads[port]);
+    }
+
+    int lightWithHot = 0;
+    std::map<int, std::set<int>> groupThreads;
+    for (auto& kv : g_portThreads) {
+        groupThreads[kv.first / g_group].insert(kv.second);
+
+        if (std::find(g_hotPorts.begin(), g_hotPorts.end(), kv.first) == g_hotPorts.end() && hotThreads.count(kv.second)) {
+            lightWithHot++;
+        }
+    }
+
+    int splitGroups = 0;
+    for (auto& kv : groupThreads) {
+        if (kv.second.size() > 1) {
+            splitGroups++;
+        }
+    }
+
+    const char *policyNames[] = {"ROUND_ROBIN", "LEAST_CONNECTIONS", "LEAST_BYTES", "AFFINITY", "INCOMING_CPU"};
+    LOG("policy: %s, hot: %d, light: %d, light connections on hot threads: %d, split groups: %d/%d\n",
+        policyNames[g_policy], g_hot, g_light, lightWithHot, splitGroups, (int)groupThreads.size());
+
+    exit(0);
+}
+
+int main(int argc, const char *argv[]) {
+    co_start_hook();
+
+    if (argc > 1) g_policy = atoi(argv[1]);
+    if (argc > 2) g_hot = atoi(argv[2]);
+    if (argc > 3) g_light = atoi(argv[3]);
+    if (argc > 4) g_threadNum = atoi(argv[4]);
+    if (argc > 5) g_group = atoi(argv[5]);
+    if (argc > 6) g_port = atoi(argv[6]);
+
+    g_io = IO::create(g_threadNum, g_threadNum);
+
+    PlacementPolicy policy;
+    policy.mode = (PlacementPolicy::Mode)g_policy;
+    policy.affinity = [](std::shared_ptr<Connection>& connection) -> uint64_t {
+        return socketPort(connection->getfd(), true) / g_group;
+    };
+    g_io->setPlacementPolicy(policy);
+
+    TcpMessageServer *server = new TcpMessageServer(g_io, false, false, false, false, "127.0.0.1", g_port);
+    server->start();
+
+    server->registerMessage(CORPC_MSG_TYPE_CONNECT, nullptr, false, [](int16_t type, uint16_t tag, std::shared_ptr<google::protobuf::Message> msg, std::shared_ptr<MessageServer::Connection> conn) {
+        {
+            std::unique_lock<std::mutex> lock(g_lock);
+            g_portThreads[socketPort(conn->getfd(), true)] = conn->getRecvThreadIndex();
+        }
+        g_connected++;
+    });
+
+    server->registerMessage(1, new google::protobuf::StringValue, false, [](int16_t type, uint16_t tag, std::shared_ptr<google::protobuf::Message> msg, std::shared_ptr<MessageServer::Connection> conn) {});
+
+    std::thread t(clientThread);
+    t.detach();
+
+    RoutineEnvironment::runEventLoop();
+
+    return 0;
+}
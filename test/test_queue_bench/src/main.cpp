@@ -0,0 +1,96 @@
+/*
+ * Created by Xianke Liu on 2026/10/17.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// 比较各队列在1、4、16个生产者线程、单消费者线程下的吞吐量
+// 用法: ./test [totalCount]
+
+#include "corpc_utils.h"
+#include "corpc_queue.h"
+
+#include <thread>
+#include <vector>
+#include <stdlib.h>
+#include <sched.h>
+#include <sys/time.h>
+
+using namespace corpc;
+
+static uint64_t utime() {
+    struct timeval t;
+    gettimeofday(&t, NULL);
+    return t.tv_sec * 1000000 + t.tv_usec;
+}
+
+template <typename Queue>
+static void bench(const char *name, int producerNum, int total) {
+    Queue *queue = new Queue;
+    int perProducer = total / producerNum;
+    int count = perProducer * producerNum;
+
+    uint64_t begin = utime();
+
+    std::vector<std::thread> producers;
+    for (int i = 0; i < producerNum; i++) {
+        producers.emplace_back([queue, perProducer]() {
+            for (int j = 1; j <= perProducer; j++) {
+                queue->push((void *)(intptr_t)j);
+            }
+        });
+    }
+
+    uint64_t sum = 0;
+    int popped = 0;
+    while (popped < count) {
+        void *v = queue->pop();
+        if (v) {
+            sum += (intptr_t)v;
+            popped++;
+        } else {
+            sched_yield();
+        }
+    }
+
+    uint64_t cost = utime() - begin;
+
+    for (auto& t : producers) {
+        t.join();
+    }
+
+    // 校验没有丢失或重复
+    uint64_t expect = (uint64_t)producerNum * perProducer * (perProducer + 1) / 2;
+    LOG("%-20s producers: %2d, ops per second: %10llu%s\n", name, producerNum,
+        (unsigned long long)count * 1000000 / (cost ? cost : 1), sum == expect ? "" : "  CHECK FAILED");
+
+    delete queue;
+}
+
+int main(int argc, const char *argv[]) {
+    int total = 4000000;
+    if (argc > 1) {
+        total = atoi(argv[1]);
+    }
+
+    int producerNums[] = {1, 4, 16};
+    for (int producerNum : producerNums) {
+        bench<MPSC_NoLockQueue<void*>>("MPSC_NoLockQueue", producerNum, total);
+        bench<LockQueue<void*>>("LockQueue", producerNum, total);
+        bench<MPSC_RingQueue<void*>>("MPSC_RingQueue", producerNum, total);
+        bench<MPMC_RingQueue<void*>>("MPMC_RingQueue", producerNum, total);
+        bench<MPSC_SegmentQueue<void*>>("MPSC_SegmentQueue", producerNum, total);
+    }
+
+    return 0;
+}
@@ -0,0 +1,146 @@
+/*
+ * Created by Xianke Liu on 2026/10/17.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// 服务器向连接转发大量共享的原始消息（模拟网关转发、广播），客户端校验收到的每条消息并输出吞吐量
+// 用法: ./test [messageNum] [messageSize] [port]
+
+#include "corpc_routine_env.h"
+#include "corpc_message_server.h"
+#include "corpc_utils.h"
+
+#include <thread>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+
+using namespace corpc;
+
+static int g_msgNum = 20000;
+static int g_msgSize = 4096;
+static uint16_t g_port = 21100;
+
+static uint64_t utime() {
+    struct timeval t;
+    gettimeofday(&t, NULL);
+    return t.tv_sec * 1000000 + t.tv_usec;
+}
+
+static bool readFull(int fd, uint8_t *buf, int size) {
+    int n = 0;
+    while (n < size) {
+        int ret = (int)read(fd, buf + n, size - n);
+        if (ret <= 0) {
+            return false;
+        }
+        n += ret;
+    }
+
+    return true;
+}
+
+// 在非协程线程中接收并校验消息（不走hook）
+static void recvThread() {
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(g_port);
+    addr.sin_addr.s_addr = inet_addr("127.0.0.1");
+
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+        ERROR_LOG("connect failed, errno %d (%s)\n", errno, strerror(errno));
+        exit(1);
+    }
+
+    // 先不读，让服务器发送缓冲区写满，覆盖部分写入的情况
+    usleep(200000);
+
+    uint64_t begin = utime();
+    std::string body(g_msgSize, 0);
+    uint8_t head[CORPC_MESSAGE_HEAD_SIZE];
+    int errNum = 0;
+    for (int i = 0; i < g_msgNum; i++) {
+        if (!readFull(fd, head, CORPC_MESSAGE_HEAD_SIZE)) {
+            ERROR_LOG("read head failed at message %d\n", i);
+            exit(1);
+        }
+
+        uint32_t size = be32toh(*(uint32_t *)head);
+        if (size != (uint32_t)g_msgSize) {
+            ERROR_LOG("message %d size %u not match %d\n", i, size, g_msgSize);
+            exit(1);
+        }
+
+        if (!readFull(fd, (uint8_t *)body.data(), size)) {
+            ERROR_LOG("read body failed at message %d\n", i);
+            exit(1);
+        }
+
+        for (uint32_t j = 0; j < size; j++) {
+            if ((uint8_t)body[j] != (uint8_t)j) {
+                errNum++;
+                break;
+            }
+        }
+    }
+    uint64_t cost = utime() - begin;
+
+    LOG("messages: %d, size: %d, errors: %d, MB per second: %llu\n", g_msgNum, g_msgSize, errNum,
+        (unsigned long long)g_msgNum * (g_msgSize + CORPC_MESSAGE_HEAD_SIZE) / (cost ? cost : 1));
+
+    exit(0);
+}
+
+int main(int argc, const char *argv[]) {
+    co_start_hook();
+
+    if (argc > 1) {
+        g_msgNum = atoi(argv[1]);
+    }
+    if (argc > 2) {
+        g_msgSize = atoi(argv[2]);
+    }
+    if (argc > 3) {
+        g_port = atoi(argv[3]);
+    }
+
+    IO *io = IO::create(1, 1);
+
+    TcpMessageServer *server = new TcpMessageServer(io, false, false, false, false, "127.0.0.1", g_port);
+    server->start();
+
+    // 所有消息共享同一份原始数据
+    std::shared_ptr<std::string> payload(new std::string(g_msgSize, 0));
+    for (int i = 0; i < g_msgSize; i++) {
+        (*payload)[i] = (char)i;
+    }
+
+    server->registerMessage(CORPC_MSG_TYPE_CONNECT, nullptr, false, [payload](int16_t type, uint16_t tag, std::shared_ptr<google::protobuf::Message> msg, std::shared_ptr<MessageServer::Connection> conn) {
+        for (int i = 0; i < g_msgNum; i++) {
+            conn->send(1, true, false, false, 0, payload);
+        }
+    });
+
+    std::thread t(recvThread);
+    t.detach();
+
+    RoutineEnvironment::runEventLoop();
+
+    return 0;
+}
@@ -0,0 +1,175 @@
+/*
+ * Created by Xianke Liu on 2026/10/17.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// 模拟重连风暴：clientThreadNum个客户端线程同时各建立connectionNum个连接，统计服务器接受全部连接的耗时、
+// 每秒接受的连接数、侦听队列溢出次数（/proc/net/netstat中的ListenOverflows）以及连接在各接收线程上的分布
+// 用法: ./test [mode(0:单acceptor 1:reusePort 2:reusePort+cpuSteering)] [ioThreadNum] [clientThreadNum] [connectionNum] [backlog] [port]
+
+#include "corpc_routine_env.h"
+#include "corpc_message_server.h"
+#include "corpc_utils.h"
+
+#include <thread>
+#include <atomic>
+#include <vector>
+#include <string>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include <sys/resource.h>
+#include <sys/time.h>
+
+using namespace corpc;
+
+static int g_mode = 0;
+static int g_ioThreadNum = 4;
+static int g_clientThreadNum = 4;
+static int g_connNum = 2000;
+static int g_backlog = 1024;
+static uint16_t g_port = 21900;
+
+static IO *g_io = nullptr;
+static std::atomic<int> g_connected(0);
+
+static uint64_t utime() {
+    struct timeval t;
+    gettimeofday(&t, NULL);
+    return t.tv_sec * 1000000 + t.tv_usec;
+}
+
+// 读/proc/net/netstat中TcpExt的一项
+static uint64_t tcpExt(const char *name) {
+    FILE *fp = fopen("/proc/net/netstat", "r");
+    if (!fp) {
+        return 0;
+    }
+
+    uint64_t value = 0;
+    char names[8192];
+    char values[8192];
+    while (fgets(names, sizeof(names), fp) && fgets(values, sizeof(values), fp)) {
+        if (strncmp(names, "TcpExt:", 7) != 0) {
+            continue;
+        }
+
+        char *nsave, *vsave;
+        char *n = strtok_r(names, " \n", &nsave);
+        char *v = strtok_r(values, " \n", &vsave);
+        while (n && v) {
+            if (strcmp(n, name) == 0) {
+                value = strtoull(v, NULL, 10);
+                break;
+            }
+            n = strtok_r(NULL, " \n", &nsave);
+            v = strtok_r(NULL, " \n", &vsave);
+        }
+        break;
+    }
+    fclose(fp);
+
+    return value;
+}
+
+static void connectThread(std::vector<int> *fds) {
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(g_port);
+    addr.sin_addr.s_addr = inet_addr("127.0.0.1");
+
+    for (int i = 0; i < g_connNum; i++) {
+        int fd = socket(AF_INET, SOCK_STREAM, 0);
+        if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+            ERROR_LOG("connect failed, errno %d (%s)\n", errno, strerror(errno));
+            exit(1);
+        }
+        fds->push_back(fd);
+    }
+}
+
+static void clientThread() {
+    int total = g_clientThreadNum * g_connNum;
+    std::vector<std::vector<int>> fds(g_clientThreadNum);
+    std::vector<std::thread> ts;
+
+    uint64_t overflows = tcpExt("ListenOverflows");
+    uint64_t begin = utime();
+    for (int i = 0; i < g_clientThreadNum; i++) {
+        ts.push_back(std::thread(connectThread, &fds[i]));
+    }
+    for (auto& t : ts) {
+        t.join();
+    }
+    while (g_connected < total) {
+        usleep(1000);
+    }
+    uint64_t cost = utime() - begin;
+
+    std::vector<ThreadLoad> loads;
+    g_io->getReceiver()->getThreadLoads(loads);
+    std::string dist;
+    for (auto& load : loads) {
+        dist += std::to_string(load.connectionNum) + " ";
+    }
+
+    const char *modeNames[] = {"single acceptor", "reuseport", "reuseport+cbpf"};
+    LOG("mode: %s, connections: %d, cost: %llu ms, accepts per second: %llu, listen overflows: %llu, per receive thread: %s\n",
+        modeNames[g_mode], total, (unsigned long long)cost / 1000, (unsigned long long)total * 1000000 / cost,
+        (unsigned long long)(tcpExt("ListenOverflows") - overflows), dist.c_str());
+
+    exit(0);
+}
+
+int main(int argc, const char *argv[]) {
+    co_start_hook();
+
+    if (argc > 1) g_mode = atoi(argv[1]);
+    if (argc > 2) g_ioThreadNum = atoi(argv[2]);
+    if (argc > 3) g_clientThreadNum = atoi(argv[3]);
+    if (argc > 4) g_connNum = atoi(argv[4]);
+    if (argc > 5) g_backlog = atoi(argv[5]);
+    if (argc > 6) g_port = atoi(argv[6]);
+
+    struct rlimit rl;
+    getrlimit(RLIMIT_NOFILE, &rl);
+    rl.rlim_cur = rl.rlim_max;
+    setrlimit(RLIMIT_NOFILE, &rl);
+
+    g_io = IO::create(g_ioThreadNum, g_ioThreadNum);
+
+    TcpMessageServer *server = new TcpMessageServer(g_io, false, false, false, false, "127.0.0.1", g_port);
+
+    AcceptPolicy policy;
+    policy.backlog = g_backlog;
+    policy.reusePort = g_mode > 0;
+    policy.cpuSteering = g_mode > 1;
+    server->setAcceptPolicy(policy);
+
+    server->start();
+
+    server->registerMessage(CORPC_MSG_TYPE_CONNECT, nullptr, false, [](int16_t type, uint16_t tag, std::shared_ptr<google::protobuf::Message> msg, std::shared_ptr<MessageServer::Connection> conn) {
+        g_connected++;
+    });
+
+    std::thread t(clientThread);
+    t.detach();
+
+    RoutineEnvironment::runEventLoop();
+
+    return 0;
+}
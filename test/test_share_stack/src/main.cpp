@@ -0,0 +1,117 @@
+/*
+ * Created by Xianke Liu on 2026/10/17.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// 多线程启动协程环境，输出启动耗时、进程虚拟内存/常驻内存，以及每个线程创建的共享栈数和共享栈常驻内存
+// 用法: ./test [threadNum] [routineNumPerThread]
+
+#include "corpc_utils.h"
+#include "corpc_routine_env.h"
+
+#include <thread>
+#include <sys/time.h>
+
+using namespace corpc;
+
+static int g_routineNum = 10;
+static std::atomic<int> g_readyNum(0);
+
+static uint64_t nowUS() {
+    struct timeval now;
+    gettimeofday(&now, NULL);
+    return now.tv_sec * 1000000ULL + now.tv_usec;
+}
+
+static void printMemory(const char *tag) {
+    long pages = 0, resident = 0;
+    FILE *f = fopen("/proc/self/statm", "r");
+    if (f) {
+        if (fscanf(f, "%ld %ld", &pages, &resident) != 2) {
+            pages = resident = 0;
+        }
+        fclose(f);
+    }
+    long pagesize = sysconf(_SC_PAGE_SIZE);
+    LOG("%s -- vm: %ld KB, rss: %ld KB\n", tag, pages * pagesize / 1024, resident * pagesize / 1024);
+}
+
+static void *work_routine( void *arg )
+{
+    // 使用一些栈空间
+    char buf[16 * 1024];
+    memset(buf, 0, sizeof(buf));
+    
+    while (true) {
+        sleep(1);
+        buf[0]++;
+    }
+    
+    return NULL;
+}
+
+static void *report_routine( void *arg )
+{
+    int idx = (int)(intptr_t)arg;
+    sleep(1);
+    
+    RoutineEnvironment *env = RoutineEnvironment::getEnv();
+    LOG("thread %d -- share stacks: %d, stack resident: %lu KB\n", idx, env->getShareStackCount(), env->getStackResidentSize() / 1024);
+    
+    return NULL;
+}
+
+static void threadEntry(int idx) {
+    for (int i = 0; i < g_routineNum; i++) {
+        RoutineEnvironment::startCoroutine(work_routine, NULL);
+    }
+    
+    if (idx < 2) {
+        RoutineEnvironment::startCoroutine(report_routine, (void *)(intptr_t)idx);
+    }
+    
+    g_readyNum++;
+    RoutineEnvironment::runEventLoop();
+}
+
+int main(int argc, const char * argv[]) {
+    int threadNum = 32;
+    if (argc > 1) {
+        threadNum = atoi(argv[1]);
+    }
+    if (argc > 2) {
+        g_routineNum = atoi(argv[2]);
+    }
+    
+    co_start_hook();
+    
+    printMemory("before start");
+    
+    uint64_t begin = nowUS();
+    std::vector<std::thread> threads;
+    for (int i = 0; i < threadNum; i++) {
+        threads.push_back(std::thread(threadEntry, i));
+    }
+    
+    while (g_readyNum < threadNum) {
+        usleep(100);
+    }
+    LOG("%d threads started in %llu us\n", threadNum, (unsigned long long)(nowUS() - begin));
+    printMemory("after start");
+    
+    sleep(2);
+    printMemory("running");
+    
+    exit(0);
+}
@@ -0,0 +1,79 @@
+/*
+ * Created by Xianke Liu on 2026/10/17.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// 大量共享栈协程频繁切换，每秒输出栈拷贝字节数和保存缓冲区分配次数
+// 用法: ./test [routineNum]
+
+#include "corpc_utils.h"
+#include "corpc_routine_env.h"
+
+using namespace corpc;
+
+static uint64_t g_count = 0;
+
+static void *log_routine( void *arg )
+{
+    stCoStat_t last = *co_get_stat_ct();
+    uint64_t lastCount = g_count;
+    while (true) {
+        sleep(1);
+        
+        stCoStat_t *stat = co_get_stat_ct();
+        LOG("switch per second: %llu, copy bytes per second: %llu, alloc per second: %llu\n",
+            (unsigned long long)(g_count - lastCount),
+            stat->ullStackCopyBytes - last.ullStackCopyBytes,
+            stat->ullSaveBufferAllocCnt - last.ullSaveBufferAllocCnt);
+        last = *stat;
+        lastCount = g_count;
+    }
+    
+    return NULL;
+}
+
+static void *work_routine( void *arg )
+{
+    // 不同协程使用不同大小的栈空间
+    int depth = (int)(intptr_t)arg % 8 + 1;
+    while (true) {
+        char buf[512 * depth];
+        buf[0] = 0;
+        buf[sizeof(buf) - 1] = buf[0];
+        
+        msleep(1);
+        g_count++;
+    }
+    
+    return NULL;
+}
+
+int main(int argc, const char * argv[]) {
+    int routineNum = 1000;
+    if (argc > 1) {
+        routineNum = atoi(argv[1]);
+    }
+    
+    co_start_hook();
+    
+    RoutineEnvironment::startCoroutine(log_routine, NULL);
+    
+    for (int i = 0; i < routineNum; i++) {
+        RoutineEnvironment::startCoroutine(work_routine, (void *)(intptr_t)i);
+    }
+
+    RoutineEnvironment::runEventLoop();
+    
+    return 0;
+}
@@ -0,0 +1,113 @@
+/*
+ * Created by Xianke Liu on 2026/10/17.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// 热点协程栈放置测试：少量共享栈上运行大量空闲协程和若干频繁切换的热点协程，
+// 热点协程每2秒结束并由同一入口重新启动（之后应直接使用独立栈），每秒输出栈拷贝字节数和放置计数
+// 用法: ./test [hotNum] [idleNum] [shareStackNum]
+
+#include "corpc_utils.h"
+#include "corpc_routine_env.h"
+
+#include <sys/time.h>
+
+using namespace corpc;
+
+static uint64_t nowMS() {
+    struct timeval now;
+    gettimeofday(&now, NULL);
+    return now.tv_sec * 1000ULL + now.tv_usec / 1000;
+}
+
+static void *log_routine( void *arg )
+{
+    stCoStat_t last = *co_get_stat_ct();
+    while (true) {
+        sleep(1);
+        
+        stCoStat_t *stat = co_get_stat_ct();
+        RoutineEnvironment *env = RoutineEnvironment::getEnv();
+        LOG("copy bytes per second: %llu, hot promoted: %llu, private stacks: %llu, share stacks: %d\n",
+            stat->ullStackCopyBytes - last.ullStackCopyBytes,
+            stat->ullHotPromoteCnt,
+            stat->ullPrivateStackCnt,
+            env->getShareStackCount());
+        last = *stat;
+    }
+    
+    return NULL;
+}
+
+static void *hot_routine( void *arg )
+{
+    char buf[4096];
+    memset(buf, 0, sizeof(buf));
+    
+    uint64_t end = nowMS() + 2000;
+    while (nowMS() < end) {
+        msleep(1);
+        buf[0]++;
+    }
+    
+    // 以同一入口重新启动
+    RoutineEnvironment::startCoroutine(hot_routine, NULL);
+    return NULL;
+}
+
+static void *idle_routine( void *arg )
+{
+    char buf[4096];
+    memset(buf, 0, sizeof(buf));
+    
+    while (true) {
+        sleep(1);
+        buf[0]++;
+    }
+    
+    return NULL;
+}
+
+int main(int argc, const char * argv[]) {
+    int hotNum = 8;
+    int idleNum = 100;
+    int stackNum = 8;
+    if (argc > 1) {
+        hotNum = atoi(argv[1]);
+    }
+    if (argc > 2) {
+        idleNum = atoi(argv[2]);
+    }
+    if (argc > 3) {
+        stackNum = atoi(argv[3]);
+    }
+    
+    co_start_hook();
+    
+    RoutineEnvironment::setShareStackConfig(stackNum, 128 * 1024, true);
+    
+    RoutineEnvironment::startCoroutine(log_routine, NULL);
+    
+    for (int i = 0; i < idleNum; i++) {
+        RoutineEnvironment::startCoroutine(idle_routine, NULL);
+    }
+    
+    for (int i = 0; i < hotNum; i++) {
+        RoutineEnvironment::startCoroutine(hot_routine, NULL);
+    }
+
+    RoutineEnvironment::runEventLoop();
+    
+    return 0;
+}
@@ -0,0 +1,220 @@
+/*
+ * Created by Xianke Liu on 2026/10/17.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// 按cpus配置把IO收发线程绑核（收发线程使用相同的CPU列表），客户端通过connectionNum个连接发送请求，服务器逐条回复，
+// 输出每个线程允许运行的CPU、每秒往返次数以及IO线程发生的CPU迁移次数（未绑核时IO线程会在核之间迁移）
+// 用法: ./test [cpus(如"0,1"，空串表示不绑核)] [threadNum] [connectionNum] [seconds] [port]
+
+#include "corpc_routine_env.h"
+#include "corpc_message_server.h"
+#include "corpc_thread_placement.h"
+#include "corpc_utils.h"
+
+#include <thread>
+#include <atomic>
+#include <vector>
+#include <string>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <dirent.h>
+#include <arpa/inet.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <google/protobuf/wrappers.pb.h>
+
+using namespace corpc;
+
+static std::vector<int> g_cpus;
+static int g_threadNum = 2;
+static int g_connNum = 16;
+static int g_seconds = 5;
+static uint16_t g_port = 21800;
+
+static std::atomic<int> g_connected(0);
+
+static uint64_t utime() {
+    struct timeval t;
+    gettimeofday(&t, NULL);
+    return t.tv_sec * 1000000 + t.tv_usec;
+}
+
+// 读/proc/self/task/<tid>/status中的一项
+static std::string taskStatus(const char *tid, const char *key) {
+    char path[320];
+    snprintf(path, sizeof(path), "/proc/self/task/%s/status", tid);
+
+    std::string value;
+    FILE *fp = fopen(path, "r");
+    if (fp) {
+        char line[256];
+        size_t keyLen = strlen(key);
+        while (fgets(line, sizeof(line), fp)) {
+            if (strncmp(line, key, keyLen) == 0 && line[keyLen] == ':') {
+                value = line + keyLen + 1;
+                value.erase(0, value.find_first_not_of(" \t"));
+                value.erase(value.find_last_not_of("\n") + 1);
+                break;
+            }
+        }
+        fclose(fp);
+    }
+
+    return value;
+}
+
+// 统计除主线程和客户端线程外所有线程的允许CPU和迁移次数（/proc/self/task/<tid>/sched中的nr_migrations）
+static uint64_t taskMigrations(bool print, pid_t clientTid) {
+    uint64_t total = 0;
+    DIR *dir = opendir("/proc/self/task");
+    struct dirent *entry;
+    while ((entry = readdir(dir)) != NULL) {
+        if (entry->d_name[0] == '.' || atoi(entry->d_name) == getpid() || atoi(entry->d_name) == clientTid) {
+            continue;
+        }
+
+        char path[320];
+        snprintf(path, sizeof(path), "/proc/self/task/%s/sched", entry->d_name);
+        FILE *fp = fopen(path, "r");
+        uint64_t migrations = 0;
+        if (fp) {
+            char line[256];
+            while (fgets(line, sizeof(line), fp)) {
+                if (strncmp(line, "se.nr_migrations", 16) == 0) {
+                    migrations = strtoull(strchr(line, ':') + 1, NULL, 10);
+                    break;
+                }
+            }
+            fclose(fp);
+        }
+        total += migrations;
+
+        if (print) {
+            LOG("thread %s: cpus allowed: %s\n", entry->d_name, taskStatus(entry->d_name, "Cpus_allowed_list").c_str());
+        }
+    }
+    closedir(dir);
+
+    return total;
+}
+
+static void clientThread() {
+    pid_t tid = GetPid();
+
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(g_port);
+    addr.sin_addr.s_addr = inet_addr("127.0.0.1");
+
+    google::protobuf::Int64Value req;
+    req.set_value(1);
+    std::string body = req.SerializeAsString();
+    std::string request(CORPC_MESSAGE_HEAD_SIZE, 0);
+    *(uint32_t *)&request[0] = htobe32(body.size());
+    *(uint16_t *)&request[4] = htobe16(1);
+    request.append(body);
+
+    std::vector<int> fds;
+    for (int i = 0; i < g_connNum; i++) {
+        int fd = socket(AF_INET, SOCK_STREAM, 0);
+        if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+            ERROR_LOG("connect failed, errno %d (%s)\n", errno, strerror(errno));
+            exit(1);
+        }
+        int val = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &val, sizeof(val));
+        fds.push_back(fd);
+    }
+    while (g_connected < g_connNum) {
+        usleep(1000);
+    }
+
+    taskMigrations(true, tid);
+    uint64_t migrations = taskMigrations(false, tid);
+
+    // 每个连接同时只有一个请求在途，依次轮询各连接
+    uint64_t count = 0;
+    uint64_t begin = utime();
+    uint64_t end = begin + g_seconds * 1000000ULL;
+    char buf[256];
+    while (utime() < end) {
+        for (int fd : fds) {
+            if (write(fd, request.data(), request.size()) < 0) {
+                exit(1);
+            }
+        }
+        for (int fd : fds) {
+            size_t got = 0;
+            while (got < request.size()) {
+                int ret = (int)read(fd, buf, sizeof(buf));
+                if (ret <= 0) {
+                    exit(1);
+                }
+                got += ret;
+            }
+        }
+        count += g_connNum;
+    }
+
+    LOG("cpus: %s, threads: %d, connections: %d, round trips per second: %llu, io thread migrations: %llu\n",
+        g_cpus.empty() ? "none" : "bound", g_threadNum, g_connNum,
+        (unsigned long long)count * 1000000 / (utime() - begin), (unsigned long long)(taskMigrations(false, tid) - migrations));
+
+    exit(0);
+}
+
+int main(int argc, const char *argv[]) {
+    co_start_hook();
+
+    if (argc > 1) {
+        const char *p = argv[1];
+        while (*p) {
+            g_cpus.push_back(atoi(p));
+            p = strchr(p, ',');
+            if (!p) break;
+            p++;
+        }
+    }
+    if (argc > 2) g_threadNum = atoi(argv[2]);
+    if (argc > 3) g_connNum = atoi(argv[3]);
+    if (argc > 4) g_seconds = atoi(argv[4]);
+    if (argc > 5) g_port = atoi(argv[5]);
+
+    ThreadPlacement::setCpus(THREAD_ROLE_RECEIVER, g_cpus);
+    ThreadPlacement::setCpus(THREAD_ROLE_SENDER, g_cpus);
+
+    IO *io = IO::create(g_threadNum, g_threadNum);
+
+    TcpMessageServer *server = new TcpMessageServer(io, false, false, false, false, "127.0.0.1", g_port);
+    server->start();
+
+    server->registerMessage(CORPC_MSG_TYPE_CONNECT, nullptr, false, [](int16_t type, uint16_t tag, std::shared_ptr<google::protobuf::Message> msg, std::shared_ptr<MessageServer::Connection> conn) {
+        g_connected++;
+    });
+
+    server->registerMessage(1, new google::protobuf::Int64Value, false, [](int16_t type, uint16_t tag, std::shared_ptr<google::protobuf::Message> msg, std::shared_ptr<MessageServer::Connection> conn) {
+        conn->send(1, false, false, false, 0, msg);
+    });
+
+    std::thread t(clientThread);
+    t.detach();
+
+    RoutineEnvironment::runEventLoop();
+
+    return 0;
+}
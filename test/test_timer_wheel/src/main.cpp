@@ -0,0 +1,140 @@
+/*
+ * Created by Xianke Liu on 2026/10/17.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// 多级时间轮测试：大量协程使用随机超时（部分超过60秒的超时在到期前被取消），
+// 每秒输出超时触发数、最大延迟以及epoll_wait调用次数
+// 用法: ./test [routineNum]
+
+#include "corpc_utils.h"
+#include "corpc_routine_env.h"
+
+#include <poll.h>
+#include <sys/time.h>
+
+using namespace corpc;
+
+static uint64_t g_fired = 0;
+static uint64_t g_cancelled = 0;
+static uint64_t g_maxLate = 0;
+static uint64_t g_early = 0;
+
+static uint64_t nowMS() {
+    struct timeval now;
+    gettimeofday(&now, NULL);
+    return now.tv_sec * 1000ULL + now.tv_usec / 1000;
+}
+
+static void *log_routine( void *arg )
+{
+    stCoStat_t last = *co_get_stat_ct();
+    uint64_t lastFired = g_fired;
+    uint64_t lastCancelled = g_cancelled;
+    while (true) {
+        sleep(1);
+        
+        stCoStat_t *stat = co_get_stat_ct();
+        LOG("fired per second: %llu, cancelled per second: %llu, max late: %llu ms, early: %llu, epoll_wait per second: %llu\n",
+            (unsigned long long)(g_fired - lastFired),
+            (unsigned long long)(g_cancelled - lastCancelled),
+            (unsigned long long)g_maxLate,
+            (unsigned long long)g_early,
+            stat->ullEpollWaitCnt - last.ullEpollWaitCnt);
+        last = *stat;
+        lastFired = g_fired;
+        lastCancelled = g_cancelled;
+        g_maxLate = 0;
+    }
+    
+    return NULL;
+}
+
+static void *timer_routine( void *arg )
+{
+    while (true) {
+        uint64_t timeout = rand() % 3000 + 1;
+        uint64_t begin = nowMS();
+        poll(NULL, 0, timeout);
+        uint64_t elapsed = nowMS() - begin;
+        
+        if (elapsed + 1 < timeout) {
+            g_early++;
+        } else if (elapsed > timeout && elapsed - timeout > g_maxLate) {
+            g_maxLate = elapsed - timeout;
+        }
+        g_fired++;
+    }
+    
+    return NULL;
+}
+
+// 等待超过时间轮第0级范围的长超时，在到期前通过管道唤醒取消
+static void *long_routine( void *arg )
+{
+    int fds[2];
+    if (pipe(fds) < 0) {
+        ERROR_LOG("pipe failed\n");
+        return NULL;
+    }
+    
+    while (true) {
+        RoutineEnvironment::startCoroutine([](void *arg) -> void * {
+            int fd = (int)(intptr_t)arg;
+            poll(NULL, 0, rand() % 2000 + 1);
+            char c = 0;
+            write(fd, &c, 1);
+            return NULL;
+        }, (void *)(intptr_t)fds[1]);
+        
+        struct pollfd pf = { 0 };
+        pf.fd = fds[0];
+        pf.events = POLLIN;
+        // 从90秒到30天不等
+        int timeout = 90 * 1000 * (1 << (rand() % 15));
+        int ret = poll(&pf, 1, timeout);
+        if (ret == 1) {
+            char c;
+            read(fds[0], &c, 1);
+            g_cancelled++;
+        } else {
+            ERROR_LOG("long timeout fired unexpectedly\n");
+        }
+    }
+    
+    return NULL;
+}
+
+int main(int argc, const char * argv[]) {
+    int routineNum = 1000;
+    if (argc > 1) {
+        routineNum = atoi(argv[1]);
+    }
+    
+    co_start_hook();
+    
+    RoutineEnvironment::startCoroutine(log_routine, NULL);
+    
+    for (int i = 0; i < routineNum; i++) {
+        RoutineEnvironment::startCoroutine(timer_routine, NULL);
+    }
+    
+    for (int i = 0; i < 100; i++) {
+        RoutineEnvironment::startCoroutine(long_routine, NULL);
+    }
+
+    RoutineEnvironment::runEventLoop();
+    
+    return 0;
+}
@@ -0,0 +1,274 @@
+/*
+ * Created by Xianke Liu on 2026/10/17.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// 测试hook的accept4/readv/writev/sendmsg/recvmsg/sendmmsg/recvmmsg：
+// tcp连接上用writev发送大块分散数据（会发生部分写），readv/recvmsg接收并校验；udp上用sendmmsg/recvmmsg批量收发
+// 用法: ./test [port]
+
+#include "corpc_utils.h"
+#include "corpc_routine_env.h"
+
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+using namespace corpc;
+
+#define TCP_TOTAL_SIZE (16 * 1024 * 1024)
+#define IOV_NUM 64
+#define UDP_BATCH 32
+#define UDP_TOTAL 100000
+
+static int g_port = 18765;
+
+static void *tcp_server_routine( void *arg )
+{
+    int listenFd = socket(AF_INET, SOCK_STREAM, 0);
+    int reuse = 1;
+    setsockopt(listenFd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+    
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(g_port);
+    addr.sin_addr.s_addr = inet_addr("127.0.0.1");
+    if (bind(listenFd, (struct sockaddr *)&addr, sizeof(addr)) < 0 || listen(listenFd, 128) < 0) {
+        ERROR_LOG("bind/listen failed\n");
+        exit(1);
+    }
+    
+    // 阻塞语义的accept4，超时（默认1秒）后重试
+    int fd = -1;
+    while (fd < 0) {
+        fd = accept4(listenFd, NULL, NULL, SOCK_CLOEXEC);
+    }
+    LOG("accept4 fd %d\n", fd);
+    co_set_timeout(fd, -1, 1000);
+    
+    uint64_t received = 0;
+    uint8_t expect = 0;
+    bool useMsg = false;
+    std::vector<char> bufs(IOV_NUM * 1000);
+    while (received < TCP_TOTAL_SIZE) {
+        struct iovec iov[IOV_NUM];
+        for (int i = 0; i < IOV_NUM; i++) {
+            iov[i].iov_base = &bufs[i * 1000];
+            iov[i].iov_len = 1000;
+        }
+        
+        ssize_t ret;
+        if (useMsg) {
+            struct msghdr msg;
+            memset(&msg, 0, sizeof(msg));
+            msg.msg_iov = iov;
+            msg.msg_iovlen = IOV_NUM;
+            ret = recvmsg(fd, &msg, 0);
+        } else {
+            ret = readv(fd, iov, IOV_NUM);
+        }
+        useMsg = !useMsg;
+        
+        if (ret <= 0) {
+            ERROR_LOG("tcp read ret %d errno %d\n", (int)ret, errno);
+            exit(1);
+        }
+        
+        for (ssize_t i = 0; i < ret; i++) {
+            if ((uint8_t)bufs[i] != expect) {
+                ERROR_LOG("tcp data mismatch at %llu\n", (unsigned long long)(received + i));
+                exit(1);
+            }
+            expect++;
+        }
+        received += ret;
+        
+        // 接收方慢一些，让发送方发生部分写
+        msleep(1);
+    }
+    
+    LOG("tcp received %llu bytes ok, io syscalls %llu\n", (unsigned long long)received,
+        (unsigned long long)co_get_stat_ct()->ullIoSysCallCnt);
+    close(fd);
+    close(listenFd);
+    return NULL;
+}
+
+static void *tcp_client_routine( void *arg )
+{
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(g_port);
+    addr.sin_addr.s_addr = inet_addr("127.0.0.1");
+    if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+        ERROR_LOG("connect failed\n");
+        exit(1);
+    }
+    co_set_timeout(fd, -1, 10000);
+    
+    // 不同大小的iov，数据为递增字节
+    std::vector<char> data(TCP_TOTAL_SIZE);
+    for (size_t i = 0; i < data.size(); i++) {
+        data[i] = (char)i;
+    }
+    
+    size_t sent = 0;
+    bool useMsg = false;
+    while (sent < data.size()) {
+        struct iovec iov[IOV_NUM];
+        int cnt = 0;
+        size_t pos = sent;
+        while (cnt < IOV_NUM && pos < data.size()) {
+            size_t len = std::min(data.size() - pos, (size_t)(cnt * 997 % 8191 + 1));
+            iov[cnt].iov_base = &data[pos];
+            iov[cnt].iov_len = len;
+            pos += len;
+            cnt++;
+        }
+        
+        ssize_t ret;
+        if (useMsg) {
+            struct msghdr msg;
+            memset(&msg, 0, sizeof(msg));
+            msg.msg_iov = iov;
+            msg.msg_iovlen = cnt;
+            ret = sendmsg(fd, &msg, 0);
+        } else {
+            ret = writev(fd, iov, cnt);
+            if (ret > 0 && (size_t)ret != pos - sent) {
+                ERROR_LOG("writev partial %d of %d\n", (int)ret, (int)(pos - sent));
+                exit(1);
+            }
+        }
+        useMsg = !useMsg;
+        
+        if (ret <= 0) {
+            ERROR_LOG("tcp write ret %d errno %d\n", (int)ret, errno);
+            exit(1);
+        }
+        sent += ret;
+    }
+    
+    LOG("tcp sent %llu bytes\n", (unsigned long long)sent);
+    
+    char c;
+    read(fd, &c, 1); // 等待对端关闭
+    close(fd);
+    return NULL;
+}
+
+static void *udp_server_routine( void *arg )
+{
+    int fd = socket(AF_INET, SOCK_DGRAM, 0);
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(g_port + 1);
+    addr.sin_addr.s_addr = inet_addr("127.0.0.1");
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+        ERROR_LOG("udp bind failed\n");
+        exit(1);
+    }
+    
+    uint32_t bufs[UDP_BATCH];
+    struct iovec iov[UDP_BATCH];
+    struct mmsghdr msgs[UDP_BATCH];
+    int received = 0;
+    int calls = 0;
+    int timeouts = 0;
+    while (received < UDP_TOTAL && timeouts < 3) {
+        memset(msgs, 0, sizeof(msgs));
+        for (int i = 0; i < UDP_BATCH; i++) {
+            iov[i].iov_base = &bufs[i];
+            iov[i].iov_len = sizeof(uint32_t);
+            msgs[i].msg_hdr.msg_iov = &iov[i];
+            msgs[i].msg_hdr.msg_iovlen = 1;
+        }
+        
+        int ret = recvmmsg(fd, msgs, UDP_BATCH, 0, NULL);
+        if (ret < 0) {
+            timeouts++;
+            continue;
+        }
+        calls++;
+        received += ret;
+    }
+    
+    LOG("udp received %d datagrams in %d recvmmsg calls\n", received, calls);
+    close(fd);
+    return NULL;
+}
+
+static void *udp_client_routine( void *arg )
+{
+    int fd = socket(AF_INET, SOCK_DGRAM, 0);
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(g_port + 1);
+    addr.sin_addr.s_addr = inet_addr("127.0.0.1");
+    connect(fd, (struct sockaddr *)&addr, sizeof(addr));
+    
+    uint32_t bufs[UDP_BATCH];
+    struct iovec iov[UDP_BATCH];
+    struct mmsghdr msgs[UDP_BATCH];
+    int sent = 0;
+    while (sent < UDP_TOTAL) {
+        int cnt = std::min(UDP_BATCH, UDP_TOTAL - sent);
+        memset(msgs, 0, sizeof(msgs));
+        for (int i = 0; i < cnt; i++) {
+            bufs[i] = sent + i;
+            iov[i].iov_base = &bufs[i];
+            iov[i].iov_len = sizeof(uint32_t);
+            msgs[i].msg_hdr.msg_iov = &iov[i];
+            msgs[i].msg_hdr.msg_iovlen = 1;
+        }
+        
+        int ret = sendmmsg(fd, msgs, cnt, 0);
+        if (ret <= 0) {
+            ERROR_LOG("sendmmsg ret %d errno %d\n", ret, errno);
+            break;
+        }
+        sent += ret;
+        
+        if (sent % (UDP_BATCH * 16) == 0) {
+            msleep(1); // 避免接收缓冲区溢出丢包过多
+        }
+    }
+    
+    LOG("udp sent %d datagrams\n", sent);
+    close(fd);
+    return NULL;
+}
+
+int main(int argc, const char * argv[]) {
+    if (argc > 1) {
+        g_port = atoi(argv[1]);
+    }
+    
+    co_start_hook();
+    
+    RoutineEnvironment::startCoroutine(tcp_server_routine, NULL);
+    RoutineEnvironment::startCoroutine(tcp_client_routine, NULL);
+    RoutineEnvironment::startCoroutine(udp_server_routine, NULL);
+    RoutineEnvironment::startCoroutine(udp_client_routine, NULL);
+
+    RoutineEnvironment::runEventLoop();
+    
+    return 0;
+}